@@ -34,6 +34,7 @@
 
 #include <array>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -95,6 +96,21 @@ public:
      * Read the grid from file.
      */
     void grid(std::vector<word>& out) const;
+    /**
+     * Access the grid without copying, if possible.
+     *
+     * @param buffer storage used if the grid cannot be read in place from
+     *        the memory-mapped file
+     * @return pointer to gridSize() words, valid as long as the file and buffer
+     */
+    const word* gridData(std::vector<word>& buffer) const;
+    /**
+     * Access part of the grid without copying, if possible.
+     *
+     * @param offset first word of the grid to access
+     * @param size number of words
+     */
+    const word* gridData(std::vector<word>& buffer, size_t offset, size_t size) const;
     size_t gridSize() const;
     int scaleFactor() const;
     int xNum() const;
@@ -113,7 +129,7 @@ public:
      */
     int dataVersion() const;
 
-    /// throws
+    /// throws; computed once, shared by all callers and not to be modified
     FeltGridDefinitionPtr projectionInformation() const;
 
     std::string information() const;
@@ -138,9 +154,18 @@ private:
 
 	const std::vector<word> & getGridHeader_() const;
 	const std::vector<word> & getExtraGeometrySpecification_() const;
-
+	/// position of the grid header in the file
+	size_t gridHeaderPosition_() const;
+	/// read grid header and extra geometry specification, once
+	void readGridInfo_() const;
+	/// create the grid definition, once
+	void readProjection_() const;
+
+	mutable std::once_flag gridInfoRead_;
 	mutable std::vector<word> gridHeader_;
 	mutable std::vector<word> extraGridSpec_;
+	mutable std::once_flag projectionRead_;
+	mutable FeltGridDefinitionPtr projection_;
 	Header header_;
 	const FeltFile & feltFile_;
 	size_t index_;
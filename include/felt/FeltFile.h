@@ -34,6 +34,7 @@
 #include "FeltTypes.h"
 
 #include <memory>
+#include <mutex>
 #include <vector>
 
 namespace felt
@@ -105,6 +106,20 @@ private:
      */
     void get_(std::vector<word> & out, size_type fromWord, size_type noOfWords) const;
 
+    /**
+     * Read data from file into preallocated storage, words beyond the end
+     * of the file are set to 0.
+     */
+    void read_(word* out, size_type fromWord, size_type noOfWords) const;
+
+    /**
+     * Access data in the memory-mapped file without copying.
+     *
+     * @return pointer to noOfWords words, or 0 if the file is not mapped,
+     *         the words need byte-swapping or are beyond the end of the file
+     */
+    const word* mapped_(size_type fromWord, size_type noOfWords) const;
+
     const std::string fileName_;
 
     /**
@@ -118,7 +133,13 @@ private:
     typedef std::vector<FeltFieldPtr> Fields;
     mutable Fields fields_;
 
+    /** read-only mapping of the whole file, 0 if mapping failed */
+    const char* mapping_;
+    size_t mappingSize_;
+
+    /** fallback if the file cannot be mapped, guarded by streamMutex_ */
     std::unique_ptr<std::istream> feltFile_;
+    mutable std::mutex streamMutex_;
 
     friend class FeltField;
 };
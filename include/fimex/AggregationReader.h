@@ -26,6 +26,7 @@
 
 #include "fimex/CDMReader.h"
 
+#include <functional>
 #include <map>
 #include <memory>
 
@@ -37,10 +38,43 @@ namespace MetNoFimex {
 class AggregationReader : public CDMReader
 {
 public:
+    //! function opening a reader when it is needed
+    typedef std::function<CDMReader_p()> ReaderOpener;
+
     AggregationReader(const std::string& aggregationType);
     ~AggregationReader();
 
     void addReader(CDMReader_p reader, const std::string& id = std::string());
+
+    /**
+     * Add a reader which is only opened when needed, for its metadata in
+     * initAggregation() and for reading data. Lazy readers are closed again
+     * when more than setMaxOpenReaders() of them are open, least recently used first.
+     *
+     * @param opener function opening the reader, may throw CDMException
+     * @param id the id of the reader, usually the file-name
+     */
+    void addLazyReader(ReaderOpener opener, const std::string& id);
+
+    /**
+     * Set the maximum number of lazy readers kept open at the same time. Default is 256.
+     */
+    void setMaxOpenReaders(size_t maxOpen);
+
+    /**
+     * Remember the unlimited dimension of joinExisting aggregations in a manifest file.
+     *
+     * The manifest lists each member with modification time (in ns), inode, size, length of
+     * the unlimited dimension and the values of the unlimited coordinate.
+     * initAggregation() takes unchanged members from the manifest without
+     * opening them, and rewrites the manifest if members were added, changed
+     * or removed. Only useful with lazy readers. Not used for string and
+     * 64-bit integer unlimited coordinates, which cannot be kept as double.
+     *
+     * @param manifestFile the manifest file, empty to disable
+     */
+    void setManifest(const std::string& manifestFile);
+
     void initAggregation();
 
     using CDMReader::getDataSlice;
@@ -48,6 +82,12 @@ public:
     DataPtr getDataSlice(const std::string& varName, const SliceBuilder& sb) override;
 
 protected:
+    /**
+     * Get the reader at position i of readers_, opening a lazy reader if
+     * it is not open.
+     */
+    CDMReader_p getReader(size_t i);
+
     // main data-reader
     CDMReader_p gDataReader_;
 
@@ -61,6 +101,14 @@ protected:
 
     //! varName -> readerId, union mapping of varName to readers_(i)
     std::map<std::string, std::size_t> varReader_;
+
+private:
+    //! getReader, or null if the reader cannot be opened; it is then left out
+    CDMReader_p tryGetReader(size_t i);
+    void dropReader(size_t i);
+
+    struct Impl;
+    std::unique_ptr<Impl> p_;
 };
 
 } // namespace MetNoFimex
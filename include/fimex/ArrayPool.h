@@ -0,0 +1,148 @@
+/*
+ * Fimex, ArrayPool.h
+ *
+ * (C) Copyright 2019, met.no
+ *
+ * Project Info:  https://wiki.met.no/fimex/start
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#ifndef FIMEX_ARRAYPOOL_H
+#define FIMEX_ARRAYPOOL_H
+
+#include "fimex/SharedArray.h"
+
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+
+namespace MetNoFimex {
+
+/**
+ * @headerfile fimex/ArrayPool.h
+ */
+
+/**
+ * Process-wide pool of aligned memory buffers for large data arrays.
+ *
+ * Buffers are grouped in size-classes. Released buffers are kept in the
+ * pool (up to getMaxPooledBytes()) and reused by later allocations of the
+ * same size-class, e.g. slices of the next time-step.
+ *
+ * The maximum amount of pooled memory can be set with the environment
+ * variable FIMEX_ARRAY_POOL_SIZE (bytes).
+ */
+class ArrayPool
+{
+public:
+    /// alignment of all buffers, in bytes
+    static const size_t ALIGNMENT = 64;
+    /// buffers smaller than this are not kept in the pool
+    static const size_t MIN_POOLED_BYTES = 64 * 1024;
+
+    static ArrayPool& instance();
+
+    /**
+     * allocate an aligned buffer
+     * @param bytes minimum size of the buffer
+     * @throw std::bad_alloc
+     */
+    void* allocate(size_t bytes);
+
+    /**
+     * return a buffer to the pool
+     * @param ptr buffer from allocate()
+     * @param bytes the size given to allocate()
+     */
+    void release(void* ptr, size_t bytes);
+
+    /// bytes allocated and currently in use, excluding pooled buffers
+    size_t getLiveBytes() const;
+
+    /// maximum of getLiveBytes() since start or resetPeakBytes()
+    size_t getPeakBytes() const;
+
+    /// bytes in released buffers kept for reuse
+    size_t getPooledBytes() const;
+
+    void resetPeakBytes();
+
+    size_t getMaxPooledBytes() const;
+    void setMaxPooledBytes(size_t maxPooledBytes);
+
+    /// free all pooled buffers
+    void clear();
+
+    /// @return the size-class (bytes actually allocated) for a request of bytes
+    static size_t sizeClass(size_t bytes);
+
+private:
+    ArrayPool();
+    ~ArrayPool();
+    ArrayPool(const ArrayPool&) = delete;
+    ArrayPool& operator=(const ArrayPool&) = delete;
+
+    struct Impl;
+    std::unique_ptr<Impl> p_;
+};
+
+/**
+ * deleter for shared_array, returning the memory to the ArrayPool
+ */
+template <typename T>
+struct ArrayPoolDeleter
+{
+    size_t bytes;
+    explicit ArrayPoolDeleter(size_t bytes)
+        : bytes(bytes)
+    {
+    }
+    void operator()(T* ptr) const { ArrayPool::instance().release(ptr, bytes); }
+};
+
+namespace detail {
+
+template <typename T>
+shared_array<T> make_pooled_array(size_t size, std::true_type /*trivial*/)
+{
+    const size_t bytes = size * sizeof(T);
+    return shared_array<T>(static_cast<T*>(ArrayPool::instance().allocate(bytes)), ArrayPoolDeleter<T>(bytes));
+}
+
+template <typename T>
+shared_array<T> make_pooled_array(size_t size, std::false_type /*trivial*/)
+{
+    return make_shared_array<T>(size);
+}
+
+} // namespace detail
+
+/**
+ * create an uninitialized array from the ArrayPool, aligned to
+ * ArrayPool::ALIGNMENT.
+ *
+ * Types which are not trivial, e.g. std::string, are allocated with new[].
+ */
+template <typename T>
+inline shared_array<T> make_pooled_array(size_t size)
+{
+    return detail::make_pooled_array<T>(size, std::integral_constant<bool, std::is_trivial<T>::value>());
+}
+
+} // namespace MetNoFimex
+
+#endif // FIMEX_ARRAYPOOL_H
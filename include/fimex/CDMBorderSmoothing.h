@@ -61,6 +61,15 @@ public:
 
         virtual double operator()(size_t curX, size_t curY, double valueI, double valueO) = 0;
 
+        /**
+         * Weights of the outer value for a smoothing that blends linearly, i.e.
+         * operator()(x, y, valueI, valueO) == (1-w)*valueI + w*valueO.
+         *
+         * @param weights output, w for all (x, y) at index y*sizeX+x
+         * @return false if the smoothing is not a linear blend and operator() must be used
+         */
+        virtual bool getWeights(std::vector<double>& weights) { return false; }
+
         virtual ~Smoothing() {}
 
     protected:
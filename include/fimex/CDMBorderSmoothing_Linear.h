@@ -43,8 +43,12 @@ public:
     CDMBorderSmoothing_Linear(size_t transitionWidth, size_t borderWidth)
         : transitionWidth_(transitionWidth), borderWidth_(borderWidth) { }
     virtual double operator()(size_t curX, size_t curY, double valueI, double valueO);
+    virtual bool getWeights(std::vector<double>& weights);
 
 private:
+    //! weight of the outer value, 0 => valueI, 1 => valueO
+    double alpha(size_t curX, size_t curY) const;
+
     size_t transitionWidth_, borderWidth_;
 };
 
@@ -287,6 +287,29 @@ public:
      * @warning this function is not completely thought through and might change
      */
     virtual void addPostprocess(InterpolatorProcess2d_p process);
+    /**
+     * set the memory for reprojected spatial vector components kept for their counterpart
+     *
+     * Reprojecting one component of a spatial vector requires to interpolate and rotate
+     * the counterpart, too. The rotated counterpart is kept until it is requested for
+     * the same slice, until the counterpart is requested at a later unlimited position,
+     * or until the kept components exceed maxBytes. Default is 64MB, 0 disables keeping
+     * counterparts.
+     *
+     * @param maxBytes maximum memory of kept components
+     */
+    virtual void setVectorHandoffMemory(size_t maxBytes);
+    /**
+     * set the size of the input tiles used to group a list of output points,
+     * e.g. stations from changeProjection(int, const std::vector<double>&, const std::vector<double>&)
+     *
+     * Each group of points reads only the input around its points, instead of one
+     * box around all points. Default is 0, reading one box. To have effect, this
+     * function must be set before calling changeProjection().
+     *
+     * @param tileSize number of input cells in x- and y-direction
+     */
+    virtual void setPointTileSize(size_t tileSize);
 };
 
 /**
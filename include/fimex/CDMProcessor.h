@@ -56,6 +56,23 @@ public:
      * @warning does not handle fill-values unless those are NaNs
      */
     void accumulate(const std::string& varName);
+    /**
+     * Limit the memory used for the running sums of accumulated variables.
+     *
+     * The running sums are kept as checkpoints, so accumulated slices can be
+     * requested in any order and for several variables without re-reading all
+     * previous slices. Above the limit, checkpoints are thinned out, or moved
+     * to a temporary file if spillToDisk is set. The temporary file is kept
+     * below 8 times maxBytes by thinning out its checkpoints, too.
+     *
+     * @param maxBytes memory limit, default 256MB
+     * @param spillToDisk keep thinned-out checkpoints in a temporary file
+     */
+    void setAccumulationMemory(size_t maxBytes, bool spillToDisk = false);
+    /**
+     * @return the memory currently used for the running sums of accumulated variables
+     */
+    size_t getAccumulationMemory() const;
     /**
      * mark a variable for de-accumulation along the unlimited dimension, i.e.
      * vnew(n) = vold(n)-vold(n-1)
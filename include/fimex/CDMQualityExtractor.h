@@ -28,8 +28,9 @@
 #define CDMQUALITYEXTRACTOR_H_
 
 #include "CDMReader.h"
-#include <vector>
 #include <map>
+#include <string>
+#include <vector>
 
 namespace MetNoFimex
 {
@@ -72,6 +73,11 @@ public:
      * Read and manipulate the data
      */
     virtual DataPtr getDataSlice(const std::string& varName, size_t unLimDimPos = 0);
+    /**
+     * Read and manipulate a subset of the data, reading only the
+     * corresponding subset of the status variable
+     */
+    virtual DataPtr getDataSlice(const std::string& varName, const SliceBuilder& sb);
     /**
      * Read the internals of statusVariable. This code is mainly thought for testing/debugging.
      */
@@ -106,6 +112,12 @@ private:
      * map of the variableName to the reader used for getting values of the statusVariable.
      */
     std::map<std::string, CDMReader_p> statusReaders;
+
+    /* compiled quality rules and masks cached per status-variable slice, see CDMQualityExtractor.cc */
+    struct Masks;
+    std::shared_ptr<Masks> masks_;
+
+    DataPtr applyQuality(const std::string& varName, DataPtr data, size_t unLimDimPos, const SliceBuilder* sb);
 };
 
 }
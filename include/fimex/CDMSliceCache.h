@@ -0,0 +1,81 @@
+/*
+ * Fimex, CDMSliceCache.h
+ *
+ * (C) Copyright 2019, met.no
+ *
+ * Project Info:  https://wiki.met.no/fimex/start
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#ifndef FIMEX_CDMSLICECACHE_H_
+#define FIMEX_CDMSLICECACHE_H_
+
+#include "fimex/CDMReader.h"
+
+#include <memory>
+
+namespace MetNoFimex {
+
+/**
+ * @headerfile fimex/CDMSliceCache.h
+ */
+/**
+ * CDMReader keeping recently read slices of another CDMReader in memory.
+ *
+ * Slices are cached with least-recently-used eviction, up to a
+ * configurable amount of memory. This helps pipelines where several
+ * downstream readers (interpolation, vertical conversion, merging) request
+ * the same slice from the underlying reader repeatedly.
+ *
+ * Data returned from the cache are shared with the cache and must not be
+ * modified in place; use asWritableFloat() / asWritableDouble(), which copy
+ * shared data, or clone() them.
+ */
+class CDMSliceCache : public CDMReader
+{
+public:
+    /**
+     * @param dataReader the reader to cache
+     * @param maxMemory maximum number of bytes kept in the cache; slices
+     *        larger than this are passed through without caching
+     */
+    CDMSliceCache(CDMReader_p dataReader, size_t maxMemory);
+    ~CDMSliceCache();
+
+    DataPtr getDataSlice(const std::string& varName, size_t unLimDimPos) override;
+    DataPtr getDataSlice(const std::string& varName, const SliceBuilder& sb) override;
+
+    /// number of slices served from the cache
+    size_t getHits() const;
+
+    /// number of slices read from the underlying reader
+    size_t getMisses() const;
+
+    /// number of bytes currently held by the cache
+    size_t getMemory() const;
+
+    /// maximum number of bytes held by the cache
+    size_t getMaxMemory() const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> p_;
+};
+
+} // namespace MetNoFimex
+
+#endif /* FIMEX_CDMSLICECACHE_H_ */
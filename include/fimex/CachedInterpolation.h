@@ -50,6 +50,22 @@ struct ReducedInterpolationDomain {
 
 typedef std::shared_ptr<ReducedInterpolationDomain> ReducedInterpolationDomain_p;
 
+/**
+ * Rectangular part of the output grid, together with the part of the input grid
+ * needed to interpolate it. Input positions are relative to the input of the
+ * CachedInterpolationInterface, i.e. to the reduced domain if there is one.
+ */
+struct InterpolationWindow {
+    size_t outXStart; //!< first x-index of the output window
+    size_t outXSize;  //!< x-size of the output window
+    size_t outYStart; //!< first y-index of the output window
+    size_t outYSize;  //!< y-size of the output window
+    size_t inXStart;  //!< first x-index of the required input
+    size_t inXSize;   //!< x-size of the required input
+    size_t inYStart;  //!< first y-index of the required input
+    size_t inYSize;   //!< y-size of the required input
+};
+
 /**
  * Interface for new cached spatial interpolation as used in #MetNoFimex::CDMInterpolator
  */
@@ -60,6 +76,33 @@ public:
 
     virtual shared_array<float> interpolateValues(shared_array<float> inData, size_t size, size_t& newSize) const = 0;
 
+    /**
+     * Interpolate only the output window of w. The default implementation interpolates
+     * the whole output grid and cuts out the window, it requires w to contain the whole input.
+     *
+     * @param inData the input data, x/y-sizes w.inXSize and w.inYSize
+     * @param size the size of the input data array
+     * @param newSize return the size of the output-array, w.outXSize*w.outYSize*z
+     * @param w window as returned by getWindow()
+     */
+    virtual shared_array<float> interpolateValues(shared_array<float> inData, size_t size, size_t& newSize, const InterpolationWindow& w) const;
+
+    /**
+     * Find the part of the input needed to interpolate a part of the output grid. The default
+     * implementation requires the whole input.
+     *
+     * @param outXStart first output x-index
+     * @param outXSize number of output x-positions
+     * @param outYStart first output y-index
+     * @param outYSize number of output y-positions
+     */
+    virtual InterpolationWindow getWindow(size_t outXStart, size_t outXSize, size_t outYStart, size_t outYSize) const;
+
+    /**
+     * Find the window for the x/y-part of the output slicebuilder sb.
+     */
+    InterpolationWindow getWindowForSlice(const SliceBuilder& sb) const;
+
     /** @return x-size of input array */
     size_t getInX() const { return inX; }
 
@@ -92,6 +135,17 @@ public:
      */
     virtual DataPtr getInputDataSlice(CDMReader_p reader, const std::string& varName, const SliceBuilder& sb) const;
 
+    /**
+     * Read the input data needed for the interpolation of window w. Other than the horizontal
+     * dimensions are read as in sb.
+     * @param reader
+     * @param varName
+     * @param sb a slicebuilder to reduce other than the horizontal dimensions
+     * @param w the window, as returned by getWindow()
+     * @return Data matching w for interpolateValues(inData, size, newSize, w)
+     */
+    virtual DataPtr getInputDataSlice(CDMReader_p reader, const std::string& varName, const SliceBuilder& sb, const InterpolationWindow& w) const;
+
     virtual DataPtr getOutputDataSlice(DataPtr data, const SliceBuilder& sb) const;
 
     /**
@@ -150,6 +204,10 @@ public:
      */
     shared_array<float> interpolateValues(shared_array<float> inData, size_t size, size_t& newSize) const override;
 
+    shared_array<float> interpolateValues(shared_array<float> inData, size_t size, size_t& newSize, const InterpolationWindow& w) const override;
+
+    InterpolationWindow getWindow(size_t outXStart, size_t outXSize, size_t outYStart, size_t outYSize) const override;
+
 private:
     /**
      * Create a reduced domain for later generation of a slicebuild to read a smaller domain.
@@ -187,6 +245,10 @@ public:
      * @param newSize return the size of the output-array
      */
     shared_array<float> interpolateValues(shared_array<float> inData, size_t size, size_t& newSize) const override;
+
+    shared_array<float> interpolateValues(shared_array<float> inData, size_t size, size_t& newSize, const InterpolationWindow& w) const override;
+
+    InterpolationWindow getWindow(size_t outXStart, size_t outXSize, size_t outYStart, size_t outYSize) const override;
 };
 
 } // namespace MetNoFimex
@@ -49,6 +49,19 @@ public:
      * @param size the size of both arrays
      */
     void reprojectValues(shared_array<float>& uValues, shared_array<float>& vValues, size_t size) const;
+    /**
+     *  reproject the vector values of a window of the spatial plane
+     *
+     * @param uValues the values in x-direction, x/y-sizes xSize and ySize. These will be changed in-place.
+     * @param vValues the values in y-direction, x/y-sizes xSize and ySize. These will be changed in-place.
+     * @param size the size of both arrays
+     * @param xStart first x-index of the window
+     * @param xSize x-size of the window
+     * @param yStart first y-index of the window
+     * @param ySize y-size of the window
+     */
+    void reprojectValues(shared_array<float>& uValues, shared_array<float>& vValues, size_t size, size_t xStart, size_t xSize, size_t yStart,
+                         size_t ySize) const;
     /**
      * reproject directions given in angles in degree
      * @param angles direction of vector in each grid-cell, given in degree
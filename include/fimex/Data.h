@@ -85,10 +85,20 @@ public:
     /// @brief retrieve data as uint64
     virtual shared_array<unsigned long long> asUInt64() const = 0;
 
-    /// @brief retrieve data as float (eventually copy)
+    /**
+     * @brief retrieve data as float (eventually copy)
+     *
+     * If the data is already float, the internal array is returned without
+     * copying. It must then not be modified, use asWritableFloat() instead.
+     */
     virtual shared_array<float> asFloat() const = 0;
 
-    /// @brief retrieve data as double
+    /**
+     * @brief retrieve data as double (eventually copy)
+     *
+     * If the data is already double, the internal array is returned without
+     * copying. It must then not be modified, use asWritableDouble() instead.
+     */
     virtual shared_array<double> asDouble() const = 0;
 
     /// @brief retrieve data as array of strings
@@ -164,6 +174,14 @@ public:
          * return the CDMDataType of this data
          */
     virtual CDMDataType getDataType() const = 0;
+
+    /**
+     * @brief check if the internal array is shared
+     *
+     * The array is shared if it is referenced outside this Data, e.g.
+     * by an array returned from asFloat() or given to createData().
+     */
+    virtual bool isArrayShared() const = 0;
 };
 
 /**
@@ -339,6 +357,22 @@ DataPtr createData(CDMDataType datatype, InputIterator first, InputIterator last
 
 DataPtr convertValues(const Data& data, CDMDataType newType);
 
+/**
+ * @brief retrieve data as float array which may be modified (copy-on-write)
+ *
+ * The internal array is returned without copying if the data is float
+ * and neither the data nor its array are shared, otherwise a copy is returned.
+ * Modifications of the array might therefore be visible in data.
+ */
+shared_array<float> asWritableFloat(const DataPtr& data);
+
+/**
+ * @brief retrieve data as double array which may be modified (copy-on-write)
+ *
+ * @see asWritableFloat
+ */
+shared_array<double> asWritableDouble(const DataPtr& data);
+
 } // namespace MetNoFimex
 
 #endif /*DATA_H_*/
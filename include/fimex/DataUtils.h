@@ -58,6 +58,68 @@ public:
     }
 };
 
+namespace detail {
+
+template <typename T, bool INTEGER = std::numeric_limits<T>::is_integer>
+struct ScaleArrayTraits
+{
+    static bool isnan(T) { return false; }
+    // integer output is rounded
+    static T cast(double v) { return static_cast<T>(round_half_away(v)); }
+};
+
+template <typename T>
+struct ScaleArrayTraits<T, false>
+{
+    static bool isnan(T v) { return v != v; }
+    static T cast(double v) { return static_cast<T>(v); }
+};
+
+} // namespace detail
+
+/**
+ * Scale an array using fill, offset and scale, the array version of ScaleValue.
+ *
+ * The array is processed in cache-sized blocks, first scaling all values and
+ * then replacing the fill values. Both loops are free of branches and function
+ * calls so that the compiler can vectorize them (at -O3). Large arrays are
+ * processed in parallel if compiled with OpenMP.
+ *
+ * @param in input array
+ * @param n size of in and out
+ * @param out output array, must not overlap with in
+ */
+template <typename IN, typename OUT>
+void scaleArray(const IN* in, size_t n, OUT* out, double oldFill, double oldScale, double oldOffset, double newFill, double newScale, double newOffset)
+{
+    typedef detail::ScaleArrayTraits<IN> InTraits;
+    typedef detail::ScaleArrayTraits<OUT> OutTraits;
+
+    const IN inFill = static_cast<IN>(oldFill);
+    const OUT outFill = static_cast<OUT>(newFill);
+    const double scale = oldScale / newScale;
+    const double offset = (oldOffset - newOffset) / newScale;
+
+    const long blockSize = 16384;
+    const long nBlocks = (n + blockSize - 1) / blockSize;
+#ifdef _OPENMP
+#pragma omp parallel for default(shared) if (nBlocks > 4)
+#endif
+    for (long b = 0; b < nBlocks; ++b) {
+        const size_t start = b * blockSize;
+        const size_t end = std::min(n, start + blockSize);
+        for (size_t i = start; i < end; ++i) {
+            out[i] = OutTraits::cast(scale * in[i] + offset);
+        }
+        // separate loop, a select on computed values is not vectorized with -ftrapping-math
+        for (size_t i = start; i < end; ++i) {
+            const IN v = in[i];
+            const bool missing = (v == inFill) | InTraits::isnan(v);
+            out[i] = missing ? outFill : out[i];
+        }
+    }
+}
+
 /**
  * Scale a value using fill, offset and scale, and a units-converter
  */
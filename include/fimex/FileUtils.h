@@ -24,12 +24,16 @@
 #ifndef FIMEX_FILEUTILS_H_
 #define FIMEX_FILEUTILS_H_
 
+#include <functional>
 #include <regex>
 #include <string>
 #include <vector>
 
 namespace MetNoFimex {
 
+//! predicate selecting files in scanFiles, gets the file-name or the path behind the scanned directory
+typedef std::function<bool(const std::string&)> FileMatcher;
+
 /**
  * Scan the filesystem for files matching the regexp. Can be used similar to 'glob'
  * or 'find' commands. The files will be sorted alphabetically.
@@ -43,6 +47,37 @@ namespace MetNoFimex {
  */
 void scanFiles(std::vector<std::string>& files, const std::string& dir, int depth, const std::regex& regexp, bool matchFileOnly);
 
+/**
+ * Scan the filesystem for files accepted by the matcher. Subdirectories are
+ * scanned in parallel, the matcher must therefore be thread-safe.
+ *
+ * @param files output list of files, sorted as in scanFiles
+ * @param dir the input directory
+ * @param depth the maximum number of directories to search (-1 is indefinite)
+ * @param matcher the predicate for the file or the complete path
+ * @param matchFileOnly if true, the matcher gets the file-part only, if false,
+ *        the complete path (behind dir)
+ */
+void scanFiles(std::vector<std::string>& files, const std::string& dir, int depth, const FileMatcher& matcher, bool matchFileOnly);
+
+/**
+ * Matcher for files ending with suffix, cheaper than the regexp ".*suffix$".
+ */
+FileMatcher suffixMatcher(const std::string& suffix);
+
+/**
+ * Matcher for a glob as in globFiles, without regular expressions.
+ */
+FileMatcher globMatcher(const std::string& glob);
+
+/**
+ * Remember the contents of scanned directories in memory, together with the
+ * modification time of the directory. Directories are then only read again
+ * after they have been modified, which helps when the same directories are
+ * scanned repeatedly. Disabling clears the cache. Default is disabled.
+ */
+void setScanCache(bool enable);
+
 /**
  * Similar to scanFiles, but uses glob instead, with * matches everything within a file or directory-name, ? matches exactly one character (not /),
  * and ** match everything even across multiple directories.
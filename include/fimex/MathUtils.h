@@ -60,6 +60,17 @@ inline T clamp(T low, T value, T high)
     return high;
 }
 
+/**
+ * Round half away from zero, like ::lround, but returning a floating point
+ * value. This does not call the math library and allows vectorization of loops.
+ */
+template <typename T>
+inline T round_half_away(T x)
+{
+    const T t = std::trunc(x);
+    return t + std::copysign(T(std::fabs(x - t) >= T(0.5)), x);
+}
+
 /** Cast with rounding as functor.
  *
  * Rounding is used if destination type (OUT) is integer and original type (IN) is not.
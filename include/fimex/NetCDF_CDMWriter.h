@@ -95,6 +95,7 @@ private:
     std::map<std::string, unsigned int> variableCompression;
     std::map<std::string, unsigned int> dimensionChunkSize;
     std::map<std::string, std::string> dimensionNameChanges;
+    size_t prefetchMemory; /* bytes limiting the slices read ahead while another slice is written */
 };
 
 }
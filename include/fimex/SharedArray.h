@@ -66,6 +66,9 @@ public:
 
     operator bool() const { return static_cast<bool>(holder_); }
 
+    /// true if this is the only shared_array referencing the content
+    bool unique() const { return holder_.use_count() == 1; }
+
     T* get() { return holder_.get(); }
     const T* get() const { return holder_.get(); }
 
@@ -64,6 +64,10 @@ public:
     void convert(const std::string& from, const std::string& to, double& slope, double& offset);
     /**
      * Get a UnitsConverter which translates from 'from' unit to 'to' unit.
+     *
+     * Converters are cached process-wide, i.e. repeated requests for the same
+     * units return the same, thread-safe converter without parsing the units again.
+     *
      * @param from
      * @param to
      * @return a UnitsConverter object
@@ -100,6 +104,11 @@ private:
      * Needed in TimeUnit.
      */
     const void* exposeInternals() const;
+
+    /**
+     * create a new converter, bypassing the converter cache
+     */
+    UnitsConverter_p createConverter(const std::string& from, const std::string& to);
 };
 
 void handleUdUnitError(int unitErrCode, const std::string& message = "");
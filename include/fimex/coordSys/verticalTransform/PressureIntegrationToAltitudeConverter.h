@@ -35,6 +35,8 @@
 
 namespace MetNoFimex {
 
+struct VarFloat;
+
 /**
  * Conversion from pressure to height above MSL (i.e. altitude) integrating pressure levels using the hypsometric equation.
  * The pressure levels are initialized by a previous pressure-conversion.
@@ -57,12 +59,19 @@ public:
     std::vector<std::string> getShape() const;
     DataPtr getDataSlice(const SliceBuilder& sb) const;
 
+private:
+    std::shared_ptr<VarFloat> getSurfaceGeopotential(const SliceBuilder& sb) const;
+
 private:
     VerticalConverter_p pressure_;
     std::string air_temperature_;
     std::string specific_humidity_;
     std::string surface_air_pressure_;
     std::string surface_geopotential_;
+
+    //! pressure direction, surface geopotential and last altitude slice
+    struct Cache;
+    std::shared_ptr<Cache> cache_;
 };
 
 } // namespace MetNoFimex
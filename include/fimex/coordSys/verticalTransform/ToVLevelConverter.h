@@ -43,6 +43,45 @@
 
 namespace MetNoFimex {
 
+/**
+ * Vertical values for a block of columns at one time, see ToVLevelConverter::getTile.
+ */
+struct ToVLevelTile
+{
+    ToVLevelTile()
+        : x0(0)
+        , nx(0)
+        , y0(0)
+        , ny(0)
+        , t(0)
+        , nz(0)
+    {
+    }
+
+    size_t x0, nx, y0, ny, t;
+
+    //! number of levels per column
+    size_t nz;
+
+    //! vertical values, columns are contiguous: ((y-y0)*nx + (x-x0))*nz + z
+    std::vector<double> values;
+
+    //! minimum valid value per column, -inf if unbounded
+    std::vector<double> validityMin;
+
+    //! maximum valid value per column, +inf if unbounded
+    std::vector<double> validityMax;
+
+    bool contains(size_t x, size_t y, size_t tt) const
+        { return tt == t && x >= x0 && x < x0 + nx && y >= y0 && y < y0 + ny; }
+
+    size_t columnIndex(size_t x, size_t y) const
+        { return (y - y0) * nx + (x - x0); }
+
+    const double* column(size_t x, size_t y) const
+        { return &values[columnIndex(x, y) * nz]; }
+};
+
 /** Deprecated */
 class ToVLevelConverter
 {
@@ -62,6 +101,15 @@ public:
 
     /** Deprecated */
     virtual bool isValid(double val, size_t x, size_t y, size_t t) = 0;
+
+    /**
+     * Fetch the vertical values and validity bounds of all columns in
+     * [x0, x0+nx) x [y0, y0+ny) at time t in one go.
+     *
+     * The default implementation calls operator() for each column and
+     * cannot provide validity bounds.
+     */
+    virtual void getTile(size_t x0, size_t nx, size_t y0, size_t ny, size_t t, ToVLevelTile& tile);
 };
 
 } // namespace
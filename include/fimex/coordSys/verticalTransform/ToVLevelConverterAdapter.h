@@ -33,6 +33,11 @@
 
 #include "ToVLevelConverter.h"
 
+#include "fimex/DataDecl.h"
+
+#include <memory>
+#include <mutex>
+
 namespace MetNoFimex {
 
 // forward decl
@@ -44,17 +49,34 @@ class VerticalConverter;
 class ToVLevelConverterAdapter : public ToVLevelConverter {
 public:
     ToVLevelConverterAdapter(CDMReader_p reader, CoordinateSystem_cp cs, VerticalConverter_p converter, size_t unLimDimPos);
+    /**
+     * Get the column at (x, y, t). The values are served from a cached
+     * tile of neighbouring columns, which is read in one call to the
+     * VerticalConverter when (x, y, t) is outside the current tile.
+     * The tile is shared by all threads and replaced, not modified.
+     */
     virtual std::vector<double> operator()(size_t x, size_t y, size_t t);
     virtual bool isValid(double val, size_t x, size_t y, size_t t);
+    virtual void getTile(size_t x0, size_t nx, size_t y0, size_t ny, size_t t, ToVLevelTile& tile);
+
+    //! default number of columns in x- and y-direction of the cached tile
+    static const size_t TILE_SIZE = 64;
 
 private:
-    SliceBuilder prepareSliceBuilder(size_t x, size_t y, size_t t) const;
+    SliceBuilder prepareSliceBuilder(size_t x0, size_t nx, size_t y0, size_t ny, size_t t) const;
+    void getTileByColumn(size_t x0, size_t nx, size_t y0, size_t ny, size_t t, ToVLevelTile& tile);
+    std::vector<double> readValidity(DataPtr data, const std::vector<std::string>& shape, const SliceBuilder& sb, size_t nx, size_t ny, double unbounded) const;
+    void normalize(size_t& x, size_t& y, size_t& t) const;
+    std::shared_ptr<const ToVLevelTile> tileFor(size_t x, size_t y, size_t t);
 
 private:
     CDMReader_p reader_;
     VerticalConverter_p converter_;
     std::string varGeoX_, varGeoY_, varTime_;
+    size_t sizeX_, sizeY_;
     size_t unlimitedTimePos_;
+    std::mutex tileMutex_;
+    std::shared_ptr<const ToVLevelTile> tile_;
 };
 
 } // namespace MetNoFimex
@@ -532,6 +532,21 @@ extern int mifi_creepfillval2d_f(size_t nx, size_t ny, float* field, float defau
  */
 int mifi_griddistance(size_t nx, size_t ny, const double* lonVals, const double* latVals, float* gridDistX, float* gridDistY);
 
+/**
+ * Compute the map factors needed by mifi_compute_vertical_velocity_mf. They only depend on the horizontal grid
+ * and can be reused for all time-steps.
+ *
+ * @param nx size of grid in x direction
+ * @param ny size of grid in y direction
+ * @param dx x-grid-distance in projection-plane (m)
+ * @param dy y-grid-distance in projection-plane (m)
+ * @param gridDistX distance in m on surface between two grid points in x-direction (nx*ny)
+ * @param gridDistY distance in m on surface between two grid points in y-direction (nx*ny)
+ * @param mapFactors output, must be preallocated (4*nx*ny): gridDistX/dx, gridDistY/dy and their inverses
+ * @return MIFI_OK/MIFI_ERROR
+ */
+int mifi_vertical_velocity_map_factors(size_t nx, size_t ny, double dx, double dy, const float* gridDistX, const float* gridDistY, double* mapFactors);
+
 /**
  * Compute vertical velocity from continuity equation, integrating over all model-levels. Derived from compw.f: J.E. Haugen, (C) 1995 DNMI
  *
@@ -556,6 +571,14 @@ size_t mifi_compute_vertical_velocity(size_t nx, size_t ny, size_t nz, double dx
                           const float* zs, const float* ps, const float* u, const float* v, const float* t,
                           float* w);
 
+/**
+ * Same as mifi_compute_vertical_velocity, but with map factors precomputed by mifi_vertical_velocity_map_factors
+ * instead of gridDistX and gridDistY.
+ */
+size_t mifi_compute_vertical_velocity_mf(size_t nx, size_t ny, size_t nz, double dx, double dy, const double* mapFactors, const double* ap, const double* b,
+                          const float* zs, const float* ps, const float* u, const float* v, const float* t,
+                          float* w);
+
 
 /**
  * Convert bad-values to nan. The mifi_ functions don't handle bad values generally, but
@@ -216,6 +216,18 @@ extern float mifi_dewpoint_to_relative_humidity(float dew, float t);
  */
 extern float mifi_barometric_layer_thickness(float p_low_alti, float p_high_alti, float T);
 
+/**
+ * integrate the altitude of n columns by one layer using the
+ * hypsometric equation, see mifi_barometric_layer_thickness
+ * @param n number of columns
+ * @param p_low_alti pressure at lower altitude in hPa, set to p_high_alti on return
+ * @param p_high_alti pressure at higher altitude in hPa
+ * @param T (virtual) temperature of the layer in K
+ * @param altitude altitude at p_low_alti in m, altitude at p_high_alti on return
+ * @return MIFI_OK
+ */
+extern int mifi_barometric_layer_altitude(size_t n, float* p_low_alti, const float* p_high_alti, const float* T, double* altitude);
+
 /**
  * convert a standard_name="ocean_s_coordinate_g1" to z using the
  * formula  z(k) = h_c*sigma(k) + C(k)*(h - h_c) + zeta*(1+(h_c*sigma(k)+C(k)*(h-h_c)/h))
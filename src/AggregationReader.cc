@@ -23,6 +23,8 @@
 
 #include "fimex/AggregationReader.h"
 
+#include "MutexLock.h"
+
 #include "fimex/CDM.h"
 #include "fimex/CDMException.h"
 #include "fimex/Data.h"
@@ -31,19 +33,166 @@
 #include "fimex/StringUtils.h"
 #include "fimex/Type2String.h"
 
-#include <cassert>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <list>
+#include <map>
 #include <memory>
 #include <regex>
 
+#include <sys/stat.h>
+#include <unistd.h>
+
 namespace MetNoFimex {
 
 namespace {
 Logger_p logger = getLogger("fimex.AggregationReader");
+
+//! consecutive positions of the unlimited dimension read from one reader
+struct UnLimRun
+{
+    size_t reader;      //!< index in readers_
+    size_t readerStart; //!< start of the unlimited dimension in the reader
+    size_t start;       //!< start in the requested slice
+    size_t size;
+};
+
+//! a member of a joinExisting aggregation, as remembered in the manifest
+struct ManifestMember
+{
+    long long mtime;
+    long long mtimeNsec;
+    unsigned long long inode;
+    long long size;
+    bool matching; //!< false if the member does not have the unlimited dimension of the aggregation
+    size_t length; //!< length of the unlimited dimension
+    std::vector<double> values; //!< values of the unlimited coordinate, if joined
+};
+typedef std::pair<std::string, ManifestMember> ManifestEntry;
+typedef std::map<std::string, ManifestMember> ManifestMembers;
+
+const char MANIFEST_MAGIC[] = "fimex-aggregation-manifest";
+const int MANIFEST_VERSION = 2;
+
+//! get modification time, inode and size of a member, false if it is not a regular file
+bool statMember(const std::string& id, ManifestMember& member)
+{
+    struct stat sb;
+    if (stat(id.c_str(), &sb) != 0 || !S_ISREG(sb.st_mode))
+        return false;
+    member.mtime = sb.st_mtime;
+#if defined(__APPLE__)
+    member.mtimeNsec = sb.st_mtimespec.tv_nsec;
+#elif defined(__linux__)
+    member.mtimeNsec = sb.st_mtim.tv_nsec;
+#else
+    member.mtimeNsec = 0; // seconds only, the inode and size still detect most changes
+#endif
+    member.inode = sb.st_ino;
+    member.size = sb.st_size;
+    return true;
+}
+
+//! true if the file has not been modified or replaced since a was written to the manifest
+bool unchangedMember(const ManifestMember& a, const ManifestMember& b)
+{
+    return a.mtime == b.mtime && a.mtimeNsec == b.mtimeNsec && a.inode == b.inode && a.size == b.size;
+}
+
+ManifestMembers readManifest(const std::string& file, const std::string& uDimName, bool withValues)
+{
+    ManifestMembers members;
+    std::ifstream in(file.c_str());
+    if (!in) {
+        LOG4FIMEX(logger, Logger::DEBUG, "no manifest '" << file << "'");
+        return members;
+    }
+    std::string magic, unlimited, name;
+    int version = 0, values = 0;
+    in >> magic >> version >> unlimited >> name >> values;
+    if (!in || magic != MANIFEST_MAGIC || version != MANIFEST_VERSION || unlimited != "unlimited" || name != uDimName || (values != 0) != withValues) {
+        LOG4FIMEX(logger, Logger::INFO, "ignoring manifest '" << file << "' of other aggregation or version");
+        return members;
+    }
+    std::string tag;
+    while (in >> tag) {
+        ManifestMember m;
+        int matching = 0;
+        std::string id;
+        if (tag != "member" || !(in >> m.mtime >> m.mtimeNsec >> m.inode >> m.size >> matching >> m.length) || !std::getline(in >> std::ws, id)) {
+            LOG4FIMEX(logger, Logger::WARN, "ignoring corrupt manifest '" << file << "'");
+            return ManifestMembers();
+        }
+        m.matching = (matching != 0);
+        if (withValues && m.matching) {
+            m.values.reserve(m.length);
+            std::string v;
+            for (size_t j = 0; j < m.length && (in >> v); ++j)
+                m.values.push_back(std::strtod(v.c_str(), 0));
+            if (m.values.size() != m.length) {
+                LOG4FIMEX(logger, Logger::WARN, "ignoring corrupt manifest '" << file << "'");
+                return ManifestMembers();
+            }
+        }
+        members[id] = m;
+    }
+    LOG4FIMEX(logger, Logger::DEBUG, "read " << members.size() << " members from manifest '" << file << "'");
+    return members;
 }
 
+void writeManifest(const std::string& file, const std::string& uDimName, bool withValues, const std::vector<ManifestEntry>& members)
+{
+    // write to a temporary file and rename, other processes might read the manifest meanwhile
+    const std::string tmp = file + ".tmp" + type2string(getpid());
+    {
+        std::ofstream out(tmp.c_str());
+        out << std::setprecision(17);
+        out << MANIFEST_MAGIC << ' ' << MANIFEST_VERSION << '\n';
+        out << "unlimited " << uDimName << ' ' << (withValues ? 1 : 0) << '\n';
+        for (const ManifestEntry& im : members) {
+            const ManifestMember& m = im.second;
+            out << "member " << m.mtime << ' ' << m.mtimeNsec << ' ' << m.inode << ' ' << m.size << ' ' << (m.matching ? 1 : 0) << ' ' << m.length << ' ' << im.first << '\n';
+            if (withValues && m.matching) {
+                for (size_t j = 0; j < m.values.size(); ++j)
+                    out << (j ? " " : "") << m.values[j];
+                out << '\n';
+            }
+        }
+        out.close();
+        if (!out) {
+            LOG4FIMEX(logger, Logger::WARN, "cannot write manifest '" << tmp << "'");
+            std::remove(tmp.c_str());
+            return;
+        }
+    }
+    if (std::rename(tmp.c_str(), file.c_str()) != 0) {
+        LOG4FIMEX(logger, Logger::WARN, "cannot write manifest '" << file << "'");
+        std::remove(tmp.c_str());
+        return;
+    }
+    LOG4FIMEX(logger, Logger::DEBUG, "wrote " << members.size() << " members to manifest '" << file << "'");
+}
+} // namespace
+
+struct AggregationReader::Impl
+{
+    //! openers of lazy readers, by position in readers_, empty for other readers
+    std::vector<ReaderOpener> openers;
+    //! open lazy readers, least recently used first
+    std::list<size_t> openLazy;
+    size_t maxOpen;
+    OmpMutex mutex;
+    std::string manifest;
+};
+
 AggregationReader::AggregationReader(const std::string& aggregationType)
     : aggType_(aggregationType)
+    , p_(new Impl)
 {
+    p_->maxOpen = 256;
 }
 
 AggregationReader::~AggregationReader() {}
@@ -60,13 +209,94 @@ void AggregationReader::addReader(CDMReader_p reader, const std::string& id)
     }
 }
 
+void AggregationReader::addLazyReader(ReaderOpener opener, const std::string& id)
+{
+    addReader(CDMReader_p(), id);
+    p_->openers.resize(readers_.size());
+    p_->openers.back() = opener;
+}
+
+void AggregationReader::setMaxOpenReaders(size_t maxOpen)
+{
+    OmpScopedLock lock(p_->mutex);
+    p_->maxOpen = std::max(maxOpen, size_t(1));
+}
+
+void AggregationReader::setManifest(const std::string& manifestFile)
+{
+    p_->manifest = manifestFile;
+}
+
+CDMReader_p AggregationReader::getReader(size_t i)
+{
+    ReaderOpener opener;
+    {
+        OmpScopedLock lock(p_->mutex);
+        CDMReader_p reader = readers_.at(i).second;
+        if (i >= p_->openers.size() || !p_->openers[i])
+            return reader; // not lazy
+        if (reader) {
+            // mark as most recently used
+            p_->openLazy.remove(i);
+            p_->openLazy.push_back(i);
+            return reader;
+        }
+        opener = p_->openers[i];
+    }
+
+    // open without lock, other readers may be opened or read meanwhile
+    LOG4FIMEX(logger, Logger::DEBUG, "opening '" << readers_.at(i).first << "'");
+    CDMReader_p reader = opener();
+
+    OmpScopedLock lock(p_->mutex);
+    if (readers_.at(i).second) {
+        // opened by another thread meanwhile
+        reader = readers_.at(i).second;
+        p_->openLazy.remove(i);
+    } else {
+        readers_.at(i).second = reader;
+    }
+    p_->openLazy.push_back(i);
+    while (p_->openLazy.size() > p_->maxOpen) {
+        // readers still in use stay alive until they are released
+        const size_t close = p_->openLazy.front();
+        p_->openLazy.pop_front();
+        LOG4FIMEX(logger, Logger::DEBUG, "closing '" << readers_.at(close).first << "'");
+        readers_.at(close).second.reset();
+    }
+    return reader;
+}
+
+CDMReader_p AggregationReader::tryGetReader(size_t i)
+{
+    try {
+        return getReader(i);
+    } catch (std::exception& ex) {
+        LOG4FIMEX(logger, Logger::ERROR, "cannot read file '" << readers_.at(i).first << "': " << ex.what());
+        dropReader(i);
+        return CDMReader_p();
+    }
+}
+
+void AggregationReader::dropReader(size_t i)
+{
+    OmpScopedLock lock(p_->mutex);
+    readers_.at(i).second.reset();
+    if (i < p_->openers.size())
+        p_->openers[i] = ReaderOpener();
+    p_->openLazy.remove(i);
+}
+
 void AggregationReader::initAggregation()
 {
     // find the reference-file, choose penultimate, no readers also possible
     if (readers_.size() == 1) {
-        gDataReader_ = readers_.at(0).second;
+        gDataReader_ = tryGetReader(0);
     } else if (readers_.size() > 1) {
-        gDataReader_ = readers_.at(readers_.size() - 2).second;
+        // lazy readers might not open, try the others then
+        gDataReader_ = tryGetReader(readers_.size() - 2);
+        for (size_t i = readers_.size(); !gDataReader_ && i > 0; --i)
+            gDataReader_ = tryGetReader(i - 1);
     }
     if (gDataReader_)
         *(this->cdm_) = gDataReader_->getCDM();
@@ -89,17 +319,89 @@ void AggregationReader::initAggregation()
             }
         }
         const std::string& uDimName = uDim->getName();
+        // with lazy readers, keep the values of the unlimited coordinate, read while the files are open anyway
+        const bool joinUnLimCoordinate = !p_->openers.empty() && cdm_->hasVariable(uDimName) &&
+                                         cdm_->getVariable(uDimName).getShape() == std::vector<std::string>(1, uDimName);
+        const CDMDataType uDimType = cdm_->hasVariable(uDimName) ? cdm_->getVariable(uDimName).getDataType() : CDM_NAT;
+        bool useManifest = !p_->manifest.empty();
+        // coordinate values are kept as double in the manifest
+        if (useManifest && joinUnLimCoordinate && (uDimType == CDM_STRING || uDimType == CDM_STRINGS || uDimType == CDM_INT64 || uDimType == CDM_UINT64)) {
+            LOG4FIMEX(logger, Logger::WARN, "not using manifest '" << p_->manifest << "' for " << datatype2string(uDimType) << " coordinate " << uDimName);
+            useManifest = false;
+        }
+        ManifestMembers known;
+        if (useManifest)
+            known = readManifest(p_->manifest, uDimName, joinUnLimCoordinate);
+        std::vector<ManifestEntry> manifest;
+        bool manifestChanged = false;
+
+        std::vector<DataPtr> unLimCoordinates;
         for (size_t i = 0; i < readers_.size(); ++i) {
-            auto& id_rd = readers_[i];
-            const CDMDimension* readerUdim = id_rd.second->getCDM().getUnlimitedDim();
-            if (readerUdim == 0 || (readerUdim->getName() != uDimName)) {
-                LOG4FIMEX(logger, Logger::INFO, "file '" << id_rd.first << "' does not have matching unlimited dimension: " << uDimName);
-                id_rd.second.reset(); // no longer needed-
+            const std::string& id = readers_[i].first;
+            ManifestMember member;
+            const bool inManifest = useManifest && statMember(id, member);
+            if (inManifest) {
+                const ManifestMembers::iterator it = known.find(id);
+                if (it != known.end() && unchangedMember(it->second, member)) {
+                    // unchanged since written to the manifest, no need to open it
+                    member = it->second;
+                    known.erase(it);
+                    manifest.push_back(std::make_pair(id, member));
+                    if (!member.matching) {
+                        dropReader(i);
+                        continue;
+                    }
+                    for (size_t j = 0; j < member.length; ++j) {
+                        readerUdimPos_.push_back(std::make_pair(i, j));
+                    }
+                    if (joinUnLimCoordinate)
+                        unLimCoordinates.push_back(createData(uDimType, member.values.begin(), member.values.end()));
+                    continue;
+                }
+            }
+
+            CDMReader_p reader = tryGetReader(i);
+            if (!reader)
+                continue;
+            const CDMDimension* readerUdim = reader->getCDM().getUnlimitedDim();
+            member.matching = (readerUdim != 0 && readerUdim->getName() == uDimName);
+            member.length = 0;
+            if (!member.matching) {
+                LOG4FIMEX(logger, Logger::INFO, "file '" << id << "' does not have matching unlimited dimension: " << uDimName);
+                dropReader(i); // no longer needed
             } else {
+                member.length = readerUdim->getLength();
                 for (size_t j = 0; j < readerUdim->getLength(); ++j) {
                     readerUdimPos_.push_back(std::make_pair(i, j));
                 }
+                if (joinUnLimCoordinate) {
+                    DataPtr values = reader->getData(uDimName);
+                    unLimCoordinates.push_back(values);
+                    if (inManifest) {
+                        shared_array<double> dv = values->asDouble();
+                        member.values.assign(dv.get(), dv.get() + values->size());
+                    }
+                }
             }
+            if (inManifest) {
+                manifest.push_back(std::make_pair(id, member));
+                manifestChanged = true;
+            }
+        }
+        // rewrite the manifest if members were new, changed or removed
+        if (useManifest && (manifestChanged || !known.empty()))
+            writeManifest(p_->manifest, uDimName, joinUnLimCoordinate, manifest);
+        if (joinUnLimCoordinate) {
+            DataPtr joined = createData(cdm_->getVariable(uDimName).getDataType(), readerUdimPos_.size(), cdm_->getFillValue(uDimName));
+            size_t pos = 0;
+            for (DataPtr d : unLimCoordinates) {
+                if (pos + d->size() > readerUdimPos_.size())
+                    break;
+                joined->setValues(pos, *d);
+                pos += d->size();
+            }
+            if (pos == readerUdimPos_.size())
+                cdm_->getVariable(uDimName).setData(joined);
         }
         // change size of unlimited dimension
         CDMDimension& ulimDim = cdm_->getDimension(uDim->getName());
@@ -107,8 +409,11 @@ void AggregationReader::initAggregation()
     } else if (aggType_ == "union") {
         // join variables/dimensions from union, remember variable->datasource map
         for (size_t ir = 0; ir < readers_.size(); ++ir) {
-            auto& id_rd = readers_[ir];
-            const CDM& rCdm = id_rd.second->getCDM();
+            const CDMReader_p reader = tryGetReader(ir);
+            if (!reader)
+                continue;
+            const auto& id_rd = readers_[ir];
+            const CDM& rCdm = reader->getCDM();
             for (const CDMVariable& rv : rCdm.getVariables()) {
                 const CDM::VarVec& knownVars = cdm_->getVariables();
                 if (find_if(knownVars.begin(), knownVars.end(), CDMNameEqual(rv.getName())) == knownVars.end()) {
@@ -181,7 +486,7 @@ DataPtr AggregationReader::getDataSlice(const std::string& varName, size_t unLim
             LOG4FIMEX(logger, Logger::DEBUG,
                       "fetching data from " << readers_.at(readerUdimPos_.at(unLimDimPos).first).first << " at uDimPos "
                                             << readerUdimPos_.at(unLimDimPos).second);
-            return readers_.at(readerUdimPos_.at(unLimDimPos).first).second->getDataSlice(varName, readerUdimPos_.at(unLimDimPos).second);
+            return getReader(readerUdimPos_.at(unLimDimPos).first)->getDataSlice(varName, readerUdimPos_.at(unLimDimPos).second);
         }
         LOG4FIMEX(logger, Logger::DEBUG, "fetching data from default reader");
         return gDataReader_->getDataSlice(varName, unLimDimPos);
@@ -190,9 +495,9 @@ DataPtr AggregationReader::getDataSlice(const std::string& varName, size_t unLim
             LOG4FIMEX(logger, Logger::DEBUG, "fetching data from default reader");
             return gDataReader_->getDataSlice(varName, unLimDimPos);
         } else {
-            std::pair<std::string, CDMReader_p>& r = readers_.at(varReader_[varName]);
-            LOG4FIMEX(logger, Logger::DEBUG, "fetching data of " << varName << " from " << r.first);
-            return r.second->getDataSlice(varName, unLimDimPos);
+            const size_t ir = varReader_[varName];
+            LOG4FIMEX(logger, Logger::DEBUG, "fetching data of " << varName << " from " << readers_.at(ir).first);
+            return getReader(ir)->getDataSlice(varName, unLimDimPos);
         }
     }
     return gDataReader_->getDataSlice(varName, unLimDimPos);
@@ -234,30 +539,66 @@ DataPtr AggregationReader::getDataSlice(const std::string& varName, const SliceB
             if (unLimDimSize == 0 || unLimSliceSize == 0) {
                 return createData(variable.getDataType(), 0);
             }
-            // read now each unlimdim-slice
-            // slice that slice according to the other dimensions
-            // join those slices
-            DataPtr retData = createData(variable.getDataType(), unLimSliceSize * unLimDimSize, cdm_->getFillValue(varName));
+            // join consecutive positions of the same reader to one read
+            std::vector<UnLimRun> runs;
             for (size_t i = 0; i < unLimDimSize; ++i) {
-                LOG4FIMEX(logger, Logger::DEBUG,
-                          "fetching data from " << readers_.at(readerUdimPos_.at(unLimDimStart + i).first).first << " at uDimPos "
-                                                << readerUdimPos_.at(unLimDimStart + i).second);
-                CDMReader_p reader = readers_.at(readerUdimPos_.at(i + unLimDimStart).first).second;
-                SliceBuilder sbi(reader->getCDM(), varName);
-                for (size_t j = 0; j < dimNames.size(); ++j) {
-                    if (dimNames.at(j) == unLimDim) {
-                        sbi.setStartAndSize(unLimDim, readerUdimPos_.at(i + unLimDimStart).second, 1);
-                    } else {
-                        sbi.setStartAndSize(dimNames.at(j), dimStart.at(j), dimSize.at(j));
-                    }
+                const std::pair<size_t, size_t>& rPos = readerUdimPos_.at(unLimDimStart + i);
+                if (!runs.empty() && runs.back().reader == rPos.first && runs.back().readerStart + runs.back().size == rPos.second) {
+                    runs.back().size += 1;
+                } else {
+                    UnLimRun run;
+                    run.reader = rPos.first;
+                    run.readerStart = rPos.second;
+                    run.start = i;
+                    run.size = 1;
+                    runs.push_back(run);
                 }
-                DataPtr unLimDimData = reader->getDataSlice(varName, sbi);
-                // gDataReader_->getDataSlice(varName, sb); //getDataSlice(varName, i+unLimDimStart);
-                if (unLimDimData->size() != 0) {
-                    assert(unLimDimData->size() == unLimSliceSize);
-                    retData->setValues(i * unLimSliceSize, *unLimDimData);
+            }
+            // all runs of one reader are read by the same thread
+            std::map<size_t, std::vector<size_t>> readerRuns;
+            for (size_t r = 0; r < runs.size(); ++r)
+                readerRuns[runs[r].reader].push_back(r);
+            std::vector<std::vector<size_t>> jobs;
+            for (const auto& rr : readerRuns)
+                jobs.push_back(rr.second);
+
+            // read the runs and put them at their position along the unlimited dimension
+            DataPtr retData = createData(variable.getDataType(), unLimSliceSize * unLimDimSize, cdm_->getFillValue(varName));
+            std::vector<std::string> errors(jobs.size());
+            const int nJobs = jobs.size();
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) default(shared) if (nJobs > 1)
+#endif
+            for (int job = 0; job < nJobs; ++job) {
+                try {
+                    for (size_t r : jobs[job]) {
+                        const UnLimRun& run = runs[r];
+                        const std::string& id = readers_.at(run.reader).first;
+                        const CDMReader_p reader = getReader(run.reader);
+                        LOG4FIMEX(logger, Logger::DEBUG, "fetching data from " << id << " at uDimPos " << run.readerStart << "+" << run.size);
+                        SliceBuilder sbi(reader->getCDM(), varName);
+                        for (size_t j = 0; j < dimNames.size(); ++j) {
+                            if (dimNames.at(j) == unLimDim) {
+                                sbi.setStartAndSize(unLimDim, run.readerStart, run.size);
+                            } else {
+                                sbi.setStartAndSize(dimNames.at(j), dimStart.at(j), dimSize.at(j));
+                            }
+                        }
+                        DataPtr unLimDimData = reader->getDataSlice(varName, sbi);
+                        if (unLimDimData->size() != 0) {
+                            if (unLimDimData->size() != run.size * unLimSliceSize)
+                                throw CDMException("unexpected data size " + type2string(unLimDimData->size()) + " of " + varName + " from " + id);
+                            retData->setValues(run.start * unLimSliceSize, *unLimDimData);
+                        }
+                    }
+                } catch (std::exception& ex) {
+                    errors[job] = ex.what();
                 }
             }
+            for (const std::string& error : errors) {
+                if (!error.empty())
+                    throw CDMException(error);
+            }
             return retData;
         }
         LOG4FIMEX(logger, Logger::DEBUG, "fetching data from default reader");
@@ -268,9 +609,8 @@ DataPtr AggregationReader::getDataSlice(const std::string& varName, const SliceB
             LOG4FIMEX(logger, Logger::DEBUG, "fetching data from default reader");
             return gDataReader_->getDataSlice(varName, sb);
         } else {
-            const auto& id_rd = readers_.at(it->second);
-            LOG4FIMEX(logger, Logger::DEBUG, "fetching data of " << varName << " from " << id_rd.first);
-            return id_rd.second->getDataSlice(varName, sb);
+            LOG4FIMEX(logger, Logger::DEBUG, "fetching data of " << varName << " from " << readers_.at(it->second).first);
+            return getReader(it->second)->getDataSlice(varName, sb);
         }
     }
     return gDataReader_->getDataSlice(varName, sb);
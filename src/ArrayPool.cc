@@ -0,0 +1,205 @@
+/*
+ * Fimex, ArrayPool.cc
+ *
+ * (C) Copyright 2019, met.no
+ *
+ * Project Info:  https://wiki.met.no/fimex/start
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include "fimex/ArrayPool.h"
+
+#include "fimex/String2Type.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace MetNoFimex {
+
+namespace {
+
+const size_t DEFAULT_MAX_POOLED_BYTES = 512 * 1024 * 1024;
+
+// number of size-classes between two powers of 2
+const size_t SUBCLASSES = 8;
+
+void* alignedAlloc(size_t bytes)
+{
+    void* ptr = 0;
+    if (posix_memalign(&ptr, ArrayPool::ALIGNMENT, bytes) != 0)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+} // namespace
+
+struct ArrayPool::Impl
+{
+    std::mutex mutex;
+    std::map<size_t, std::vector<void*>> buffers; //!< released buffers by size-class
+    size_t pooledBytes;
+    size_t maxPooledBytes;
+    std::atomic<size_t> liveBytes;
+    std::atomic<size_t> peakBytes;
+
+    Impl()
+        : pooledBytes(0)
+        , maxPooledBytes(DEFAULT_MAX_POOLED_BYTES)
+        , liveBytes(0)
+        , peakBytes(0)
+    {
+    }
+
+    void addLive(size_t bytes)
+    {
+        const size_t live = (liveBytes += bytes);
+        size_t peak = peakBytes.load();
+        while (live > peak && !peakBytes.compare_exchange_weak(peak, live)) {
+        }
+    }
+
+    // free buffers until pooledBytes <= maxBytes, call with mutex locked
+    void shrink(size_t maxBytes)
+    {
+        // largest buffers first
+        while (pooledBytes > maxBytes && !buffers.empty()) {
+            std::map<size_t, std::vector<void*>>::iterator it = --buffers.end();
+            while (pooledBytes > maxBytes && !it->second.empty()) {
+                std::free(it->second.back());
+                it->second.pop_back();
+                pooledBytes -= it->first;
+            }
+            if (it->second.empty())
+                buffers.erase(it);
+        }
+    }
+};
+
+ArrayPool& ArrayPool::instance()
+{
+    // never destroyed, arrays might be released during static destruction
+    static ArrayPool* pool = new ArrayPool();
+    return *pool;
+}
+
+ArrayPool::ArrayPool()
+    : p_(new Impl())
+{
+    if (const char* maxPooled = getenv("FIMEX_ARRAY_POOL_SIZE"))
+        p_->maxPooledBytes = string2type<size_t>(maxPooled);
+}
+
+ArrayPool::~ArrayPool()
+{
+    clear();
+}
+
+size_t ArrayPool::sizeClass(size_t bytes)
+{
+    if (bytes < MIN_POOLED_BYTES)
+        return ((bytes + ALIGNMENT - 1) / ALIGNMENT) * ALIGNMENT;
+    size_t power = MIN_POOLED_BYTES;
+    while (power <= bytes / 2)
+        power *= 2;
+    const size_t step = power / SUBCLASSES;
+    return ((bytes + step - 1) / step) * step;
+}
+
+void* ArrayPool::allocate(size_t bytes)
+{
+    const size_t cls = sizeClass(bytes == 0 ? 1 : bytes);
+    void* ptr = 0;
+    if (cls >= MIN_POOLED_BYTES) {
+        std::lock_guard<std::mutex> lock(p_->mutex);
+        std::map<size_t, std::vector<void*>>::iterator it = p_->buffers.find(cls);
+        if (it != p_->buffers.end()) {
+            ptr = it->second.back();
+            it->second.pop_back();
+            if (it->second.empty())
+                p_->buffers.erase(it);
+            p_->pooledBytes -= cls;
+        }
+    }
+    if (!ptr)
+        ptr = alignedAlloc(cls);
+    p_->addLive(cls);
+    return ptr;
+}
+
+void ArrayPool::release(void* ptr, size_t bytes)
+{
+    if (!ptr)
+        return;
+    const size_t cls = sizeClass(bytes == 0 ? 1 : bytes);
+    p_->liveBytes -= cls;
+    if (cls >= MIN_POOLED_BYTES) {
+        std::lock_guard<std::mutex> lock(p_->mutex);
+        if (cls <= p_->maxPooledBytes) {
+            p_->shrink(p_->maxPooledBytes - cls);
+            p_->buffers[cls].push_back(ptr);
+            p_->pooledBytes += cls;
+            return;
+        }
+    }
+    std::free(ptr);
+}
+
+size_t ArrayPool::getLiveBytes() const
+{
+    return p_->liveBytes;
+}
+
+size_t ArrayPool::getPeakBytes() const
+{
+    return p_->peakBytes;
+}
+
+void ArrayPool::resetPeakBytes()
+{
+    p_->peakBytes = p_->liveBytes.load();
+}
+
+size_t ArrayPool::getPooledBytes() const
+{
+    std::lock_guard<std::mutex> lock(p_->mutex);
+    return p_->pooledBytes;
+}
+
+size_t ArrayPool::getMaxPooledBytes() const
+{
+    std::lock_guard<std::mutex> lock(p_->mutex);
+    return p_->maxPooledBytes;
+}
+
+void ArrayPool::setMaxPooledBytes(size_t maxPooledBytes)
+{
+    std::lock_guard<std::mutex> lock(p_->mutex);
+    p_->maxPooledBytes = maxPooledBytes;
+    p_->shrink(maxPooledBytes);
+}
+
+void ArrayPool::clear()
+{
+    std::lock_guard<std::mutex> lock(p_->mutex);
+    p_->shrink(0);
+}
+
+} // namespace MetNoFimex
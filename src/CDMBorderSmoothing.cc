@@ -37,6 +37,9 @@
 #include "fimex/MathUtils.h"
 
 #include "CDMMergeUtils.h"
+#include "MutexLock.h"
+
+#include <map>
 
 using namespace MetNoFimex;
 using namespace std;
@@ -58,9 +61,45 @@ struct CDMBorderSmoothingPrivate {
     CDMBorderSmoothing::SmoothingFactory_p smoothingFactory;
     int gridInterpolationMethod;
 
+    //! blend weights by variable, empty if the smoothing is not linear
+    typedef std::shared_ptr<const vector<double> > Weights_p;
+    std::map<string, Weights_p> weights;
+    OmpMutex weightsMutex;
+
     CDM makeCDM();
+    Weights_p getWeights(const string& varName, size_t sizeX, size_t sizeY);
 };
 
+/**
+ * Blend layers of nx*ny values as valueI + w*(valueO - valueI), with NaN
+ * handling as in the per-point merge. The blend runs without branches so
+ * that it can be vectorised, undefined values are fixed in a second pass.
+ */
+static void mergeLayers(const double* valuesI, const double* valuesO, const double* weights, double* merged,
+                        size_t layerSize, size_t nLayers, bool useOuterIfInnerUndefined)
+{
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (long l = 0; l < static_cast<long>(nLayers); ++l) {
+        const size_t offset = l * layerSize;
+        const double* vi = valuesI + offset;
+        const double* vo = valuesO + offset;
+        double* vm = merged + offset;
+        // exact values at full weights, like CDMBorderSmoothing_Linear
+        for (size_t i = 0; i < layerSize; ++i)
+            vm[i] = (weights[i] >= 1) ? vo[i] : ((weights[i] <= 0) ? vi[i] : vi[i] + weights[i] * (vo[i] - vi[i]));
+        for (size_t i = 0; i < layerSize; ++i) {
+            if (mifi_isnan(vm[i])) {
+                if (mifi_isnan(vi[i]))
+                    vm[i] = useOuterIfInnerUndefined ? vo[i] : MIFI_UNDEFINED_D;
+                else
+                    vm[i] = vi[i];
+            }
+        }
+    }
+}
+
 // ========================================================================
 
 CDMBorderSmoothing::CDMBorderSmoothing(CDMReader_p inner, CDMReader_p outer, int grim)
@@ -82,7 +121,9 @@ CDMBorderSmoothing::~CDMBorderSmoothing() {}
 
 void CDMBorderSmoothing::setSmoothing(SmoothingFactory_p smoothingFactory)
 {
+    OmpScopedLock lock(p->weightsMutex);
     p->smoothingFactory = smoothingFactory;
+    p->weights.clear();
 }
 
 // ------------------------------------------------------------------------
@@ -123,16 +164,33 @@ DataPtr CDMBorderSmoothing::getDataSlice(const std::string &varName, size_t unLi
     if (dimSizes.empty())
         return sliceI;
 
+    if (shapeIdxX == 0 && shapeIdxY == 1) {
+        const size_t layerSize = dimSizes[0] * dimSizes[1];
+        const size_t n = sliceO->size();
+        CDMBorderSmoothingPrivate::Weights_p weights = p->getWeights(varName, dimSizes[0], dimSizes[1]);
+        if (weights && layerSize > 0 && sliceI->size() == n && n % layerSize == 0) {
+            shared_array<double> valuesI = sliceI->asDouble(), valuesO = sliceO->asDouble();
+            shared_array<double> merged(new double[n]);
+            mergeLayers(valuesI.get(), valuesO.get(), &(*weights)[0], merged.get(), layerSize, n / layerSize, p->useOuterIfInnerUndefined);
+            sliceO = createData(n, merged);
+            double scale = 1, offset = 0;
+            getScaleAndOffsetOf(varName, scale, offset);
+            return sliceO->convertDataType(MIFI_UNDEFINED_D, 1, 0, cdm_->getVariable(varName).getDataType(), cdm_->getFillValue(varName), scale, offset);
+        }
+    }
+
     Smoothing_p smoothing = (*p->smoothingFactory)(varName);
     smoothing->setHorizontalSizes(dimSizes[shapeIdxX], dimSizes[shapeIdxY]);
 
     const DataIndex idx(dimSizes);
+    // sliceO might be shared, e.g. by a slice cache
+    shared_array<double> valuesO = asWritableDouble(sliceO);
     
     vector<size_t> current(dimSizes.size(), 0);
     while (current.at(0) < dimSizes.at(0)) {
         const size_t pos = idx.getPos(current);
         const double valueI = sliceI->getDouble(pos);
-        const double valueO = sliceO->getDouble(pos);
+        const double valueO = valuesO[pos];
         double merged;
         if (mifi_isnan(valueI)) {
             merged = p->useOuterIfInnerUndefined ? valueO : MIFI_UNDEFINED_D;
@@ -141,7 +199,7 @@ DataPtr CDMBorderSmoothing::getDataSlice(const std::string &varName, size_t unLi
         } else {
             merged = (*smoothing)(current[shapeIdxX], current[shapeIdxY], valueI, valueO);
         }
-        sliceO->setValue(pos, merged);
+        valuesO[pos] = merged;
         
         size_t incIdx = 0;
         while (incIdx < current.size()) {
@@ -156,6 +214,7 @@ DataPtr CDMBorderSmoothing::getDataSlice(const std::string &varName, size_t unLi
         if (incIdx >= current.size())
             break;
     }
+    sliceO = createData(sliceO->size(), valuesO);
 
     double scale=1, offset=0;
     getScaleAndOffsetOf(varName, scale, offset);
@@ -171,4 +230,23 @@ CDM CDMBorderSmoothingPrivate::makeCDM()
     return makeMergedCDM(readerI, readerO, gridInterpolationMethod, interpolatedO, nameX, nameY);
 }
 
+CDMBorderSmoothingPrivate::Weights_p CDMBorderSmoothingPrivate::getWeights(const string& varName, size_t sizeX, size_t sizeY)
+{
+    OmpScopedLock lock(weightsMutex);
+    std::map<string, Weights_p>::const_iterator it = weights.find(varName);
+    if (it != weights.end())
+        return it->second;
+
+    Weights_p w;
+    CDMBorderSmoothing::Smoothing_p smoothing = (*smoothingFactory)(varName);
+    if (smoothing) {
+        smoothing->setHorizontalSizes(sizeX, sizeY);
+        std::shared_ptr<vector<double> > sw = std::make_shared<vector<double> >();
+        if (smoothing->getWeights(*sw) && sw->size() == sizeX * sizeY)
+            w = sw;
+    }
+    weights[varName] = w;
+    return w;
+}
+
 } // namespace MetNoFimex
@@ -27,7 +27,9 @@
 
 // fimex
 //
+#include "CachedCrossSectionInterpolation.h"
 #include "CachedForwardInterpolation.h"
+#include "MutexLock.h"
 #include "fimex/CDM.h"
 #include "fimex/CDMException.h"
 #include "fimex/CDMFileReaderFactory.h"
@@ -56,9 +58,11 @@
 #include <functional>
 #include <iterator>
 #include <limits>
+#include <list>
 #include <memory>
 #include <regex>
 #include <set>
+#include <sstream>
 #include <string>
 
 namespace MetNoFimex {
@@ -105,12 +109,108 @@ struct CDMInterpolator::Impl
     // horizontalId, cachedVectorReprojection
     typedef map<string, CachedVectorReprojection_p> cachedVectorReprojection_t;
     cachedVectorReprojection_t cachedVectorReprojection;
+
+    // rotated, not yet postprocessed vector components computed together with their
+    // counterpart, waiting to be requested, oldest first
+    struct VectorHandoff
+    {
+        std::string varName;
+        std::string sliceKey;
+        size_t unLimDimPos;
+        shared_array<float> values;
+        size_t size;
+    };
+    std::list<VectorHandoff> vectorHandoff;
+    size_t vectorHandoffBytes;
+    size_t maxVectorHandoffBytes;
+    OmpMutex vectorHandoffMutex;
+
+    // first output point of each cross-section while changing projection to cross-sections
+    std::vector<size_t> crossSectionStarts;
+    // input tile size for grouping a list of points, 0 = one box for all points
+    size_t pointTileSize;
+
+    void putVectorHandoff(const std::string& varName, const std::string& sliceKey, size_t unLimDimPos, shared_array<float> values, size_t size);
+    bool takeVectorHandoff(const std::string& varName, const std::string& sliceKey, size_t unLimDimPos, shared_array<float>& values, size_t& size);
+    void eraseVectorHandoff(std::list<VectorHandoff>::iterator it);
+    void shrinkVectorHandoff(size_t maxBytes);
 };
 
+void CDMInterpolator::Impl::eraseVectorHandoff(std::list<VectorHandoff>::iterator it)
+{
+    vectorHandoffBytes -= it->size * sizeof(float);
+    vectorHandoff.erase(it);
+}
+
+void CDMInterpolator::Impl::shrinkVectorHandoff(size_t maxBytes)
+{
+    while (!vectorHandoff.empty() && vectorHandoffBytes > maxBytes)
+        eraseVectorHandoff(vectorHandoff.begin());
+}
+
+void CDMInterpolator::Impl::putVectorHandoff(const std::string& varName, const std::string& sliceKey, size_t unLimDimPos, shared_array<float> values,
+                                             size_t size)
+{
+    OmpScopedLock lock(vectorHandoffMutex);
+    const size_t bytes = size * sizeof(float);
+    if (bytes > maxVectorHandoffBytes)
+        return;
+    for (std::list<VectorHandoff>::iterator it = vectorHandoff.begin(); it != vectorHandoff.end(); ++it) {
+        if (it->varName == varName && it->sliceKey == sliceKey) {
+            eraseVectorHandoff(it);
+            break;
+        }
+    }
+    shrinkVectorHandoff(maxVectorHandoffBytes - bytes);
+    VectorHandoff vh;
+    vh.varName = varName;
+    vh.sliceKey = sliceKey;
+    vh.unLimDimPos = unLimDimPos;
+    vh.values = values;
+    vh.size = size;
+    vectorHandoff.push_back(vh);
+    vectorHandoffBytes += bytes;
+}
+
+bool CDMInterpolator::Impl::takeVectorHandoff(const std::string& varName, const std::string& sliceKey, size_t unLimDimPos, shared_array<float>& values,
+                                              size_t& size)
+{
+    OmpScopedLock lock(vectorHandoffMutex);
+    bool found = false;
+    for (std::list<VectorHandoff>::iterator it = vectorHandoff.begin(); it != vectorHandoff.end();) {
+        if (it->varName != varName) {
+            ++it;
+        } else if (!found && it->sliceKey == sliceKey) {
+            values = it->values;
+            size = it->size;
+            eraseVectorHandoff(it++);
+            found = true;
+        } else if (it->unLimDimPos < unLimDimPos) {
+            // the variable is read at a later unlimited position, earlier slices will not be requested anymore
+            eraseVectorHandoff(it++);
+        } else {
+            ++it;
+        }
+    }
+    return found;
+}
+
 namespace {
 const std::string LAT_LON_PROJSTR = MIFI_WGS84_LATLON_PROJ4;
 Logger_p logger = getLogger("fimex.CDMInterpolator");
 
+// identify the slice requested by sb, independent of the variable
+std::string vectorSliceKey(const SliceBuilder& sb)
+{
+    std::ostringstream key;
+    const std::vector<std::string> dimNames = sb.getDimensionNames();
+    const std::vector<size_t>& starts = sb.getDimensionStartPositions();
+    const std::vector<size_t>& sizes = sb.getDimensionSizes();
+    for (size_t i = 0; i < dimNames.size(); ++i)
+        key << dimNames[i] << ':' << starts[i] << ':' << sizes[i] << ';';
+    return key.str();
+}
+
 } // namespace
 
 CDMInterpolator::CDMInterpolator(CDMReader_p dataReader)
@@ -120,6 +220,9 @@ CDMInterpolator::CDMInterpolator(CDMReader_p dataReader)
     p_->maxDistance = -1;
     p_->latitudeName = "lat";
     p_->longitudeName = "lon";
+    p_->vectorHandoffBytes = 0;
+    p_->maxVectorHandoffBytes = 64 * 1024 * 1024;
+    p_->pointTileSize = 0;
     enhanceVectorProperties(p_->dataReader); // set spatial-vectors
     listCoordinateSystems(p_->dataReader); // add eventually needed information to cdm (e.g. Time-axis in WRF)
     *cdm_ = p_->dataReader->getCDM();
@@ -131,7 +234,7 @@ CDMInterpolator::~CDMInterpolator()
 
 shared_array<float> data2InterpolationArray(const DataPtr& inData, double badValue)
 {
-    shared_array<float> array = inData->asFloat();
+    shared_array<float> array = asWritableFloat(inData);
     mifi_bad2nanf(&array[0], &array[inData->size()], badValue);
     return array;
 }
@@ -197,51 +300,79 @@ DataPtr CDMInterpolator::getDataSlice(const std::string& varName, const SliceBui
         throw CDMException("no cached interpolation for " + varName + "(" + horizontalId + ")");
 
     CachedInterpolationInterface_p ci = itCI->second;
-    DataPtr data = ci->getInputDataSlice(p_->dataReader, varName, sb);
-    if (data->size() == 0)
-        return data;
+
+    // pre- and postprocessing work on complete fields, so only without them the
+    // interpolation can be limited to the requested part of the output grid
+    const bool windowed = p_->preprocesses.empty() && p_->postprocesses.empty();
+    const InterpolationWindow w = windowed ? ci->getWindowForSlice(sb) : ci->CachedInterpolationInterface::getWindow(0, ci->getOutX(), 0, ci->getOutY());
 
     const double badValue = cdm_->getFillValue(varName);
-    shared_array<float> array = data2InterpolationArray(data, badValue);
-    processArray_(p_->preprocesses, array.get(), data->size(), ci->getInX(), ci->getInY());
+    const bool isVector = variable.isSpatialVector();
+    const std::string sliceKey = isVector ? vectorSliceKey(sb) : std::string();
+    size_t unLimDimPos = 0;
+    if (isVector) {
+        if (const CDMDimension* unLimDim = cdm_->getUnlimitedDim()) {
+            const std::vector<std::string>& shape = variable.getShape();
+            if (std::find(shape.begin(), shape.end(), unLimDim->getName()) != shape.end()) {
+                size_t unLimSize;
+                sb.getStartAndSize(unLimDim->getName(), unLimDimPos, unLimSize);
+            }
+        }
+    }
 
     size_t newSize = 0;
-    LOG4FIMEX(logger, Logger::DEBUG, "interpolateValues for: " << varName << "(slicebuilder)");
-    shared_array<float> iArray = ci->interpolateValues(array, data->size(), newSize);
-
-    if (variable.isSpatialVector()) {
-        // vector in x/y direction
-        const CDMVariable::SpatialVectorDirection dir = variable.getSpatialVectorDirection();
-        if (dir == CDMVariable::SPATIAL_VECTOR_X || dir == CDMVariable::SPATIAL_VECTOR_Y) {
-            bool can_reproject = false;
-            const std::string& counterpart = variable.getSpatialVectorCounterpart();
-            Impl::projectionVariables_t::const_iterator itC = p_->projectionVariables.find(counterpart);
-            if (itC != p_->projectionVariables.end() && horizontalId == itC->second) {
-                Impl::cachedVectorReprojection_t::iterator itV = p_->cachedVectorReprojection.find(horizontalId);
-                if (itV != p_->cachedVectorReprojection.end()) {
-                    CachedVectorReprojection_p cvr = itV->second;
-                    // fetch and transpose vector-data
-                    // transposing needed once for each direction (or caching, but that needs to much memory)
-                    shared_array<float> counterPartArray =
-                        data2InterpolationArray(ci->getInputDataSlice(p_->dataReader, counterpart, sb), cdm_->getFillValue(counterpart));
-                    processArray_(p_->preprocesses, counterPartArray.get(), data->size(), ci->getInX(), ci->getInY());
-                    LOG4FIMEX(logger, Logger::DEBUG, "implicit interpolateValues for: " << counterpart << "(slicebuilder)");
-                    shared_array<float> counterpartiArray = ci->interpolateValues(counterPartArray, data->size(), newSize);
-                    if (dir == CDMVariable::SPATIAL_VECTOR_X)
-                        cvr->reprojectValues(iArray, counterpartiArray, newSize);
-                    else
-                        cvr->reprojectValues(counterpartiArray, iArray, newSize);
-                    can_reproject = true;
+    shared_array<float> iArray;
+    if (isVector && p_->takeVectorHandoff(varName, sliceKey, unLimDimPos, iArray, newSize)) {
+        LOG4FIMEX(logger, Logger::DEBUG, "reprojected values for: " << varName << " kept from counterpart");
+    } else {
+        DataPtr data = ci->getInputDataSlice(p_->dataReader, varName, sb, w);
+        if (data->size() == 0)
+            return data;
+
+        shared_array<float> array = data2InterpolationArray(data, badValue);
+        processArray_(p_->preprocesses, array.get(), data->size(), w.inXSize, w.inYSize);
+
+        LOG4FIMEX(logger, Logger::DEBUG, "interpolateValues for: " << varName << "(slicebuilder)");
+        iArray = ci->interpolateValues(array, data->size(), newSize, w);
+
+        if (isVector) {
+            // vector in x/y direction
+            const CDMVariable::SpatialVectorDirection dir = variable.getSpatialVectorDirection();
+            if (dir == CDMVariable::SPATIAL_VECTOR_X || dir == CDMVariable::SPATIAL_VECTOR_Y) {
+                bool can_reproject = false;
+                const std::string& counterpart = variable.getSpatialVectorCounterpart();
+                Impl::projectionVariables_t::const_iterator itC = p_->projectionVariables.find(counterpart);
+                if (itC != p_->projectionVariables.end() && horizontalId == itC->second) {
+                    Impl::cachedVectorReprojection_t::iterator itV = p_->cachedVectorReprojection.find(horizontalId);
+                    if (itV != p_->cachedVectorReprojection.end()) {
+                        CachedVectorReprojection_p cvr = itV->second;
+                        // fetch and transpose vector-data, the rotated counterpart is
+                        // kept for a while in case it is requested for the same slice
+                        shared_array<float> counterPartArray =
+                            data2InterpolationArray(ci->getInputDataSlice(p_->dataReader, counterpart, sb, w), cdm_->getFillValue(counterpart));
+                        processArray_(p_->preprocesses, counterPartArray.get(), data->size(), w.inXSize, w.inYSize);
+                        LOG4FIMEX(logger, Logger::DEBUG, "implicit interpolateValues for: " << counterpart << "(slicebuilder)");
+                        shared_array<float> counterpartiArray = ci->interpolateValues(counterPartArray, data->size(), newSize, w);
+                        if (dir == CDMVariable::SPATIAL_VECTOR_X)
+                            cvr->reprojectValues(iArray, counterpartiArray, newSize, w.outXStart, w.outXSize, w.outYStart, w.outYSize);
+                        else
+                            cvr->reprojectValues(counterpartiArray, iArray, newSize, w.outXStart, w.outXSize, w.outYStart, w.outYSize);
+                        p_->putVectorHandoff(counterpart, sliceKey, unLimDimPos, counterpartiArray, newSize);
+                        can_reproject = true;
+                    }
                 }
+                if (!can_reproject)
+                    LOG4FIMEX(logger, Logger::WARN, "Cannot reproject vector " << variable.getName());
             }
-            if (!can_reproject)
-                LOG4FIMEX(logger, Logger::WARN, "Cannot reproject vector " << variable.getName());
         }
     }
 
-    processArray_(p_->postprocesses, iArray.get(), newSize, ci->getOutX(), ci->getOutY());
+    processArray_(p_->postprocesses, iArray.get(), newSize, w.outXSize, w.outYSize);
 
-    return ci->getOutputDataSlice(interpolationArray2Data(variable.getDataType(), iArray, newSize, badValue), sb);
+    DataPtr iData = interpolationArray2Data(variable.getDataType(), iArray, newSize, badValue);
+    if (windowed)
+        return iData; // already shaped as sb
+    return ci->getOutputDataSlice(iData, sb);
 }
 
 DataPtr CDMInterpolator::getDataSlice(const std::string& varName, size_t unLimDimPos)
@@ -397,6 +528,8 @@ void CDMInterpolator::changeProjection(int method, const string& proj_input, con
     }
     *cdm_ = p_->dataReader->getCDM(); // reset previous changes
     p_->projectionVariables.clear(); // reset variables
+    p_->vectorHandoff.clear();
+    p_->vectorHandoffBytes = 0;
     switch (method) {
     case MIFI_INTERPOL_NEAREST_NEIGHBOR:
     case MIFI_INTERPOL_BILINEAR:
@@ -600,7 +733,14 @@ void CDMInterpolator::changeProjectionToCrossSections(int method, const std::vec
     cdm_->addAttribute(vcrossBnds.getName(), CDMAttribute("description", "start- and end-position (included) in lat- and lon-dimensions for each vert. cross-section"));
 
     // do the real work of reprojection
-    changeProjection(method, lonVals, latVals);
+    p_->crossSectionStarts = startPositions;
+    try {
+        changeProjection(method, lonVals, latVals);
+    } catch (...) {
+        p_->crossSectionStarts.clear();
+        throw;
+    }
+    p_->crossSectionStarts.clear();
 }
 
 
@@ -617,6 +757,8 @@ void CDMInterpolator::changeProjection(int method, CDMReader_p tmplReader, const
 
     *cdm_ = p_->dataReader->getCDM(); // reset previous changes
     p_->projectionVariables.clear();  // reset variables
+    p_->vectorHandoff.clear();
+    p_->vectorHandoffBytes = 0;
     p_->cachedInterpolation.clear();
     p_->cachedVectorReprojection.clear();
 
@@ -692,6 +834,8 @@ map<string, CoordinateSystem_cp> CDMInterpolator::findBestCoordinateSystemsAndPr
     typedef map<string, CoordinateSystem_cp> CoordSysMap;
     CoordSysMap coordSysMap;
     p_->projectionVariables.clear();
+    p_->vectorHandoff.clear();
+    p_->vectorHandoffBytes = 0;
     vector<string> incompatibleVariables;
     if (0 == findBestHorizontalCoordinateSystems(withProjection, p_->dataReader, coordSysMap, p_->projectionVariables, incompatibleVariables)) {
         LOG4FIMEX(logger, Logger::ERROR, "no coordinate-systems" << (withProjection ? " with projection found, maybe you should try coordinate interpolation" : " found"));
@@ -1774,8 +1918,19 @@ void CDMInterpolator::changeProjectionByProjectionParametersToLatLonTemplate(int
         LOG4FIMEX(logger, Logger::DEBUG, "creating cached projection interpolation matrix ("<< csi->first << ") "
                   << def.xAxisData->size() << "x" << def.yAxisData->size()
                   << " => " << out_x_axis.size() << "x" << out_y_axis.size());
-        p_->cachedInterpolation[csi->first] = createCachedInterpolation(def.xAxisName, def.yAxisName, method, lonX, latY, def.xAxisData->size(),
-                                                                        def.yAxisData->size(), out_x_axis.size(), out_y_axis.size());
+        if (!p_->crossSectionStarts.empty() &&
+            (method == MIFI_INTERPOL_NEAREST_NEIGHBOR || method == MIFI_INTERPOL_BILINEAR || method == MIFI_INTERPOL_BICUBIC)) {
+            p_->cachedInterpolation[csi->first] = std::make_shared<CachedCrossSectionInterpolation>(
+                def.xAxisName, def.yAxisName, method, lonX, latY, def.xAxisData->size(), def.yAxisData->size(), p_->crossSectionStarts);
+        } else if (out_y_axis.size() == 1 && p_->pointTileSize > 0 &&
+                   (method == MIFI_INTERPOL_NEAREST_NEIGHBOR || method == MIFI_INTERPOL_BILINEAR || method == MIFI_INTERPOL_BICUBIC)) {
+            // a list of points, e.g. stations
+            p_->cachedInterpolation[csi->first] = std::make_shared<CachedCrossSectionInterpolation>(
+                def.xAxisName, def.yAxisName, method, lonX, latY, def.xAxisData->size(), def.yAxisData->size(), p_->pointTileSize);
+        } else {
+            p_->cachedInterpolation[csi->first] = createCachedInterpolation(def.xAxisName, def.yAxisName, method, lonX, latY, def.xAxisData->size(),
+                                                                            def.yAxisData->size(), out_x_axis.size(), out_y_axis.size());
+        }
 
         warnUnlessAllXYSpatialVectorsHaveSameHorizontalId(csi->first);
 
@@ -1875,4 +2030,16 @@ void CDMInterpolator::addPostprocess(InterpolatorProcess2d_p process)
     p_->postprocesses.push_back(process);
 }
 
+void CDMInterpolator::setVectorHandoffMemory(size_t maxBytes)
+{
+    OmpScopedLock lock(p_->vectorHandoffMutex);
+    p_->maxVectorHandoffBytes = maxBytes;
+    p_->shrinkVectorHandoff(maxBytes);
+}
+
+void CDMInterpolator::setPointTileSize(size_t tileSize)
+{
+    p_->pointTileSize = tileSize;
+}
+
 } // namespace MetNoFimex
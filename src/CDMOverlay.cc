@@ -86,11 +86,15 @@ DataPtr CDMOverlay::getDataSlice(const std::string &varName, size_t unLimDimPos)
 
     DataPtr sliceT = p->readerT->getScaledDataSlice(varName, unLimDimPos);
     DataPtr sliceB = p->interpolatedB->getScaledDataSlice(varName, unLimDimPos);
-    for (size_t i=0; i<sliceB->size(); ++i) {
+    // sliceB might be shared, e.g. by a slice cache
+    const size_t sizeB = sliceB->size();
+    shared_array<double> valuesB = asWritableDouble(sliceB);
+    for (size_t i=0; i<sizeB; ++i) {
       const double valueT = sliceT->getDouble(i);
       if (not mifi_isnan(valueT))
-        sliceB->setValue(i, valueT);
+        valuesB[i] = valueT;
     }
+    sliceB = createData(sizeB, valuesB);
 
     double scale=1, offset=0;
     getScaleAndOffsetOf(varName, scale, offset);
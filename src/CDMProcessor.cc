@@ -39,9 +39,13 @@
 #include "fimex/coordSys/verticalTransform/HybridSigmaPressure1.h"
 #include "fimex/interpolation.h"
 
+#include "MutexLock.h"
+
 #include <algorithm>
 #include <cassert>
+#include <cstdio>
 #include <functional>
+#include <map>
 #include <set>
 
 namespace MetNoFimex
@@ -55,12 +59,281 @@ typedef map<string, CoordinateSystem_cp> CoordSysMap;
 
 typedef std::shared_ptr<CachedVectorReprojection> CachedVectorReprojection_p;
 
-struct SliceCache {
-    string varName;
-    size_t ulimDimPos;
-    DataPtr data;
+namespace {
+
+/**
+ * Prefix sums P(n) = vold(0) + ... + vold(n) of accumulated variables,
+ * kept as checkpoints so that accumulation in any order of access
+ * only needs to read the slices after the nearest checkpoint.
+ *
+ * When the memory limit is exceeded, every other checkpoint is dropped
+ * (or written to a temporary file if spilling is enabled), keeping the
+ * recomputation needed for any position bounded. Spilled checkpoints are
+ * thinned out the same way above SPILL_FACTOR times the memory limit, and
+ * the temporary file is then rewritten without the dropped checkpoints.
+ *
+ * The store is used from parallel getDataSlice calls and locks itself.
+ */
+class AccumulationStore
+{
+public:
+    static const size_t DEFAULT_MAX_BYTES = 256 * 1024 * 1024;
+    static const size_t SPILL_FACTOR = 8;
+
+    AccumulationStore()
+        : maxBytes_(DEFAULT_MAX_BYTES)
+        , bytes_(0)
+        , spillEnabled_(false)
+        , spillFile_(0)
+        , spillBytes_(0)
+        , spillFileBytes_(0)
+    {
+    }
+
+    ~AccumulationStore()
+    {
+        if (spillFile_)
+            std::fclose(spillFile_);
+    }
+
+    void setLimits(size_t maxBytes, bool spill);
+
+    //! bytes of the checkpoints kept in memory
+    size_t bytes();
+
+    /**
+     * find the checkpoint at the highest position <= pos
+     * @param foundPos position of the checkpoint found
+     * @return the prefix sum, or null if no checkpoint
+     */
+    DataPtr find(const std::string& varName, size_t pos, size_t& foundPos);
+
+    /**
+     * add a checkpoint; the store keeps prefix, which must not be modified afterwards
+     */
+    void insert(const std::string& varName, size_t pos, DataPtr prefix);
+
+private:
+    struct Checkpoint
+    {
+        Checkpoint()
+            : spillOffset(-1)
+            , spillSize(0)
+        {
+        }
+        DataPtr data;      //!< null if spilled
+        long spillOffset;  //!< position in spill file, or -1
+        size_t spillSize;
+    };
+    typedef std::map<size_t, Checkpoint> Checkpoints;
+
+    void shrink(const std::string& keepVar, size_t keepPos);
+    bool spill(Checkpoint& cp);
+    DataPtr unspill(const Checkpoint& cp);
+    void dropSpilled(Checkpoint& cp);
+    void compactSpill();
+    void clearSpill();
+
+    OmpMutex mutex_;
+    std::map<std::string, Checkpoints> checkpoints_;
+    size_t maxBytes_;
+    size_t bytes_;
+    bool spillEnabled_;
+    std::FILE* spillFile_;
+    size_t spillBytes_;     //!< bytes of the spilled checkpoints
+    size_t spillFileBytes_; //!< size of the spill file, including dropped checkpoints
 };
 
+const size_t AccumulationStore::DEFAULT_MAX_BYTES;
+const size_t AccumulationStore::SPILL_FACTOR;
+
+size_t dataBytes(const DataPtr& data)
+{
+    return data->size() * data->bytes_for_one();
+}
+
+void AccumulationStore::setLimits(size_t maxBytes, bool spill)
+{
+    OmpScopedLock lock(mutex_);
+    maxBytes_ = maxBytes;
+    spillEnabled_ = spill;
+}
+
+size_t AccumulationStore::bytes()
+{
+    OmpScopedLock lock(mutex_);
+    return bytes_;
+}
+
+DataPtr AccumulationStore::find(const std::string& varName, size_t pos, size_t& foundPos)
+{
+    OmpScopedLock lock(mutex_);
+    std::map<std::string, Checkpoints>::iterator vit = checkpoints_.find(varName);
+    if (vit == checkpoints_.end())
+        return DataPtr();
+    Checkpoints& cps = vit->second;
+    Checkpoints::iterator it = cps.upper_bound(pos);
+    if (it == cps.begin())
+        return DataPtr();
+    --it;
+    foundPos = it->first;
+    if (it->second.data)
+        return it->second.data;
+    return unspill(it->second);
+}
+
+void AccumulationStore::insert(const std::string& varName, size_t pos, DataPtr prefix)
+{
+    OmpScopedLock lock(mutex_);
+    Checkpoint& cp = checkpoints_[varName][pos];
+    if (cp.data)
+        bytes_ -= dataBytes(cp.data);
+    if (cp.spillOffset >= 0)
+        dropSpilled(cp);
+    cp.data = prefix;
+    bytes_ += dataBytes(prefix);
+    if (bytes_ > maxBytes_)
+        shrink(varName, pos);
+}
+
+void AccumulationStore::shrink(const std::string& keepVar, size_t keepPos)
+{
+    bool changed = true;
+    while (bytes_ > maxBytes_ && changed) {
+        changed = false;
+        for (std::map<std::string, Checkpoints>::iterator vit = checkpoints_.begin(); vit != checkpoints_.end(); ++vit) {
+            Checkpoints& cps = vit->second;
+            size_t i = 0; // counts checkpoints in memory only, spilled ones stay in the map
+            for (Checkpoints::iterator it = cps.begin(); it != cps.end();) {
+                Checkpoint& cp = it->second;
+                if (!cp.data || (i++ % 2 == 0) || (vit->first == keepVar && it->first == keepPos)) {
+                    ++it;
+                    continue;
+                }
+                bytes_ -= dataBytes(cp.data);
+                changed = true;
+                if (spillEnabled_ && spill(cp)) {
+                    ++it;
+                } else {
+                    cps.erase(it++);
+                }
+            }
+        }
+    }
+    LOG4FIMEX(logger, Logger::DEBUG, "accumulation checkpoints reduced to " << bytes_ << " bytes");
+    if (spillFile_ && (spillBytes_ > SPILL_FACTOR * maxBytes_ || spillFileBytes_ > 2 * spillBytes_))
+        compactSpill();
+}
+
+bool AccumulationStore::spill(Checkpoint& cp)
+{
+    if (!spillFile_ && !(spillFile_ = std::tmpfile())) {
+        LOG4FIMEX(logger, Logger::WARN, "cannot create temporary file for accumulation checkpoints, dropping them instead");
+        spillEnabled_ = false;
+        return false;
+    }
+    const shared_array<double> values = cp.data->asDouble();
+    std::fseek(spillFile_, 0, SEEK_END);
+    const long offset = std::ftell(spillFile_);
+    if (offset < 0 || std::fwrite(values.get(), sizeof(double), cp.data->size(), spillFile_) != cp.data->size())
+        return false;
+    cp.spillOffset = offset;
+    cp.spillSize = cp.data->size();
+    cp.data.reset();
+    spillBytes_ += cp.spillSize * sizeof(double);
+    spillFileBytes_ = offset + cp.spillSize * sizeof(double);
+    return true;
+}
+
+void AccumulationStore::dropSpilled(Checkpoint& cp)
+{
+    spillBytes_ -= cp.spillSize * sizeof(double);
+    cp.spillOffset = -1;
+    cp.spillSize = 0;
+}
+
+void AccumulationStore::compactSpill()
+{
+    // thin out the spilled checkpoints, every other one per variable
+    bool changed = true;
+    while (spillBytes_ > SPILL_FACTOR * maxBytes_ && changed) {
+        changed = false;
+        for (std::map<std::string, Checkpoints>::iterator vit = checkpoints_.begin(); vit != checkpoints_.end(); ++vit) {
+            Checkpoints& cps = vit->second;
+            size_t i = 0;
+            for (Checkpoints::iterator it = cps.begin(); it != cps.end();) {
+                if (it->second.spillOffset < 0) {
+                    ++it;
+                } else if (i++ % 2 == 0) {
+                    ++it;
+                } else {
+                    dropSpilled(it->second);
+                    cps.erase(it++);
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    // rewrite the remaining spilled checkpoints to a new file
+    std::FILE* compacted = std::tmpfile();
+    if (!compacted) {
+        LOG4FIMEX(logger, Logger::WARN, "cannot create temporary file for accumulation checkpoints, dropping them instead");
+        clearSpill();
+        return;
+    }
+    long offset = 0;
+    for (std::map<std::string, Checkpoints>::iterator vit = checkpoints_.begin(); vit != checkpoints_.end(); ++vit) {
+        for (Checkpoints::iterator it = vit->second.begin(); it != vit->second.end(); ++it) {
+            Checkpoint& cp = it->second;
+            if (cp.spillOffset < 0)
+                continue;
+            const shared_array<double> values = unspill(cp)->asDouble();
+            if (std::fwrite(values.get(), sizeof(double), cp.spillSize, compacted) != cp.spillSize) {
+                LOG4FIMEX(logger, Logger::WARN, "cannot write accumulation checkpoints to temporary file, dropping them instead");
+                std::fclose(compacted);
+                clearSpill();
+                return;
+            }
+            cp.spillOffset = offset;
+            offset += cp.spillSize * sizeof(double);
+        }
+    }
+    std::fclose(spillFile_);
+    spillFile_ = compacted;
+    spillFileBytes_ = offset;
+    LOG4FIMEX(logger, Logger::DEBUG, "accumulation checkpoints spilled to temporary file reduced to " << spillFileBytes_ << " bytes");
+}
+
+void AccumulationStore::clearSpill()
+{
+    for (std::map<std::string, Checkpoints>::iterator vit = checkpoints_.begin(); vit != checkpoints_.end(); ++vit) {
+        Checkpoints& cps = vit->second;
+        for (Checkpoints::iterator it = cps.begin(); it != cps.end();) {
+            if (it->second.spillOffset >= 0)
+                cps.erase(it++);
+            else
+                ++it;
+        }
+    }
+    if (spillFile_)
+        std::fclose(spillFile_);
+    spillFile_ = 0;
+    spillBytes_ = 0;
+    spillFileBytes_ = 0;
+    spillEnabled_ = false;
+}
+
+DataPtr AccumulationStore::unspill(const Checkpoint& cp)
+{
+    shared_array<double> values(new double[cp.spillSize]);
+    if (std::fseek(spillFile_, cp.spillOffset, SEEK_SET) != 0 || std::fread(values.get(), sizeof(double), cp.spillSize, spillFile_) != cp.spillSize)
+        throw CDMException("cannot read accumulation checkpoint from temporary file");
+    return createData(cp.spillSize, values);
+}
+
+} // namespace
+
 struct VerticalVelocityComps {
     string wVarName;
     string xWind;
@@ -76,8 +349,9 @@ struct VerticalVelocityComps {
     size_t nz;
     double dx;
     double dy;
-    shared_array<float> gridDistX;
-    shared_array<float> gridDistY;
+    shared_array<double> mapFactors;
+    DataPtr apData;
+    DataPtr bData;
     DataPtr geopotData;
     bool tempNotDefined() {return temp == "";}
     bool geopotNotDefined() {return geopotData.get() == 0;}
@@ -96,7 +370,7 @@ struct CDMProcessor::CDMProcessorImpl
     map<string, pair<string, string> > rotateLatLonVectorY;
     // horizontalId -> cachedVectorReprojection
     map<string, CachedVectorReprojection_p> cachedVectorReprojection;
-    SliceCache sliceCache;
+    AccumulationStore accumulationStore;
     VerticalVelocityComps vvComp;
 };
 
@@ -301,8 +575,12 @@ void CDMProcessor::addVerticalVelocity()
     if (MIFI_OK != mifi_griddistance(nx, ny, lonlon.get(), latlat.get(), gridDistX.get(), gridDistY.get())) {
         throw CDMException("addVerticalVelocity: cannot calculate griddistance");
     }
-    vvcs.at(0).gridDistX = gridDistX;
-    vvcs.at(0).gridDistY = gridDistY;
+    // grid distances and hybrid coefficients are the same for all time-steps
+    shared_array<double> mapFactors(new double[4 * nx * ny]);
+    mifi_vertical_velocity_map_factors(nx, ny, vvcs.at(0).dx, vvcs.at(0).dy, gridDistX.get(), gridDistY.get(), mapFactors.get());
+    vvcs.at(0).mapFactors = mapFactors;
+    vvcs.at(0).apData = p_->dataReader->getScaledDataInUnit(vvcs.at(0).ap, "Pa");
+    vvcs.at(0).bData = p_->dataReader->getScaledData(vvcs.at(0).b);
 
     // create upward_air_velocity_ml (same shape as wind)
     string uav = "upward_air_velocity_ml";
@@ -329,6 +607,16 @@ void CDMProcessor::accumulate(const std::string& varName)
     }
 }
 
+void CDMProcessor::setAccumulationMemory(size_t maxBytes, bool spillToDisk)
+{
+    p_->accumulationStore.setLimits(maxBytes, spillToDisk);
+}
+
+size_t CDMProcessor::getAccumulationMemory() const
+{
+    return p_->accumulationStore.bytes();
+}
+
 void CDMProcessor::deAccumulate(const std::string& varName)
 {
     const CDMVariable& variable = cdm_->getVariable(varName);
@@ -475,21 +763,44 @@ static void replaceNanWith0(shared_array<double> dp, size_t n)
     mifi_nand2bad(&dp[0], &dp[0]+n, 0);
 }
 
+// return prefix + slice as new data, without modifying either
+static DataPtr addPrefix(const DataPtr& prefix, const DataPtr& slice, bool firstStep)
+{
+    const size_t n = slice->size();
+    if (prefix && prefix->size() != 0 && n == 0)
+        return prefix;
+    shared_array<double> sum(new double[n]);
+    const shared_array<double> s = slice->asDouble();
+    std::copy(&s[0], &s[0] + n, &sum[0]);
+    if (firstStep) {
+        // in step 0, replace undef with 0
+        replaceNanWith0(sum, n);
+    }
+    if (prefix && prefix->size() != 0) {
+        assert(prefix->size() == n);
+        const shared_array<double> p = prefix->asDouble();
+        std::transform(&sum[0], &sum[0] + n, &p[0], &sum[0], std::plus<double>());
+    }
+    return createData(n, sum);
+}
+
 // add d2 to d1 and return d1
 static void addDataP2Data(DataPtr& data, DataPtr& dataP, bool addingFirstTimeStep) {
     if ((data->size() != 0) && (dataP->size() != 0)) {
         assert(data->size() == dataP->size());
-        shared_array<double> d = data->asDouble();
-        shared_array<double> dp = dataP->asDouble();
+        shared_array<double> d = asWritableDouble(data);
+        shared_array<double> dp;
         if (addingFirstTimeStep) {
             // in step 0, replace undef with 0
+            dp = asWritableDouble(dataP);
             replaceNanWith0(dp, dataP->size());
+        } else {
+            dp = dataP->asDouble();
         }
-        // this might modify the original data in the reader
         std::transform(&d[0], &d[0]+data->size(), &dp[0], &d[0], std::plus<double>());
         data = createData(data->size(), d);
     } else if (dataP->size() != 0) {
-        data = dataP; // data->size was 0
+        data = dataP->clone(); // data->size was 0, dataP might be kept elsewhere
     }
 }
 
@@ -509,9 +820,9 @@ DataPtr CDMProcessor::getDataSlice(const std::string& varName, size_t unLimDimPo
         assert(zsD->size() == nx*ny);
         DataPtr psD = reader->getScaledDataSliceInUnit(p_->vvComp.ps, "Pa", unLimDimPos);
         assert(psD->size() == nx*ny);
-        DataPtr apD = reader->getScaledDataInUnit(p_->vvComp.ap, "Pa");
+        DataPtr apD = p_->vvComp.apData;
         assert(apD->size() == nz);
-        DataPtr bD = reader->getScaledData(p_->vvComp.b);
+        DataPtr bD = p_->vvComp.bData;
         assert(bD->size() == nz);
         DataPtr uD = reader->getScaledDataSliceInUnit(p_->vvComp.xWind, "m/s", unLimDimPos);
         assert(uD->size() == nx*ny*nz);
@@ -523,7 +834,7 @@ DataPtr CDMProcessor::getDataSlice(const std::string& varName, size_t unLimDimPo
 
         // output
         shared_array<float> w(new float[nx * ny * nz]);
-        if (MIFI_OK != mifi_compute_vertical_velocity(nx, ny, nz, p_->vvComp.dx, p_->vvComp.dy, p_->vvComp.gridDistX.get(), p_->vvComp.gridDistY.get(),
+        if (MIFI_OK != mifi_compute_vertical_velocity_mf(nx, ny, nz, p_->vvComp.dx, p_->vvComp.dy, p_->vvComp.mapFactors.get(),
                                                       apD->asDouble().get(), bD->asDouble().get(), zsD->asFloat().get(), psD->asFloat().get(),
                                                       uD->asFloat().get(), vD->asFloat().get(), tD->asFloat().get(), w.get()))
         {
@@ -538,25 +849,18 @@ DataPtr CDMProcessor::getDataSlice(const std::string& varName, size_t unLimDimPo
     if (p_->accumulateVars.find(varName) != p_->accumulateVars.end()) {
         LOG4FIMEX(logger, Logger::DEBUG, varName << " at slice " << unLimDimPos << " accumulate");
         if (unLimDimPos > 0) { // cannot accumulate first
-            size_t start = 0;
-            if (p_->sliceCache.varName == varName && p_->sliceCache.ulimDimPos <= unLimDimPos) {
-                start = p_->sliceCache.ulimDimPos + 1;
-                if (p_->sliceCache.ulimDimPos == unLimDimPos) {
-                    data = p_->sliceCache.data;
-                } else {
-                    DataPtr dataP = p_->sliceCache.data;
-                    addDataP2Data(data, dataP, false);
-                }
-            }
-            // data contains last slice + eventually cache
+            // prefix sum up to the previous slice, starting at the nearest checkpoint
+            size_t checkpointPos = 0;
+            DataPtr prefix = p_->accumulationStore.find(varName, unLimDimPos - 1, checkpointPos);
+            const size_t start = prefix ? checkpointPos + 1 : 0;
             for (size_t i = start; i <= unLimDimPos-1; ++i) {
                 DataPtr dataP = p_->dataReader->getDataSlice(varName, i);
-                addDataP2Data(data, dataP, i == 0);
+                prefix = addPrefix(prefix, dataP, i == 0);
+                p_->accumulationStore.insert(varName, i, prefix);
             }
-            // fill the cache
-            p_->sliceCache.varName = varName;
-            p_->sliceCache.ulimDimPos = unLimDimPos;
-            p_->sliceCache.data = data;
+            addDataP2Data(data, prefix, false);
+            // the result is the prefix sum of this slice; keep a copy, the caller may modify data
+            p_->accumulationStore.insert(varName, unLimDimPos, data->clone());
         }
     }
 
@@ -567,13 +871,15 @@ DataPtr CDMProcessor::getDataSlice(const std::string& varName, size_t unLimDimPo
             DataPtr dataP = p_->dataReader->getDataSlice(varName, unLimDimPos-1);
             if ((data->size() != 0) && (dataP->size() != 0)) {
                 assert(data->size() == dataP->size());
-                shared_array<double> d = data->asDouble();
-                shared_array<double> dp = dataP->asDouble();
+                shared_array<double> d = asWritableDouble(data);
+                shared_array<double> dp;
                 if (unLimDimPos == 1) {
                     // in step 0, replace undef with 0
+                    dp = asWritableDouble(dataP);
                     replaceNanWith0(dp, dataP->size());
+                } else {
+                    dp = dataP->asDouble();
                 }
-                // this might modify the original data in the reader
                 std::transform(&d[0], &d[0]+data->size(), &dp[0], &d[0], std::minus<double>());
                 data = createData(data->size(), d);
             }
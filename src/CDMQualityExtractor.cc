@@ -29,15 +29,23 @@
 #include "fimex/CDMFileReaderFactory.h"
 #include "fimex/Data.h"
 #include "fimex/Logger.h"
+#include "fimex/SliceBuilder.h"
 #include "fimex/String2Type.h"
 #include "fimex/TokenizeDotted.h"
+#include "fimex/Type2String.h"
 #include "fimex/XMLDoc.h"
 #include "fimex/mifi_constants.h"
+
+#include "MutexLock.h"
+
 #include <algorithm>
+#include <deque>
+#include <limits>
 #include <libxml/tree.h>
 #include <libxml/xpath.h>
 #include <regex>
 #include <set>
+#include <sstream>
 
 using namespace std;
 
@@ -100,8 +108,257 @@ static vector<double> getValidValues(const CDM& cdm, const string& statusVarName
     return validVals;
 }
 
+/**
+ * Quality rule of a variable compiled into a mask program over the
+ * status-values: a sorted value set (with a lookup table for small integer
+ * flags), or a valid range with an optional selection of the highest or
+ * lowest valid value of the slice.
+ */
+struct QualityMaskRule
+{
+    enum Select { SELECT_ALL, SELECT_VALUES, SELECT_HIGHEST, SELECT_LOWEST };
+    Select select;
+    double minValid, maxValid, statusFill;
+    std::vector<double> values;
+    std::vector<unsigned char> table;
+    /** identifies the rule, variables with equal keys share masks */
+    std::string key;
+
+    /** @param mask 1 for valid, 0 for invalid status */
+    void evaluate(const double* status, size_t n, std::vector<unsigned char>& mask) const;
+};
+
+//! largest flag value using a lookup table instead of a binary search
+static const double MAX_TABLE_FLAG = 4096;
+
+static std::shared_ptr<QualityMaskRule> compileValuesRule(std::vector<double> values)
+{
+    std::shared_ptr<QualityMaskRule> rule = std::make_shared<QualityMaskRule>();
+    rule->select = QualityMaskRule::SELECT_VALUES;
+    rule->minValid = rule->maxValid = rule->statusFill = MIFI_UNDEFINED_D;
+    sort(values.begin(), values.end());
+    values.erase(unique(values.begin(), values.end()), values.end());
+    rule->values = values;
+
+    bool smallIntegers = !values.empty();
+    for (size_t i = 0; smallIntegers && i < values.size(); ++i) {
+        const double v = values[i];
+        smallIntegers = (v >= 0 && v < MAX_TABLE_FLAG && v == static_cast<size_t>(v));
+    }
+    if (smallIntegers) {
+        rule->table.resize(static_cast<size_t>(values.back()) + 1, 0);
+        for (size_t i = 0; i < values.size(); ++i)
+            rule->table[static_cast<size_t>(values[i])] = 1;
+    }
+
+    std::ostringstream key;
+    key.precision(17);
+    key << "values";
+    for (size_t i = 0; i < values.size(); ++i)
+        key << ',' << values[i];
+    rule->key = key.str();
+    return rule;
+}
+
+static std::shared_ptr<QualityMaskRule> compileFlagRule(const CDM& cdmS, const string& statusVar, const string& flag, const string& varName)
+{
+    std::shared_ptr<QualityMaskRule> rule = std::make_shared<QualityMaskRule>();
+    rule->select = QualityMaskRule::SELECT_ALL;
+    rule->minValid = -std::numeric_limits<double>::infinity();
+    rule->maxValid = std::numeric_limits<double>::infinity();
+    rule->statusFill = cdmS.getFillValue(statusVar);
+
+    CDMAttribute attr;
+    if (cdmS.getAttribute(statusVar, "valid_min", attr)) {
+        rule->minValid = attr.getData()->asDouble()[0];
+    }
+    if (cdmS.getAttribute(statusVar, "valid_max", attr)) {
+        rule->maxValid = attr.getData()->asDouble()[0];
+    }
+    if (cdmS.getAttribute(statusVar, "valid_range", attr)) {
+        rule->minValid = attr.getData()->asDouble()[0];
+        rule->maxValid = attr.getData()->asDouble()[1];
+    }
+    std::smatch match;
+    if (flag == "all") {
+        // no more to do
+    } else if (std::regex_match(flag, match, std::regex("max:(.+)"))) {
+        const double max = string2type<double>(match[1]);
+        LOG4FIMEX(logger, Logger::DEBUG, "using max="<<max<<" for statusVar "<<statusVar<< " on var "<< varName);
+        rule->maxValid = std::min(rule->maxValid, max);
+    } else if (std::regex_match(flag, match, std::regex("min:(.+)"))) {
+        const double min = string2type<double>(match[1]);
+        LOG4FIMEX(logger, Logger::DEBUG, "using min="<<min<<" for statusVar "<<statusVar<< " on var "<< varName);
+        rule->minValid = std::max(rule->minValid, min);
+    } else if (flag == "highest") {
+        rule->select = QualityMaskRule::SELECT_HIGHEST;
+    } else if (flag == "lowest") {
+        rule->select = QualityMaskRule::SELECT_LOWEST;
+    } else {
+        throw CDMException("undefined quality-flag: "+flag+" for variable: "+varName);
+    }
+
+    std::ostringstream key;
+    key.precision(17);
+    key << "flags," << rule->select << ',' << rule->minValid << ',' << rule->maxValid << ',' << rule->statusFill;
+    rule->key = key.str();
+    return rule;
+}
+
+void QualityMaskRule::evaluate(const double* status, size_t n, std::vector<unsigned char>& mask) const
+{
+    mask.resize(n);
+    if (select == SELECT_VALUES) {
+        if (values.empty()) {
+            for (size_t i = 0; i < n; ++i)
+                mask[i] = !std::isnan(status[i]);
+        } else if (!table.empty()) {
+            const double tableSize = table.size();
+            for (size_t i = 0; i < n; ++i) {
+                const double v = status[i];
+                mask[i] = (v >= 0 && v < tableSize && v == static_cast<size_t>(v)) ? table[static_cast<size_t>(v)] : 0;
+            }
+        } else {
+            for (size_t i = 0; i < n; ++i)
+                mask[i] = binary_search(values.begin(), values.end(), status[i]);
+        }
+        return;
+    }
+
+    // comparisons with nan are false, so undefined status values and an undefined fill need no extra test
+    const double lo = minValid, hi = maxValid, fill = statusFill;
+    for (size_t i = 0; i < n; ++i) {
+        const double v = status[i];
+        mask[i] = (v >= lo) & (v <= hi) & (v != fill);
+    }
+    if (select == SELECT_HIGHEST || select == SELECT_LOWEST) {
+        // highest and lowest are retrieved per data-slice
+        bool found = false;
+        double extreme = MIFI_UNDEFINED_D;
+        for (size_t i = 0; i < n; ++i) {
+            if (mask[i] && (!found || (select == SELECT_HIGHEST ? status[i] > extreme : status[i] < extreme))) {
+                extreme = status[i];
+                found = true;
+            }
+        }
+        if (found) {
+            for (size_t i = 0; i < n; ++i)
+                mask[i] &= (status[i] == extreme);
+        }
+    }
+}
+
+typedef std::shared_ptr<const std::vector<unsigned char> > QualityMask_p;
+
+struct CDMQualityExtractor::Masks
+{
+    //! number of masks kept, enough for the status fields of one or two time-steps
+    static const size_t MAX_MASKS = 32;
+
+    OmpMutex mutex;
+    std::map<std::string, std::shared_ptr<const QualityMaskRule> > rules;
+    std::map<std::string, QualityMask_p> masks;
+    std::deque<std::string> order;
+
+    QualityMask_p find(const std::string& key)
+    {
+        OmpScopedLock lock(mutex);
+        std::map<std::string, QualityMask_p>::const_iterator it = masks.find(key);
+        return (it != masks.end()) ? it->second : QualityMask_p();
+    }
+
+    void insert(const std::string& key, QualityMask_p mask)
+    {
+        OmpScopedLock lock(mutex);
+        if (masks.insert(std::make_pair(key, mask)).second) {
+            order.push_back(key);
+            while (order.size() > MAX_MASKS) {
+                masks.erase(order.front());
+                order.pop_front();
+            }
+        }
+    }
+
+    /**
+     * mask of a slice of the status variable, cached unless given as statusData
+     * @param keyPrefix identifies rule, status variable and reader
+     * @param statusSb the status slice, or null for the slice at unLimDimPos
+     * @param statusData the status data, if already read
+     */
+    QualityMask_p sliceMask(const QualityMaskRule& rule, const std::string& keyPrefix, CDMReader& reader, const std::string& statusVar, size_t unLimDimPos,
+                            const SliceBuilder* statusSb, DataPtr statusData)
+    {
+        std::string key = keyPrefix;
+        if (!statusSb)
+            key += type2string(unLimDimPos);
+        QualityMask_p mask;
+        if (!statusData && (mask = find(key)))
+            return mask;
+
+        // the own data is not a separate status-field, caching would not save any reading
+        const bool cache = !statusData;
+        if (!statusData) {
+            if (statusSb) {
+                statusData = reader.getDataSlice(statusVar, *statusSb);
+            } else {
+                statusData = reader.getDataSlice(statusVar, unLimDimPos);
+                if (statusData->size() == 0)
+                    statusData = reader.getDataSlice(statusVar, 0); // get the default slice
+            }
+        }
+        std::shared_ptr<std::vector<unsigned char> > m = std::make_shared<std::vector<unsigned char> >();
+        if (statusData->size() > 0)
+            rule.evaluate(statusData->asDouble().get(), statusData->size(), *m);
+        mask = m;
+        if (cache)
+            insert(key, mask);
+        return mask;
+    }
+
+    /**
+     * mask of a part of the status variable, cut out of the masks of the full
+     * slices, for rules depending on the whole slice
+     */
+    QualityMask_p subSliceMask(const QualityMaskRule& rule, const std::string& keyPrefix, CDMReader& reader, const std::string& statusVar, const SliceBuilder& statusSb)
+    {
+        const CDM& cdm = reader.getCDM();
+        const CDMVariable& var = cdm.getVariable(statusVar);
+        const vector<string>& shape = var.getShape();
+        const bool unlimited = cdm.hasUnlimitedDim(var);
+        const size_t sliceDims = unlimited ? shape.size() - 1 : shape.size();
+
+        vector<size_t> orgDims, startDims, outputDims;
+        size_t fullSize = 1;
+        for (size_t i = 0; i < sliceDims; ++i) {
+            size_t start, size;
+            statusSb.getStartAndSize(shape[i], start, size);
+            orgDims.push_back(cdm.getDimension(shape[i]).getLength());
+            startDims.push_back(start);
+            outputDims.push_back(size);
+            fullSize *= orgDims.back();
+        }
+        size_t unLimStart = 0, unLimSize = 1;
+        if (unlimited)
+            statusSb.getStartAndSize(shape.back(), unLimStart, unLimSize);
+
+        std::shared_ptr<std::vector<unsigned char> > m = std::make_shared<std::vector<unsigned char> >();
+        for (size_t pos = unLimStart; pos < unLimStart + unLimSize; ++pos) {
+            QualityMask_p full = sliceMask(rule, keyPrefix, reader, statusVar, pos, 0, DataPtr());
+            if (full->size() != fullSize)
+                return QualityMask_p(new std::vector<unsigned char>()); // incompatible or undefined status
+            shared_array<unsigned char> fullValues(new unsigned char[fullSize]);
+            std::copy(full->begin(), full->end(), fullValues.get());
+            DataPtr part = createData(fullSize, fullValues)->slice(orgDims, startDims, outputDims);
+            const shared_array<unsigned char> partValues = part->asUChar();
+            m->insert(m->end(), partValues.get(), partValues.get() + part->size());
+        }
+        return m;
+    }
+};
+
 CDMQualityExtractor::CDMQualityExtractor(CDMReader_p dataReader, std::string autoConfString, std::string configFile)
 : dataReader(dataReader)
+    , masks_(std::make_shared<Masks>())
 {
     *cdm_.get() = dataReader->getCDM();
     const CDM& cdm = dataReader->getCDM();
@@ -215,179 +472,146 @@ CDMQualityExtractor::CDMQualityExtractor(CDMReader_p dataReader, std::string aut
     }
 }
 
-static double findDefinedExtreme(double* begin, double* end, const double& (*minmax)(const double& a, const double& b))
+/**
+ * set all values of data where the repeated mask is 0 to fill, written as
+ * select so that it can be vectorised
+ */
+template <typename T>
+static void maskValues(T* values, size_t size, const unsigned char* mask, size_t maskSize, T fill)
 {
-    double extreme = MIFI_UNDEFINED_D;
-    double* pos = begin;
-    // forward to first defined element
-    while ((pos != end) && (!std::isnan(*pos))) {
-        ++pos;
+    for (size_t offset = 0; offset < size; offset += maskSize) {
+        T* v = values + offset;
+        for (size_t i = 0; i < maskSize; ++i)
+            v[i] = mask[i] ? v[i] : fill;
     }
-    if (pos == end) {
-        extreme = MIFI_UNDEFINED_D;
-    } else {
-        extreme = *pos;
-        while (pos != end) {
-            if (!std::isnan(*pos)) {
-                extreme = minmax(extreme, *pos);
+}
+
+static DataPtr maskData(DataPtr&& data, const std::vector<unsigned char>& mask, double fillValue)
+{
+    const size_t sizeD = data->size(), sizeS = mask.size();
+    switch (data->getDataType()) {
+    case CDM_FLOAT: {
+        shared_array<float> values = asWritableFloat(data);
+        maskValues(values.get(), sizeD, &mask[0], sizeS, static_cast<float>(fillValue));
+        return createData(sizeD, values);
+    }
+    case CDM_DOUBLE: {
+        shared_array<double> values = asWritableDouble(data);
+        maskValues(values.get(), sizeD, &mask[0], sizeS, fillValue);
+        return createData(sizeD, values);
+    }
+    default:
+        if (data.use_count() > 1 || data->isArrayShared())
+            data = data->clone(); // copy-on-write as in asWritableFloat
+        for (size_t iD = 0; iD < sizeD;) {
+            for (size_t iS = 0; iS < sizeS; ++iS, ++iD) {
+                if (!mask[iS])
+                    data->setValue(iD, fillValue);
             }
         }
+        return data;
     }
-    return extreme;
 }
 
 DataPtr CDMQualityExtractor::getDataSlice(const std::string& varName, size_t unLimDimPos)
 {
     // no change in cdm-data in CDMQualityExtractor, so no need to check for in-memory data
+    return applyQuality(varName, dataReader->getDataSlice(varName, unLimDimPos), unLimDimPos, 0);
+}
+
+DataPtr CDMQualityExtractor::getDataSlice(const std::string& varName, const SliceBuilder& sb)
+{
+    return applyQuality(varName, dataReader->getDataSlice(varName, sb), 0, &sb);
+}
 
-    DataPtr data = dataReader->getDataSlice(varName, unLimDimPos);
+DataPtr CDMQualityExtractor::applyQuality(const std::string& varName, DataPtr data, size_t unLimDimPos, const SliceBuilder* sb)
+{
     // test if variable has quality assignment
-    if (statusVariable.find(varName) != statusVariable.end()) {
-        const string& statusVar = statusVariable[varName];
-        DataPtr statusData;
-        const std::map<std::string, CDMReader_p>::iterator sit = statusReaders.find(varName);
-        CDMReader_p readerS = dataReader;
-        if( sit != statusReaders.end() ) {
-            readerS = sit->second;
-            statusData = readerS->getDataSlice(statusVar, unLimDimPos);
-            if (statusData->size() == 0) {
-                statusData = readerS->getDataSlice(statusVar, 0); // get the default slice
-            }
-        } else if (statusVar == varName) {
-            // reuse data in case of own status data
-            statusData = data;
-        } else {
-            statusData = getDataSlice(statusVar, unLimDimPos); // reading statusData after applying QualityExtractor
-            if (statusData->size() == 0) {
-                statusData = getDataSlice(statusVar, 0); // get the default slice
-            }
+    const std::map<std::string, std::string>::const_iterator svit = statusVariable.find(varName);
+    if (svit == statusVariable.end())
+        return data;
+
+    const string& statusVar = svit->second;
+    const std::map<std::string, CDMReader_p>::iterator sit = statusReaders.find(varName);
+    const bool externalStatus = (sit != statusReaders.end());
+    CDMReader_p readerS = externalStatus ? sit->second : dataReader;
+    const CDM& cdmS = readerS->getCDM();
+
+    std::shared_ptr<const QualityMaskRule> rule;
+    {
+        OmpScopedLock lock(masks_->mutex);
+        std::shared_ptr<const QualityMaskRule>& r = masks_->rules[varName];
+        if (!r) {
+            const std::map<std::string, std::vector<double> >::const_iterator vit = variableValues.find(varName);
+            const std::map<std::string, std::string>::const_iterator fit = variableFlags.find(varName);
+            if (vit != variableValues.end())
+                r = compileValuesRule(vit->second);
+            else if (fit != variableFlags.end())
+                r = compileFlagRule(cdmS, statusVar, fit->second, varName);
+            else
+                r = compileValuesRule(std::vector<double>());
         }
+        rule = r;
+    }
+
+    // own status data is read without quality applied, other status variables
+    // with the quality of this extractor
+    CDMReader& statusReader = externalStatus ? *readerS : (statusVar == varName ? *dataReader : *this);
+    std::ostringstream maskPrefix;
+    maskPrefix << rule->key << '\0' << statusVar << '\0' << &statusReader << '\0';
+
+    // the slice of the status variable matching the requested data, status
+    // dimensions correspond to the first (fastest) dimensions of the variable
+    std::unique_ptr<SliceBuilder> statusSb;
+    std::ostringstream sbKey;
+    if (sb) {
+        statusSb.reset(new SliceBuilder(cdmS, statusVar));
+        const vector<string>& shapeVar = cdm_->getVariable(varName).getShape();
+        const vector<string>& shapeStatus = cdmS.getVariable(statusVar).getShape();
+        for (size_t i = 0; i < shapeStatus.size() && i < shapeVar.size(); ++i) {
+            size_t start, size;
+            sb->getStartAndSize(shapeVar[i], start, size);
+            statusSb->setStartAndSize(shapeStatus[i], start, size);
+            sbKey << start << ':' << size << ',';
+        }
+    }
+
+    QualityMask_p mask;
+    if (statusSb && (rule->select == QualityMaskRule::SELECT_HIGHEST || rule->select == QualityMaskRule::SELECT_LOWEST)) {
+        // highest and lowest are defined on the full slice, cut the requested part out of the full-slice masks
+        mask = masks_->subSliceMask(*rule, maskPrefix.str(), statusReader, statusVar, *statusSb);
+    } else if (statusSb) {
+        mask = masks_->sliceMask(*rule, maskPrefix.str() + sbKey.str(), statusReader, statusVar, 0, statusSb.get(),
+                                 statusVar == varName ? data : DataPtr());
+    } else {
+        mask = masks_->sliceMask(*rule, maskPrefix.str(), statusReader, statusVar, unLimDimPos, 0, statusVar == varName ? data : DataPtr());
+    }
 
-        const CDM& cdmS = readerS->getCDM();
-        const size_t sizeD = data->size(), sizeS = statusData->size();
-        if (sizeD == 0 && sizeS == 0) {
-            // special case: only undefined data
-            const CDMVariable& var = cdm_->getVariable(varName);
+    const double fillValue = variableFill[varName];
+    const size_t sizeD = data->size(), sizeS = mask->size();
+    if (sizeD == 0 && sizeS == 0) {
+        // special case: only undefined data
+        const CDMVariable& var = cdm_->getVariable(varName);
+        size_t length = 1;
+        if (sb) {
+            const vector<size_t>& sizes = sb->getDimensionSizes();
+            for (size_t i = 0; i < sizes.size(); ++i)
+                length *= sizes[i];
+        } else {
             const vector<string>& shape = var.getShape();
-            size_t length = 1;
             size_t sliceDims = cdm_->hasUnlimitedDim(var) ? shape.size()-1 : shape.size();
             for (size_t i = 0; i < sliceDims; ++i) {
                 length *= cdm_->getDimension(shape.at(i)).getLength();
             }
-
-            // return undefined data with new fill-value
-            return createData(cdm_->getVariable(varName).getDataType(), length, variableFill[varName]);
-        }
-        const double sizeRatio = double(sizeD)/sizeS;
-        if (sizeRatio == int(sizeRatio) && sizeRatio >= 1) {
-            shared_array<double> sd = statusData->asDouble();
-            vector<double> useVals;
-            if (variableValues.find(varName) != variableValues.end()) {
-                useVals = variableValues[varName];
-                sort(useVals.begin(), useVals.end());
-            } else if (variableFlags.find(varName) != variableFlags.end()) {
-                const string& flag = variableFlags[varName];
-                double statusFill = cdmS.getFillValue(statusVar);
-                double minFlag = MIFI_UNDEFINED_D;
-                double maxFlag = MIFI_UNDEFINED_D;
-                CDMAttribute attr;
-                if (cdmS.getAttribute(statusVar, "valid_min", attr)) {
-                    minFlag = attr.getData()->asDouble()[0];
-                }
-                if (cdmS.getAttribute(statusVar, "valid_max", attr)) {
-                    maxFlag = attr.getData()->asDouble()[0];
-                }
-                if (cdmS.getAttribute(statusVar, "valid_range", attr)) {
-                    minFlag = attr.getData()->asDouble()[0];
-                    maxFlag = attr.getData()->asDouble()[1];
-                }
-                if (!std::isnan(minFlag)) {
-                    double* sdIt = &sd[0];
-                    while (sdIt != &sd[sizeS]) {
-                        if (*sdIt < minFlag) {
-                            *sdIt = MIFI_UNDEFINED_D;
-                        }
-                        sdIt++;
-                    }
-                }
-                if (!std::isnan(maxFlag)) {
-                    double* sdIt = &sd[0];
-                    while (sdIt != &sd[sizeS]) {
-                        if (*sdIt > maxFlag) {
-                            *sdIt = MIFI_UNDEFINED_D;
-                        }
-                        sdIt++;
-                    }
-                }
-                if (!std::isnan(statusFill)) {
-                    double* sdIt = &sd[0];
-                    while (sdIt != &sd[sizeS]) {
-                        if (*sdIt == statusFill) {
-                            *sdIt = MIFI_UNDEFINED_D;
-                        }
-                        sdIt++;
-                    }
-                }
-                std::smatch match;
-                if (flag == "all") {
-                    // no more to do
-                } else if (std::regex_match(flag, match, std::regex("max:(.+)"))) {
-                    double max = string2type<double>(match[1]);
-                    LOG4FIMEX(logger, Logger::DEBUG, "using max="<<max<<" for statusVar "<<statusVar<< " on var "<< varName);
-                    double* sdIt = &sd[0];
-                    while (sdIt != &sd[sizeS]) {
-                        if (*sdIt > max) {
-                            *sdIt = MIFI_UNDEFINED_D;
-                        }
-                        sdIt++;
-                    }
-                } else if (std::regex_match(flag, match, std::regex("min:(.+)"))) {
-                    double min = string2type<double>(match[1]);
-                    double* sdIt = &sd[0];
-                    size_t count = 0;
-                    while (sdIt != &sd[sizeS]) {
-                        if (*sdIt < min) {
-                            *sdIt = MIFI_UNDEFINED_D;
-                            ++count;
-                        }
-                        sdIt++;
-                    }
-                    LOG4FIMEX(logger, Logger::DEBUG, "using min="<<min<<" for statusVar "<<statusVar<< " on var "<< varName << ": removed points: " << count);
-                } else if (flag == "highest") {
-                    double testVal = findDefinedExtreme(&sd[0], &sd[sizeS], &max<double>);
-                    if (!std::isnan(testVal))
-                        useVals.push_back(testVal);
-                } else if (flag == "lowest") {
-                    double testVal = findDefinedExtreme(&sd[0], &sd[sizeS], &min<double>);
-                    if (!std::isnan(testVal))
-                        useVals.push_back(testVal);
-                } else {
-                    throw CDMException("undefined quality-flag: "+flag+" for variable: "+varName);
-                }
-            }
-            if (useVals.size() > 0) {
-                // useVals are externally given flag-values or internally derived min/max
-                double* sdIt = &sd[0];
-                while (sdIt != &sd[sizeS]) {
-                    if (!binary_search(useVals.begin(), useVals.end(), *sdIt)) {
-                        *sdIt = MIFI_UNDEFINED_D;
-                    }
-                    sdIt++;
-                }
-            }
-            double fillValue = variableFill[varName];
-            for(size_t iD = 0; iD < sizeD; ) {
-                double *sdIt = &sd[0];
-                for (size_t iS = 0; iS < sizeS; ++iS, ++iD) {
-                    if (std::isnan(*sdIt)) {
-                        data->setValue(iD, fillValue);
-                    }
-                    ++sdIt;
-                }
-            }
-        } else {
-            LOG4FIMEX(logger, Logger::WARN, "incompatible size in data of variable and statusVariable at slice "<< unLimDimPos << ": "<<varName << ","<<statusVar<<": "<< data->size() << "<>" << statusData->size());
         }
+
+        // return undefined data with new fill-value
+        return createData(var.getDataType(), length, fillValue);
+    }
+    if (sizeS > 0 && sizeD >= sizeS && (sizeD % sizeS) == 0) {
+        return maskData(std::move(data), *mask, fillValue);
+    } else {
+        LOG4FIMEX(logger, Logger::WARN, "incompatible size in data of variable and statusVariable at slice "<< unLimDimPos << ": "<<varName << ","<<statusVar<<": "<< sizeD << "<>" << sizeS);
     }
     return data;
 }
@@ -0,0 +1,183 @@
+/*
+ * Fimex, CDMSliceCache.cc
+ *
+ * (C) Copyright 2019, met.no
+ *
+ * Project Info:  https://wiki.met.no/fimex/start
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include "fimex/CDMSliceCache.h"
+
+#include "fimex/CDM.h"
+#include "fimex/Data.h"
+#include "fimex/Logger.h"
+#include "fimex/SliceBuilder.h"
+
+#include "MutexLock.h"
+
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+namespace MetNoFimex {
+
+static Logger_p logger = getLogger("fimex.CDMSliceCache");
+
+namespace {
+
+size_t dataBytes(const DataPtr& data)
+{
+    return data->size() * data->bytes_for_one();
+}
+
+void appendKey(std::string& key, size_t value)
+{
+    key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+} // namespace
+
+struct CDMSliceCache::Impl
+{
+    typedef std::pair<std::string, DataPtr> Entry;
+    typedef std::list<Entry> Entries;
+
+    Impl(CDMReader_p r, size_t m)
+        : dataReader(r)
+        , maxMemory(m)
+        , memory(0)
+        , hits(0)
+        , misses(0)
+    {
+    }
+
+    DataPtr find(const std::string& key);
+    void insert(const std::string& key, DataPtr data);
+
+    CDMReader_p dataReader;
+    const size_t maxMemory;
+
+    OmpMutex mutex;
+    Entries entries; //!< most recently used first
+    std::unordered_map<std::string, Entries::iterator> index;
+    size_t memory;
+    size_t hits;
+    size_t misses;
+};
+
+DataPtr CDMSliceCache::Impl::find(const std::string& key)
+{
+    OmpScopedLock lock(mutex);
+    const auto it = index.find(key);
+    if (it == index.end()) {
+        misses += 1;
+        return DataPtr();
+    }
+    hits += 1;
+    entries.splice(entries.begin(), entries, it->second);
+    return it->second->second;
+}
+
+void CDMSliceCache::Impl::insert(const std::string& key, DataPtr data)
+{
+    const size_t bytes = dataBytes(data);
+    if (bytes > maxMemory)
+        return;
+
+    OmpScopedLock lock(mutex);
+    if (index.find(key) != index.end())
+        return; // read concurrently by another thread
+
+    while (!entries.empty() && memory + bytes > maxMemory) {
+        const Entry& lru = entries.back();
+        memory -= dataBytes(lru.second);
+        index.erase(lru.first);
+        entries.pop_back();
+    }
+    entries.push_front(std::make_pair(key, data));
+    index[key] = entries.begin();
+    memory += bytes;
+}
+
+CDMSliceCache::CDMSliceCache(CDMReader_p dataReader, size_t maxMemory)
+    : p_(new Impl(dataReader, maxMemory))
+{
+    *cdm_ = dataReader->getCDM();
+}
+
+CDMSliceCache::~CDMSliceCache()
+{
+    LOG4FIMEX(logger, Logger::INFO, "slice cache hits: " << p_->hits << ", misses: " << p_->misses << ", memory: " << p_->memory << " bytes");
+}
+
+DataPtr CDMSliceCache::getDataSlice(const std::string& varName, size_t unLimDimPos)
+{
+    std::string key = varName;
+    key += '\0';
+    appendKey(key, unLimDimPos);
+
+    if (DataPtr cached = p_->find(key))
+        return cached;
+
+    DataPtr data = p_->dataReader->getDataSlice(varName, unLimDimPos);
+    p_->insert(key, data);
+    return data;
+}
+
+DataPtr CDMSliceCache::getDataSlice(const std::string& varName, const SliceBuilder& sb)
+{
+    // separate key-space from the unLimDimPos keys
+    std::string key = varName;
+    key += '\1';
+    for (size_t start : sb.getDimensionStartPositions())
+        appendKey(key, start);
+    for (size_t size : sb.getDimensionSizes())
+        appendKey(key, size);
+
+    if (DataPtr cached = p_->find(key))
+        return cached;
+
+    DataPtr data = p_->dataReader->getDataSlice(varName, sb);
+    p_->insert(key, data);
+    return data;
+}
+
+size_t CDMSliceCache::getHits() const
+{
+    OmpScopedLock lock(p_->mutex);
+    return p_->hits;
+}
+
+size_t CDMSliceCache::getMisses() const
+{
+    OmpScopedLock lock(p_->mutex);
+    return p_->misses;
+}
+
+size_t CDMSliceCache::getMemory() const
+{
+    OmpScopedLock lock(p_->mutex);
+    return p_->memory;
+}
+
+size_t CDMSliceCache::getMaxMemory() const
+{
+    return p_->maxMemory;
+}
+
+} // namespace MetNoFimex
@@ -0,0 +1,451 @@
+/*
+ * Fimex, CachedCrossSectionInterpolation.cc
+ *
+ * (C) Copyright 2019, met.no
+ *
+ * Project Info:  https://wiki.met.no/fimex/start
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include "CachedCrossSectionInterpolation.h"
+
+#include "fimex/ArrayPool.h"
+#include "fimex/CDM.h"
+#include "fimex/CDMException.h"
+#include "fimex/CDMReader.h"
+#include "fimex/Data.h"
+#include "fimex/Logger.h"
+#include "fimex/MathUtils.h"
+#include "fimex/SliceBuilder.h"
+#include "fimex/Type2String.h"
+#include "fimex/interpolation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+
+namespace MetNoFimex {
+
+namespace {
+
+Logger_p logger = getLogger("fimex.CachedCrossSectionInterpolation");
+
+const size_t INVALID = ~0u;
+
+// allow additional cells for interpolation (2 for bicubic), as in CachedInterpolation
+const long long EXTEND = 2;
+
+//! clamp before converting, finite values may be out of range of long long
+inline long long clamp_ll(long long low, double value, long long high)
+{
+    return static_cast<long long>(clamp<double>(low, value, high));
+}
+
+inline long long clamp_ex(long long low, double dvalue, long long extend, long long high)
+{
+    return clamp_ll(low, (extend > 0 ? std::ceil(dvalue) : std::floor(dvalue)) + extend, high);
+}
+
+struct Box
+{
+    long long x0, y0, x1, y1; // inclusive
+    std::vector<size_t> groups;
+
+    long long area() const { return (x1 - x0 + 1) * (y1 - y0 + 1); }
+
+    long long mergedArea(const Box& o) const
+    {
+        return (std::max(x1, o.x1) - std::min(x0, o.x0) + 1) * (std::max(y1, o.y1) - std::min(y0, o.y0) + 1);
+    }
+
+    void merge(Box& o)
+    {
+        x0 = std::min(x0, o.x0);
+        y0 = std::min(y0, o.y0);
+        x1 = std::max(x1, o.x1);
+        y1 = std::max(y1, o.y1);
+        groups.insert(groups.end(), o.groups.begin(), o.groups.end());
+        o.groups.clear();
+    }
+};
+
+} // namespace
+
+CachedCrossSectionInterpolation::CachedCrossSectionInterpolation(const std::string& xDimName, const std::string& yDimName, int method,
+                                                                 const std::vector<double>& pointsOnXAxis, const std::vector<double>& pointsOnYAxis,
+                                                                 size_t inx, size_t iny, const std::vector<size_t>& sectionStarts)
+    : CachedInterpolationInterface(xDimName, yDimName, inx, iny, pointsOnXAxis.size(), 1)
+    , xDimName_(xDimName)
+    , yDimName_(yDimName)
+    , method_(method)
+    , packedLayerSize_(0)
+{
+    // group the points by cross-section
+    std::vector<size_t> pointGroups(outX, INVALID);
+    for (size_t s = 0; s < sectionStarts.size(); ++s) {
+        const size_t end = (s + 1 < sectionStarts.size()) ? sectionStarts[s + 1] : outX;
+        for (size_t p = sectionStarts[s]; p < end && p < outX; ++p)
+            pointGroups[p] = s;
+    }
+    init(pointsOnXAxis, pointsOnYAxis, inx, iny, pointGroups, sectionStarts.size(), 0);
+}
+
+CachedCrossSectionInterpolation::CachedCrossSectionInterpolation(const std::string& xDimName, const std::string& yDimName, int method,
+                                                                 const std::vector<double>& pointsOnXAxis, const std::vector<double>& pointsOnYAxis,
+                                                                 size_t inx, size_t iny, size_t tileSize)
+    : CachedInterpolationInterface(xDimName, yDimName, inx, iny, pointsOnXAxis.size(), 1)
+    , xDimName_(xDimName)
+    , yDimName_(yDimName)
+    , method_(method)
+    , packedLayerSize_(0)
+{
+    if (tileSize == 0)
+        throw CDMException("CachedCrossSectionInterpolation requires a tile size > 0");
+
+    // group the points by the input tile they fall into
+    const size_t tilesX = (inx + tileSize - 1) / tileSize, tilesY = (iny + tileSize - 1) / tileSize;
+    std::vector<size_t> pointGroups(outX, INVALID);
+    for (size_t p = 0; p < outX; ++p) {
+        const double px = pointsOnXAxis[p], py = pointsOnYAxis[p];
+        if (std::isfinite(px) && std::isfinite(py)) {
+            const size_t tx = clamp_ll(0, std::floor(px), static_cast<long long>(inx) - 1) / tileSize;
+            const size_t ty = clamp_ll(0, std::floor(py), static_cast<long long>(iny) - 1) / tileSize;
+            pointGroups[p] = ty * tilesX + tx;
+        }
+    }
+    init(pointsOnXAxis, pointsOnYAxis, inx, iny, pointGroups, tilesX * tilesY, tilesX);
+}
+
+void CachedCrossSectionInterpolation::init(const std::vector<double>& pointsOnXAxis, const std::vector<double>& pointsOnYAxis, size_t inx, size_t iny,
+                                           const std::vector<size_t>& pointGroups, size_t groups, size_t tilesX)
+{
+    if (method_ != MIFI_INTERPOL_NEAREST_NEIGHBOR && method_ != MIFI_INTERPOL_BILINEAR && method_ != MIFI_INTERPOL_BICUBIC)
+        throw CDMException("CachedCrossSectionInterpolation supports only nearest-neighbor, bilinear and bicubic, not: " + type2string(method_));
+
+    // the complete-input behaviour, and the input domain as seen from outside
+    full_ = createCachedInterpolation(xDimName_, yDimName_, method_, pointsOnXAxis, pointsOnYAxis, inx, iny, outX, outY);
+    reducedDomain_ = full_->reducedDomain();
+    inX = full_->getInX();
+    inY = full_->getInY();
+
+    const long long maxX = inx - 1, maxY = iny - 1;
+
+    // one box per group, from its finite points
+    std::vector<Box> groupBoxes(groups);
+    std::vector<bool> found(groups, false);
+    for (size_t p = 0; p < outX; ++p) {
+        const size_t g = pointGroups[p];
+        const double px = pointsOnXAxis[p], py = pointsOnYAxis[p];
+        if (g == INVALID || !(std::isfinite(px) && std::isfinite(py)))
+            continue;
+        const long long x0 = clamp_ex(0, px, -EXTEND, maxX), x1 = clamp_ex(0, px, +EXTEND, maxX);
+        const long long y0 = clamp_ex(0, py, -EXTEND, maxY), y1 = clamp_ex(0, py, +EXTEND, maxY);
+        Box& box = groupBoxes[g];
+        if (!found[g]) {
+            box.x0 = x0;
+            box.x1 = x1;
+            box.y0 = y0;
+            box.y1 = y1;
+            box.groups.push_back(g);
+            found[g] = true;
+        } else {
+            box.x0 = std::min(box.x0, x0);
+            box.x1 = std::max(box.x1, x1);
+            box.y0 = std::min(box.y0, y0);
+            box.y1 = std::max(box.y1, y1);
+        }
+    }
+    // merge boxes as long as reading the union is not more than reading both; tiles
+    // are only merged with boxes containing a neighbouring tile, cross-sections with any
+    // other cross-section. A merged box is kept at the group it was merged into.
+    std::vector<size_t> mergedInto(groups);
+    for (size_t g = 0; g < groups; ++g)
+        mergedInto[g] = g;
+    auto boxOf = [&mergedInto](size_t g) {
+        while (mergedInto[g] != g)
+            g = mergedInto[g] = mergedInto[mergedInto[g]];
+        return g;
+    };
+    const size_t tilesY = (tilesX > 0) ? (groups + tilesX - 1) / tilesX : 0;
+    std::vector<size_t> candidates;
+    for (bool merging = true; merging;) {
+        merging = false;
+        for (size_t g = 0; g < groups; ++g) {
+            if (!found[g] || boxOf(g) != g)
+                continue;
+            candidates.clear();
+            if (tilesX > 0) {
+                for (size_t member : groupBoxes[g].groups) {
+                    const size_t tx = member % tilesX, ty = member / tilesX;
+                    for (size_t ny = (ty > 0 ? ty - 1 : 0); ny <= ty + 1 && ny < tilesY; ++ny) {
+                        for (size_t nx = (tx > 0 ? tx - 1 : 0); nx <= tx + 1 && nx < tilesX; ++nx) {
+                            const size_t n = ny * tilesX + nx;
+                            if (found[n])
+                                candidates.push_back(n);
+                        }
+                    }
+                }
+            } else {
+                for (size_t n = 0; n < groups; ++n) {
+                    if (found[n])
+                        candidates.push_back(n);
+                }
+            }
+            Box& box = groupBoxes[g];
+            for (size_t c : candidates) {
+                const size_t o = boxOf(c);
+                if (o == g)
+                    continue;
+                Box& other = groupBoxes[o];
+                if (box.mergedArea(other) <= box.area() + other.area()) {
+                    box.merge(other);
+                    mergedInto[o] = g;
+                    merging = true;
+                }
+            }
+        }
+    }
+    std::vector<Box> boxes;
+    for (size_t g = 0; g < groups; ++g) {
+        if (found[g] && boxOf(g) == g)
+            boxes.push_back(std::move(groupBoxes[g]));
+    }
+
+    // block of each group, its points have all their neighbours in that block
+    std::vector<size_t> groupBlock(groups, INVALID);
+    for (const Box& b : boxes) {
+        for (size_t g : b.groups)
+            groupBlock[g] = blocks_.size();
+        Block block;
+        block.xStart = b.x0;
+        block.yStart = b.y0;
+        block.xSize = b.x1 - b.x0 + 1;
+        block.ySize = b.y1 - b.y0 + 1;
+        block.offset = packedLayerSize_;
+        packedLayerSize_ += block.xSize * block.ySize;
+        blocks_.push_back(block);
+    }
+    LOG4FIMEX(logger, Logger::DEBUG,
+              std::count(found.begin(), found.end(), true) << " point groups read in " << blocks_.size() << " blocks, " << packedLayerSize_ << " of " << inX * inY << " input points");
+
+    // block of each point and position of a cell of the complete input grid in the packed layer
+    std::vector<size_t> blockOfPoint(outX, INVALID);
+    for (size_t p = 0; p < outX; ++p) {
+        if (pointGroups[p] != INVALID)
+            blockOfPoint[p] = groupBlock[pointGroups[p]];
+    }
+    auto packedPos = [this](size_t bi, long long x, long long y) -> size_t {
+        const Block& b = blocks_[bi];
+        const long long bx = x - static_cast<long long>(b.xStart), by = y - static_cast<long long>(b.yStart);
+        if (0 <= bx && bx < static_cast<long long>(b.xSize) && 0 <= by && by < static_cast<long long>(b.ySize))
+            return b.offset + bx + by * b.xSize;
+        return INVALID;
+    };
+
+    const Stencil undefined = {{INVALID, INVALID, INVALID, INVALID}, 0, 0};
+    if (method_ == MIFI_INTERPOL_BICUBIC) {
+        pointBlock_.resize(outX, INVALID);
+        relX_.resize(outX, MIFI_UNDEFINED_D);
+        relY_.resize(outX, MIFI_UNDEFINED_D);
+        for (size_t p = 0; p < outX; ++p) {
+            const size_t bi = blockOfPoint[p];
+            const double px = pointsOnXAxis[p], py = pointsOnYAxis[p];
+            if (bi != INVALID && std::isfinite(px) && std::isfinite(py)) {
+                const Block& b = blocks_[bi];
+                // exact, the offsets are integers
+                pointBlock_[p] = bi;
+                relX_[p] = px - b.xStart;
+                relY_[p] = py - b.yStart;
+            }
+        }
+    } else if (method_ == MIFI_INTERPOL_NEAREST_NEIGHBOR) {
+        // same rounding as CachedNNInterpolation
+        const RoundAndClamp roundX(0, inx - 1, INVALID);
+        const RoundAndClamp roundY(0, iny - 1, INVALID);
+        stencils_.resize(outX, undefined);
+        for (size_t p = 0; p < outX; ++p) {
+            const size_t bi = blockOfPoint[p];
+            const size_t ix = roundX(pointsOnXAxis[p]), iy = roundY(pointsOnYAxis[p]);
+            if (bi != INVALID && ix != INVALID && iy != INVALID) {
+                const size_t pos = packedPos(bi, ix, iy);
+                Stencil& st = stencils_[p];
+                std::fill(st.pos, st.pos + 4, pos);
+            }
+        }
+    } else {
+        // same cases as mifi_get_values_bilinear_f, border cases by repeating positions
+        const long long ix = inx, iy = iny;
+        stencils_.resize(outX, undefined);
+        for (size_t p = 0; p < outX; ++p) {
+            const size_t bi = blockOfPoint[p];
+            const double x = pointsOnXAxis[p], y = pointsOnYAxis[p];
+            if (bi == INVALID || !(std::isfinite(x) && std::isfinite(y)) || std::fabs(x) > ix + 1e6 || std::fabs(y) > iy + 1e6)
+                continue;
+            long long x0 = std::floor(x);
+            const long long x1 = x0 + 1;
+            const float xFrac = x - x0;
+            long long y0 = std::floor(y);
+            const long long y1 = y0 + 1;
+            const float yFrac = y - y0;
+            Stencil& st = stencils_[p];
+            if (0 <= x0 && x1 < ix) {
+                if (0 <= y0 && y1 < iy) {
+                    st.pos[0] = packedPos(bi, x0, y0);
+                    st.pos[1] = packedPos(bi, x1, y0);
+                    st.pos[2] = packedPos(bi, x0, y1);
+                    st.pos[3] = packedPos(bi, x1, y1);
+                    st.xFrac = xFrac;
+                    st.yFrac = yFrac;
+                } else {
+                    y0 = std::lround(y);
+                    if (0 <= y0 && y0 < iy) {
+                        // linear interpolation in x, nearest-neighbor in y
+                        st.pos[0] = st.pos[2] = packedPos(bi, x0, y0);
+                        st.pos[1] = st.pos[3] = packedPos(bi, x1, y0);
+                        st.xFrac = xFrac;
+                    }
+                }
+            } else {
+                x0 = std::lround(x);
+                if (0 <= x0 && x0 < ix) {
+                    if (0 <= y0 && y1 < iy) {
+                        // nearest-neighbor in x, linear in y
+                        st.pos[0] = st.pos[1] = packedPos(bi, x0, y0);
+                        st.pos[2] = st.pos[3] = packedPos(bi, x0, y1);
+                        st.yFrac = yFrac;
+                    } else {
+                        y0 = std::lround(y);
+                        if (0 <= y0 && y0 < iy) {
+                            std::fill(st.pos, st.pos + 4, packedPos(bi, x0, y0));
+                        }
+                    }
+                }
+            }
+            if (std::find(st.pos, st.pos + 4, INVALID) != st.pos + 4)
+                st = undefined;
+        }
+    }
+}
+
+bool CachedCrossSectionInterpolation::isPacked(const InterpolationWindow& w) const
+{
+    // the complete input has at least 2 rows, see createReducedDomain
+    return packedLayerSize_ > 0 && w.inYSize == 1 && w.inXSize == packedLayerSize_;
+}
+
+InterpolationWindow CachedCrossSectionInterpolation::getWindow(size_t outXStart, size_t outXSize, size_t outYStart, size_t outYSize) const
+{
+    InterpolationWindow w = CachedInterpolationInterface::getWindow(outXStart, outXSize, outYStart, outYSize);
+    if (packedLayerSize_ > 0 && packedLayerSize_ < inX * inY) {
+        w.inXStart = 0;
+        w.inXSize = packedLayerSize_;
+        w.inYStart = 0;
+        w.inYSize = 1;
+    }
+    return w;
+}
+
+DataPtr CachedCrossSectionInterpolation::getInputDataSlice(CDMReader_p reader, const std::string& varName, const SliceBuilder& sb,
+                                                           const InterpolationWindow& w) const
+{
+    if (!isPacked(w))
+        return CachedInterpolationInterface::getInputDataSlice(reader, varName, sb, w);
+
+    SliceBuilder rsb(reader->getCDM(), varName);
+    const std::vector<std::string> dims = rsb.getDimensionNames();
+    for (const std::string& dn : dims) {
+        if (dn != xDimName_ && dn != yDimName_) {
+            size_t start, size;
+            sb.getStartAndSize(dn, start, size);
+            rsb.setStartAndSize(dn, start, size);
+        }
+    }
+
+    DataPtr packed;
+    size_t nz = 0;
+    for (const Block& b : blocks_) {
+        rsb.setStartAndSize(xDimName_, b.xStart, b.xSize);
+        rsb.setStartAndSize(yDimName_, b.yStart, b.ySize);
+        DataPtr data = reader->getDataSlice(varName, rsb);
+        if (data->size() == 0)
+            return data;
+        const size_t blockLayerSize = b.xSize * b.ySize;
+        if (!packed) {
+            nz = data->size() / blockLayerSize;
+            packed = createData(data->getDataType(), nz * packedLayerSize_);
+        }
+        if (data->size() != nz * blockLayerSize)
+            throw CDMException("unexpected size of cross-section input for " + varName);
+        for (size_t z = 0; z < nz; ++z)
+            packed->setValues(z * packedLayerSize_ + b.offset, *data, z * blockLayerSize, (z + 1) * blockLayerSize);
+    }
+    return packed;
+}
+
+shared_array<float> CachedCrossSectionInterpolation::interpolateValues(shared_array<float> inData, size_t size, size_t& newSize) const
+{
+    return full_->interpolateValues(inData, size, newSize);
+}
+
+shared_array<float> CachedCrossSectionInterpolation::interpolateValues(shared_array<float> inData, size_t size, size_t& newSize,
+                                                                       const InterpolationWindow& w) const
+{
+    if (!isPacked(w))
+        return full_->interpolateValues(inData, size, newSize, w);
+
+    const size_t outLayerSize = w.outXSize * w.outYSize;
+    const size_t nz = size / packedLayerSize_;
+    newSize = outLayerSize * nz;
+    shared_array<float> outfield = make_pooled_array<float>(newSize);
+    const float* in = inData.get();
+
+#ifdef _OPENMP
+#pragma omp parallel for default(shared)
+#endif
+    for (size_t oxy = 0; oxy < outLayerSize; ++oxy) {
+        const size_t p = (w.outYStart + oxy / w.outXSize) * outX + w.outXStart + oxy % w.outXSize;
+        float* outPos = &outfield[oxy];
+        if (method_ == MIFI_INTERPOL_BICUBIC) {
+            const size_t bi = pointBlock_[p];
+            for (size_t z = 0; z < nz; ++z, outPos += outLayerSize) {
+                if (bi == INVALID) {
+                    *outPos = MIFI_UNDEFINED_F;
+                } else {
+                    const Block& b = blocks_[bi];
+                    mifi_get_values_bicubic_f(in + z * packedLayerSize_ + b.offset, outPos, relX_[p], relY_[p], b.xSize, b.ySize, 1);
+                }
+            }
+        } else {
+            const Stencil& st = stencils_[p];
+            if (st.pos[0] == INVALID) {
+                for (size_t z = 0; z < nz; ++z, outPos += outLayerSize)
+                    *outPos = MIFI_UNDEFINED_F;
+            } else {
+                const float xFrac = st.xFrac, yFrac = st.yFrac;
+                for (size_t z = 0; z < nz; ++z, outPos += outLayerSize) {
+                    const float* layer = in + z * packedLayerSize_;
+                    *outPos = (1.f - yFrac) * ((1.f - xFrac) * layer[st.pos[0]] + xFrac * layer[st.pos[1]]) +
+                              yFrac * ((1.f - xFrac) * layer[st.pos[2]] + xFrac * layer[st.pos[3]]);
+                }
+            }
+        }
+    }
+
+    return outfield;
+}
+
+} // namespace MetNoFimex
@@ -0,0 +1,130 @@
+/*
+ * Fimex, CachedCrossSectionInterpolation.h
+ *
+ * (C) Copyright 2019, met.no
+ *
+ * Project Info:  https://wiki.met.no/fimex/start
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#ifndef CACHEDCROSSSECTIONINTERPOLATION_H_
+#define CACHEDCROSSSECTIONINTERPOLATION_H_
+
+#include "fimex/CachedInterpolation.h"
+
+#include <vector>
+
+namespace MetNoFimex {
+
+/**
+ * Interpolation to a list of points, e.g. the points of a set of vertical
+ * cross-sections or scattered stations.
+ *
+ * Instead of one input box covering all points, the points are grouped, by
+ * cross-section or by input tile, and each group gets its own input box;
+ * boxes are merged into blocks while the merged box is not larger than both.
+ * The blocks are read separately and packed one after the other into each
+ * input layer, and the source positions and weights of each output point are
+ * precomputed relative to the packed layer.
+ *
+ * The packed input is only used with windows from getWindow(). With the
+ * complete input, e.g. for preprocessing of complete fields, it behaves
+ * like the interpolation from createCachedInterpolation().
+ */
+class CachedCrossSectionInterpolation : public CachedInterpolationInterface
+{
+public:
+    /**
+     * @param xDimName name of the input x-dimension
+     * @param yDimName name of the input y-dimension
+     * @param method MIFI_INTERPOL_NEAREST_NEIGHBOR, MIFI_INTERPOL_BILINEAR or MIFI_INTERPOL_BICUBIC
+     * @param pointsOnXAxis position of each output point on the input x-axis
+     * @param pointsOnYAxis position of each output point on the input y-axis
+     * @param inX size of input x-axis
+     * @param inY size of input y-axis
+     * @param sectionStarts first output point of each cross-section, increasing
+     */
+    CachedCrossSectionInterpolation(const std::string& xDimName, const std::string& yDimName, int method, const std::vector<double>& pointsOnXAxis,
+                                    const std::vector<double>& pointsOnYAxis, size_t inX, size_t inY, const std::vector<size_t>& sectionStarts);
+
+    /**
+     * @param xDimName name of the input x-dimension
+     * @param yDimName name of the input y-dimension
+     * @param method MIFI_INTERPOL_NEAREST_NEIGHBOR, MIFI_INTERPOL_BILINEAR or MIFI_INTERPOL_BICUBIC
+     * @param pointsOnXAxis position of each output point on the input x-axis
+     * @param pointsOnYAxis position of each output point on the input y-axis
+     * @param inX size of input x-axis
+     * @param inY size of input y-axis
+     * @param tileSize points are grouped by input tiles of tileSize x tileSize cells, > 0
+     */
+    CachedCrossSectionInterpolation(const std::string& xDimName, const std::string& yDimName, int method, const std::vector<double>& pointsOnXAxis,
+                                    const std::vector<double>& pointsOnYAxis, size_t inX, size_t inY, size_t tileSize);
+
+    using CachedInterpolationInterface::getInputDataSlice;
+    DataPtr getInputDataSlice(CDMReader_p reader, const std::string& varName, const SliceBuilder& sb, const InterpolationWindow& w) const override;
+
+    shared_array<float> interpolateValues(shared_array<float> inData, size_t size, size_t& newSize) const override;
+    shared_array<float> interpolateValues(shared_array<float> inData, size_t size, size_t& newSize, const InterpolationWindow& w) const override;
+
+    InterpolationWindow getWindow(size_t outXStart, size_t outXSize, size_t outYStart, size_t outYSize) const override;
+
+    /** @return number of values in one packed input layer, 0 if nothing is packed */
+    size_t getPackedLayerSize() const { return packedLayerSize_; }
+
+    /** @return number of separately read input blocks */
+    size_t getNumberOfBlocks() const { return blocks_.size(); }
+
+private:
+    struct Block
+    {
+        size_t xStart, yStart, xSize, ySize; //!< position on the complete input grid
+        size_t offset;                       //!< position in the packed layer
+    };
+
+    /**
+     * Source positions in the packed layer, evaluated as
+     * (1-yFrac)*((1-xFrac)*v[0] + xFrac*v[1]) + yFrac*((1-xFrac)*v[2] + xFrac*v[3]),
+     * pos[0] == INVALID for undefined output
+     */
+    struct Stencil
+    {
+        size_t pos[4];
+        float xFrac, yFrac;
+    };
+
+    /**
+     * @param pointGroups group of each output point, INVALID if not used
+     * @param groups number of groups
+     * @param tilesX number of tiles in x-direction if groups are input tiles, else 0
+     */
+    void init(const std::vector<double>& pointsOnXAxis, const std::vector<double>& pointsOnYAxis, size_t inX, size_t inY,
+              const std::vector<size_t>& pointGroups, size_t groups, size_t tilesX);
+    bool isPacked(const InterpolationWindow& w) const;
+
+    std::string xDimName_, yDimName_;
+    int method_;
+    CachedInterpolationInterface_p full_;
+    std::vector<Block> blocks_;
+    size_t packedLayerSize_;
+    std::vector<Stencil> stencils_;   //!< per output point, nearest neighbor and bilinear
+    std::vector<size_t> pointBlock_;  //!< per output point, bicubic
+    std::vector<double> relX_, relY_; //!< per output point relative to its block, bicubic
+};
+
+} // namespace MetNoFimex
+
+#endif /* CACHEDCROSSSECTIONINTERPOLATION_H_ */
@@ -45,6 +45,7 @@ public:
     CachedForwardInterpolation(const std::string& xDimName, const std::string& yDimName, int funcType, shared_array<double> pointsOnXAxis,
                                shared_array<double> pointsOnYAxis, size_t inX, size_t inY, size_t outX, size_t outY);
     ~CachedForwardInterpolation();
+    using CachedInterpolationInterface::interpolateValues;
     shared_array<float> interpolateValues(shared_array<float> inData, size_t size, size_t& newSize) const override;
 };
 
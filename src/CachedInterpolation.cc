@@ -23,6 +23,7 @@
 
 #include "fimex/CachedInterpolation.h"
 
+#include "fimex/ArrayPool.h"
 #include "fimex/CDM.h"
 #include "fimex/CDMException.h"
 #include "fimex/CDMReader.h"
@@ -35,6 +36,9 @@
 
 #include "fimex/Logger.h"
 
+#include <algorithm>
+#include <cmath>
+
 #ifdef _OPENMP
 #include <omp.h>
 #endif
@@ -114,6 +118,83 @@ DataPtr CachedInterpolationInterface::getInputDataSlice(CDMReader_p reader, cons
     return data;
 }
 
+DataPtr CachedInterpolationInterface::getInputDataSlice(CDMReader_p reader, const std::string& varName, const SliceBuilder& sb,
+                                                       const InterpolationWindow& w) const
+{
+    LOG4FIMEX(logger, Logger::DEBUG, "creating a windowed slicebuilder for '" << varName << "'");
+    const size_t xOffset = reducedDomain() ? reducedDomain()->xMin : 0;
+    const size_t yOffset = reducedDomain() ? reducedDomain()->yMin : 0;
+    SliceBuilder rsb(reader->getCDM(), varName);
+    const std::vector<std::string> dims = rsb.getDimensionNames();
+    for (size_t i = 0; i < dims.size(); i++) {
+        const std::string& dn = dims[i];
+        size_t start, size;
+        if (dn == _xDimName) {
+            start = xOffset + w.inXStart;
+            size = w.inXSize;
+        } else if (dn == _yDimName) {
+            start = yOffset + w.inYStart;
+            size = w.inYSize;
+        } else {
+            sb.getStartAndSize(dn, start, size);
+        }
+        rsb.setStartAndSize(dn, start, size);
+    }
+    return reader->getDataSlice(varName, rsb);
+}
+
+InterpolationWindow CachedInterpolationInterface::getWindow(size_t outXStart, size_t outXSize, size_t outYStart, size_t outYSize) const
+{
+    InterpolationWindow w;
+    w.outXStart = outXStart;
+    w.outXSize = outXSize;
+    w.outYStart = outYStart;
+    w.outYSize = outYSize;
+    w.inXStart = 0;
+    w.inXSize = inX;
+    w.inYStart = 0;
+    w.inYSize = inY;
+    return w;
+}
+
+InterpolationWindow CachedInterpolationInterface::getWindowForSlice(const SliceBuilder& sb) const
+{
+    size_t xStart = 0, xSize = outX, yStart = 0, ySize = outY;
+    const std::vector<std::string> dims = sb.getDimensionNames();
+    if (std::find(dims.begin(), dims.end(), _xDimName) != dims.end())
+        sb.getStartAndSize(_xDimName, xStart, xSize);
+    if (std::find(dims.begin(), dims.end(), _yDimName) != dims.end())
+        sb.getStartAndSize(_yDimName, yStart, ySize);
+    return getWindow(xStart, xSize, yStart, ySize);
+}
+
+shared_array<float> CachedInterpolationInterface::interpolateValues(shared_array<float> inData, size_t size, size_t& newSize,
+                                                                    const InterpolationWindow& w) const
+{
+    if (w.inXStart != 0 || w.inXSize != inX || w.inYStart != 0 || w.inYSize != inY)
+        throw CDMException("interpolation requires the complete input");
+
+    size_t fullSize = 0;
+    shared_array<float> full = interpolateValues(inData, size, fullSize);
+    if (w.outXStart == 0 && w.outXSize == outX && w.outYStart == 0 && w.outYSize == outY) {
+        newSize = fullSize;
+        return full;
+    }
+
+    // cut the window out of each layer
+    const size_t outZ = fullSize / (outX * outY);
+    newSize = w.outXSize * w.outYSize * outZ;
+    shared_array<float> windowed = make_pooled_array<float>(newSize);
+    float* pos = windowed.get();
+    for (size_t z = 0; z < outZ; ++z) {
+        for (size_t y = 0; y < w.outYSize; ++y) {
+            const float* row = &full[(z * outY + w.outYStart + y) * outX + w.outXStart];
+            pos = std::copy(row, row + w.outXSize, pos);
+        }
+    }
+    return windowed;
+}
+
 DataPtr CachedInterpolationInterface::getOutputDataSlice(DataPtr data, const SliceBuilder& sb) const
 {
     // slice the x and y direction of the data
@@ -176,10 +257,18 @@ CachedInterpolation::CachedInterpolation(const std::string& xDimName, const std:
 
 shared_array<float> CachedInterpolation::interpolateValues(shared_array<float> inData, size_t size, size_t& newSize) const
 {
-    const size_t outLayerSize = outX * outY;
-    const size_t inZ = size / (inX*inY);
+    return interpolateValues(inData, size, newSize, CachedInterpolationInterface::getWindow(0, outX, 0, outY));
+}
+
+shared_array<float> CachedInterpolation::interpolateValues(shared_array<float> inData, size_t size, size_t& newSize, const InterpolationWindow& w) const
+{
+    const size_t outLayerSize = w.outXSize * w.outYSize;
+    const size_t inZ = size / (w.inXSize * w.inYSize);
     newSize = outLayerSize*inZ;
-    shared_array<float> outfield(new float[newSize]);
+    shared_array<float> outfield = make_pooled_array<float>(newSize);
+
+    // positions relative to the window, exact as the offsets are integers
+    const double xOffset = w.inXStart, yOffset = w.inYStart;
 
 #ifdef _OPENMP
 #pragma omp parallel default(shared)
@@ -189,9 +278,10 @@ shared_array<float> CachedInterpolation::interpolateValues(shared_array<float> i
 #ifdef _OPENMP
 #pragma omp for
 #endif
-    for (size_t xy = 0; xy < outLayerSize; ++xy) {
-        float* outPos = &outfield[xy];
-        if (func(inData.get(), zValues.get(), pointsOnXAxis[xy], pointsOnYAxis[xy], inX, inY, inZ) != MIFI_ERROR) {
+    for (size_t oxy = 0; oxy < outLayerSize; ++oxy) {
+        const size_t xy = (w.outYStart + oxy / w.outXSize) * outX + w.outXStart + oxy % w.outXSize;
+        float* outPos = &outfield[oxy];
+        if (func(inData.get(), zValues.get(), pointsOnXAxis[xy] - xOffset, pointsOnYAxis[xy] - yOffset, w.inXSize, w.inYSize, inZ) != MIFI_ERROR) {
             for (size_t z = 0; z < inZ; ++z) {
                 *outPos = zValues[z];
                 outPos += outLayerSize;
@@ -218,6 +308,50 @@ inline long long clamp_ex(long long low, double dvalue, long long extend, long l
 }
 } // namespace
 
+InterpolationWindow CachedInterpolation::getWindow(size_t outXStart, size_t outXSize, size_t outYStart, size_t outYSize) const
+{
+    InterpolationWindow w = CachedInterpolationInterface::getWindow(outXStart, outXSize, outYStart, outYSize);
+    if (outXStart == 0 && outXSize == outX && outYStart == 0 && outYSize == outY)
+        return w; // the (reduced) input domain is the box of all output
+
+    double minX = 0, maxX = 0, minY = 0, maxY = 0;
+    bool found = false;
+    for (size_t y = outYStart; y < outYStart + outYSize; ++y) {
+        for (size_t x = outXStart; x < outXStart + outXSize; ++x) {
+            const double px = pointsOnXAxis[y * outX + x], py = pointsOnYAxis[y * outX + x];
+            if (std::isfinite(px) && std::isfinite(py)) {
+                if (!found) {
+                    minX = maxX = px;
+                    minY = maxY = py;
+                    found = true;
+                } else {
+                    minX = std::min(minX, px);
+                    maxX = std::max(maxX, px);
+                    minY = std::min(minY, py);
+                    maxY = std::max(maxY, py);
+                }
+            }
+        }
+    }
+    if (!found)
+        return w; // nothing to interpolate, keep the complete input
+
+    // same extension as in createReducedDomain, so that points keep their
+    // distance to the window border or lie on the border of the input domain
+    const long long x0 = clamp_ex(0, minX, -EXTEND, inX - 1);
+    const long long y0 = clamp_ex(0, minY, -EXTEND, inY - 1);
+    const long long x1 = clamp_ex(0, maxX, +EXTEND, inX - 1);
+    const long long y1 = clamp_ex(0, maxY, +EXTEND, inY - 1);
+    if ((x1 - x0) < 1 || (y1 - y0) < 1)
+        return w;
+
+    w.inXStart = x0;
+    w.inXSize = x1 - x0 + 1;
+    w.inYStart = y0;
+    w.inYSize = y1 - y0 + 1;
+    return w;
+}
+
 void CachedInterpolation::createReducedDomain(const std::string& xDimName, const std::string& yDimName)
 {
     // don't set twice
@@ -319,7 +453,7 @@ shared_array<float> CachedNNInterpolation::interpolateValues(shared_array<float>
     const size_t inZ = size / inLayerSize;
     newSize = outLayerSize * inZ;
 
-    shared_array<float> outData(new float[newSize]);
+    shared_array<float> outData = make_pooled_array<float>(newSize);
     std::fill(outData.get(), outData.get() + newSize, MIFI_UNDEFINED_F);
 
     for (size_t z = 0; z < inZ; ++z) {
@@ -334,4 +468,63 @@ shared_array<float> CachedNNInterpolation::interpolateValues(shared_array<float>
     return outData;
 }
 
+shared_array<float> CachedNNInterpolation::interpolateValues(shared_array<float> inData, size_t size, size_t& newSize, const InterpolationWindow& w) const
+{
+    const size_t outLayerSize = w.outXSize * w.outYSize;
+    const size_t inLayerSize = w.inXSize * w.inYSize;
+    const size_t inZ = size / inLayerSize;
+    newSize = outLayerSize * inZ;
+
+    // translate the cached input positions to the window once for all layers
+    std::vector<size_t> pointsInWindow(outLayerSize, INVALID);
+    for (size_t oxy = 0; oxy < outLayerSize; ++oxy) {
+        const size_t i = pointsInIn[(w.outYStart + oxy / w.outXSize) * outX + w.outXStart + oxy % w.outXSize];
+        if (i != INVALID)
+            pointsInWindow[oxy] = (i / inX - w.inYStart) * w.inXSize + (i % inX - w.inXStart);
+    }
+
+    shared_array<float> outData = make_pooled_array<float>(newSize);
+    std::fill(outData.get(), outData.get() + newSize, MIFI_UNDEFINED_F);
+
+    for (size_t z = 0; z < inZ; ++z) {
+        const float* inDataZ = &inData[z * inLayerSize];
+        float* outDataZ = &outData[z * outLayerSize];
+        for (size_t o = 0; o < outLayerSize; o++) {
+            const size_t i = pointsInWindow[o];
+            if (i != INVALID)
+                outDataZ[o] = inDataZ[i];
+        }
+    }
+    return outData;
+}
+
+InterpolationWindow CachedNNInterpolation::getWindow(size_t outXStart, size_t outXSize, size_t outYStart, size_t outYSize) const
+{
+    InterpolationWindow w = CachedInterpolationInterface::getWindow(outXStart, outXSize, outYStart, outYSize);
+    if (outXStart == 0 && outXSize == outX && outYStart == 0 && outYSize == outY)
+        return w; // the (reduced) input domain is the box of all output
+
+    size_t minX = inX, maxX = 0, minY = inY, maxY = 0;
+    for (size_t y = outYStart; y < outYStart + outYSize; ++y) {
+        for (size_t x = outXStart; x < outXStart + outXSize; ++x) {
+            const size_t i = pointsInIn[y * outX + x];
+            if (i != INVALID) {
+                const size_t ix = i % inX, iy = i / inX;
+                minX = std::min(minX, ix);
+                maxX = std::max(maxX, ix);
+                minY = std::min(minY, iy);
+                maxY = std::max(maxY, iy);
+            }
+        }
+    }
+    if (minX > maxX || minY > maxY)
+        return w; // nothing to interpolate, keep the complete input
+
+    w.inXStart = minX;
+    w.inXSize = maxX - minX + 1;
+    w.inYStart = minY;
+    w.inYSize = maxY - minY + 1;
+    return w;
+}
+
 } // namespace MetNoFimex
@@ -43,6 +43,38 @@ void CachedVectorReprojection::reprojectValues(shared_array<float>& uValues, sha
     if (errcode != MIFI_OK)	throw CDMException("Error during reprojection of vector-values");
 }
 
+void CachedVectorReprojection::reprojectValues(shared_array<float>& uValues, shared_array<float>& vValues, size_t size, size_t xStart, size_t xSize,
+                                               size_t yStart, size_t ySize) const
+{
+    if (xStart == 0 && xSize == ox && yStart == 0 && ySize == oy) {
+        reprojectValues(uValues, vValues, size);
+        return;
+    }
+    if (ox == 0 || oy == 0 || matrix.get() == 0) {
+        LOG4FIMEX(logger, Logger::WARN, "CachedVectorReprojection not initialized, using identity");
+        return;
+    }
+    if (xStart + xSize > ox || yStart + ySize > oy)
+        throw CDMException("vector reprojection window outside spatial plane");
+
+    const size_t layerSize = xSize * ySize;
+    const size_t oz = size / layerSize;
+    for (size_t z = 0; z < oz; ++z) {
+        float* uz = &uValues[z * layerSize];
+        float* vz = &vValues[z * layerSize];
+        for (size_t y = 0; y < ySize; ++y) {
+            // same rotation as mifi_vector_reproject_values_by_matrix_f
+            const double* m = &matrix[4 * ((yStart + y) * ox + xStart)];
+            for (size_t x = 0; x < xSize; ++x, ++uz, ++vz, m += 4) {
+                const double u_new = *uz * m[0] - *vz * m[1];
+                const double v_new = *uz * m[1] + *vz * m[0];
+                *uz = u_new;
+                *vz = v_new;
+            }
+        }
+    }
+}
+
 void CachedVectorReprojection::reprojectDirectionValues(shared_array<float>& angles, size_t size) const
 {
     if (ox == 0 || oy == 0 || matrix.get() == 0) {
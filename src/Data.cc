@@ -247,4 +247,30 @@ DataPtr convertValues(const Data& data, CDMDataType newType)
     throw CDMException("cannot convert unknown datatype");
 }
 
+namespace {
+
+template <typename T>
+shared_array<T> asWritable(const DataPtr& data, CDMDataType type, shared_array<T> (Data::*asT)() const)
+{
+    const Data& d = *data;
+    if (d.getDataType() != type || (data.use_count() == 1 && !d.isArrayShared()))
+        return (d.*asT)(); // a new array, or exclusively owned by data
+    const shared_array<T> shared = (d.*asT)();
+    shared_array<T> copy = make_pooled_array<T>(d.size());
+    std::copy(shared.get(), shared.get() + d.size(), copy.get());
+    return copy;
+}
+
+} // namespace
+
+shared_array<float> asWritableFloat(const DataPtr& data)
+{
+    return asWritable(data, CDM_FLOAT, &Data::asFloat);
+}
+
+shared_array<double> asWritableDouble(const DataPtr& data)
+{
+    return asWritable(data, CDM_DOUBLE, &Data::asDouble);
+}
+
 } // namespace MetNoFimex
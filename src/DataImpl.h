@@ -24,6 +24,7 @@
 #ifndef DATAIMPL_H_
 #define DATAIMPL_H_
 
+#include "fimex/ArrayPool.h"
 #include "fimex/CDMDataType.h"
 #include "fimex/CDMException.h"
 #include "fimex/Data.h"
@@ -86,7 +87,10 @@ class DataImpl : public Data
 public:
     /// constructor where the array will be automatically allocated
     explicit DataImpl(long length)
-        : length(length), theData(new C[length]) {}
+        : length(length)
+        , theData(make_pooled_array<C>(length))
+    {
+    }
     explicit DataImpl(shared_array<C> array, long length)
         : length(length)
         , theData(array)
@@ -105,6 +109,8 @@ public:
     virtual const shared_array<C> asBase() const { return theData; }
     /**
          * general conversion function, not in base since template methods not allowed
+         *
+         * If T == C, the internal array is returned without copying.
          */
     template <typename T>
     const shared_array<T> as() const
@@ -142,6 +148,7 @@ public:
                             double newScale, double newOffset) override;
     // specialized for each known type in Data.cc
     CDMDataType getDataType() const override;
+    bool isArrayShared() const override { return !theData.unique(); }
 
     /**
          * set the values of the data by the input-iterator
@@ -162,7 +169,8 @@ private:
 // (template definitions should be in header files (depending on compiler))
 template<typename C>
 DataImpl<C>::DataImpl(const DataImpl<C>& rhs)
-    : length(rhs.length), theData(new C[rhs.length])
+    : length(rhs.length)
+    , theData(make_pooled_array<C>(rhs.length))
 {
     std::copy(&rhs.theData[0], &rhs.theData[0] + rhs.length, &theData[0]);
 }
@@ -171,7 +179,7 @@ template<typename C>
 DataImpl<C>& DataImpl<C>::operator=(const DataImpl<C>& rhs)
 {
     length = rhs.length;
-    theData = shared_array<C>(new C[rhs.length]);
+    theData = make_pooled_array<C>(rhs.length);
     std::copy(&rhs.theData[0], &rhs.theData[0] + rhs.length, &theData[0]);
     return *this;
 }
@@ -261,14 +269,8 @@ DataPtr DataImpl<C>::slice(const std::vector<size_t>& orgDimSize, const std::vec
     C* newData = output->theData.get();
     C* oldData = theData.get();
 
-    // pre-calculation of the slice-size of the different dimensions
-    std::vector<size_t> orgSliceSize(orgDimSize.size(), 0);
-    orgSliceSize[0] = 1;
-    for (size_t dim = 1; dim < orgDimSize.size(); dim++) {
-        orgSliceSize[dim] = orgSliceSize[dim-1] * orgDimSize[dim-1];
-    }
     // slice the data
-    recursiveCopyMultiDimData(oldData, newData, orgDimSize, orgSliceSize, startDims, outputDimSize);
+    copyMultiDimData(oldData, newData, orgDimSize, startDims, outputDimSize);
 
     return output;
 }
@@ -286,10 +288,17 @@ template <typename OUT, typename IN>
 shared_array<OUT> convertArrayType(const shared_array<IN>& inData, size_t length, double oldFill, double oldScale, double oldOffset,
                                    UnitsConverter_p unitsConverter, double newFill, double newScale, double newOffset)
 {
-    shared_array<OUT> outData(new OUT[length]);
+    shared_array<OUT> outData = make_pooled_array<OUT>(length);
+    if (unitsConverter && unitsConverter->isLinear()) {
+        // fuse the unit conversion into scale and offset
+        double unitScale, unitOffset;
+        unitsConverter->getScaleOffset(unitScale, unitOffset);
+        oldScale *= unitScale;
+        oldOffset = oldOffset * unitScale + unitOffset;
+        unitsConverter = UnitsConverter_p();
+    }
     if (!unitsConverter) {
-        ScaleValue<IN, OUT> sv(oldFill, oldScale, oldOffset, newFill, newScale, newOffset);
-        std::transform(&inData[0], &inData[length], &outData[0], sv);
+        scaleArray(inData.get(), length, outData.get(), oldFill, oldScale, oldOffset, newFill, newScale, newOffset);
     } else {
         ScaleValueUnits<IN, OUT> sv(oldFill, oldScale, oldOffset, unitsConverter, newFill, newScale, newOffset);
         std::transform(&inData[0], &inData[length], &outData[0], sv);
@@ -340,7 +349,7 @@ DataPtr DataImpl<std::string>::convertDataType(double, double, double, UnitsConv
 template <typename T1, typename T2>
 shared_array<T1> ArrayTypeConverter<T1, T2>::operator()()
 {
-    shared_array<T1> outData(new T1[length]);
+    shared_array<T1> outData = make_pooled_array<T1>(length);
     std::transform(&inData[0], &inData[length], &outData[0], data_caster<T1, T2>());
     return outData;
 }
@@ -34,6 +34,7 @@
 #include "fimex/CDMDataType.h"
 #include "fimex/Data.h"
 #include "fimex/ReplaceStringTimeObject.h"
+#include "fimex/SliceBuilder.h"
 #include "fimex/String2Type.h"
 #include "fimex/StringUtils.h"
 #include "fimex/TimeUnit.h"
@@ -735,7 +736,7 @@ DataPtr FeltCDMReader2::getDataSlice(const string& varName, size_t unLimDimPos)
             vector<LevelPair> layerVals;
             if ((layerDim != 0) && (layerDim->getLength() > 0)) {
                 for (size_t i = 0; i < layerDim->getLength(); ++i) {
-                    layerVals.push_back(levelVecMap[layerDim->getName()][i]);
+                    layerVals.push_back(levelVecMap.at(layerDim->getName())[i]);
                 }
             } else {
                 // no layers, just 1 level
@@ -774,7 +775,6 @@ DataPtr FeltCDMReader2::getDataSlice(const string& varName, size_t unLimDimPos)
                 DataPtr levelData;
                 // level-data might be undefined, create a undefined slice then
                 try {
-                    OmpScopedLock lock(mutex_);
                     levelData = feltfile_->getScaledDataSlice(fa, t, *lit);
                 } catch (NoSuchField_Felt_File_Error nsfe) {
                     levelData = createData(variable.getDataType(), xDim * yDim, cdm_->getFillValue(varName));
@@ -793,4 +793,106 @@ DataPtr FeltCDMReader2::getDataSlice(const string& varName, size_t unLimDimPos)
 }
 
 
+DataPtr FeltCDMReader2::getDataSlice(const string& varName, const SliceBuilder& sb)
+{
+    LOG4FIMEX(logger, Logger::DEBUG, "reading var: "<< varName << " with slicebuilder");
+    const CDMVariable& variable = cdm_->getVariable(varName);
+    map<string, string>::const_iterator foundId = varNameFeltIdMap.find(variable.getName());
+    if (variable.hasData() || foundId == varNameFeltIdMap.end()) {
+        return CDMReader::getDataSlice(varName, sb);
+    }
+
+    // felt data is x,y,[ensemble],[level],[time], see initAddVariablesFromXML
+    size_t xStart = 0, xSize = 0, yStart = 0, ySize = 0;
+    size_t eStart = 0, eSize = 1, lStart = 0, lSize = 1, tStart = 0, tSize = 1;
+    const CDMDimension* layerDim = 0;
+    bool hasEnsemble = false, hasTime = false;
+    const vector<string>& dims = variable.getShape();
+    for (vector<string>::const_iterator it = dims.begin(); it != dims.end(); ++it) {
+        const CDMDimension& dim = cdm_->getDimension(*it);
+        if (dim.getName() == xDim.getName()) {
+            sb.getStartAndSize(*it, xStart, xSize);
+        } else if (dim.getName() == yDim.getName()) {
+            sb.getStartAndSize(*it, yStart, ySize);
+        } else if (dim.isUnlimited()) {
+            sb.getStartAndSize(*it, tStart, tSize);
+            hasTime = true;
+        } else if (dim.getName() == "ensemble_member") {
+            sb.getStartAndSize(*it, eStart, eSize);
+            hasEnsemble = true;
+        } else {
+            sb.getStartAndSize(*it, lStart, lSize);
+            layerDim = &dim;
+        }
+    }
+    if (hasTime && tStart + tSize > timeVec.size()) {
+        throw CDMException("requested time outside data-region");
+    }
+
+    const size_t layerSize = xSize * ySize;
+    DataPtr data = createData(variable.getDataType(), layerSize * eSize * lSize * tSize, cdm_->getFillValue(varName));
+    if (data->size() == 0)
+        return data;
+    try {
+        std::shared_ptr<MetNoFelt::Felt_Array2> fa(feltfile_->getFeltArray(foundId->second));
+
+        // only the requested levels and ensemble members
+        vector<LevelPair> layerVals;
+        if ((layerDim != 0) && (layerDim->getLength() > 0)) {
+            const vector<LevelPair>& levels = levelVecMap.at(layerDim->getName());
+            layerVals.assign(levels.begin() + lStart, levels.begin() + lStart + lSize);
+        } else {
+            // no layers, just 1 level
+            vector<LevelPair> levels = fa->getLevelPairs();
+            if (levels.size() == 1) {
+                layerVals.push_back(*(levels.begin()));
+            } else {
+                throw CDMException("variable " +variable.getName() + " has unspecified levels");
+            }
+        }
+        vector<short> ensembles;
+        if (hasEnsemble) {
+            const vector<short> allEnsembles = feltfile_->getEnsembleMembers();
+            ensembles.assign(allEnsembles.begin() + eStart, allEnsembles.begin() + eStart + eSize);
+        }
+
+        const vector<MetNoFimex::FimexTime> faTimes = fa->getTimes();
+        size_t dataCurrentPos = 0;
+        for (size_t ti = tStart; ti < tStart + tSize; ++ti) {
+            // get the time, if available
+            MetNoFimex::FimexTime t;
+            if (timeVec.size() > 0) {
+                t = timeVec[ti];
+            }
+            if (!faTimes.empty() && find(faTimes.begin(), faTimes.end(), t) == faTimes.end()) {
+                // time not available for this variable, keep undefined
+                dataCurrentPos += layerSize * eSize * lSize;
+                continue;
+            }
+            for (vector<LevelPair>::const_iterator lit = layerVals.begin(); lit != layerVals.end(); ++lit) {
+                for (size_t e = 0; e < eSize; ++e) {
+                    LevelPair lp = *lit;
+                    if (hasEnsemble)
+                        lp.second = ensembles.at(e);
+                    // level-data might be undefined, keep undefined slice then
+                    try {
+                        DataPtr levelData = feltfile_->getScaledDataSlice(fa, t, lp, xStart, xSize, yStart, ySize);
+                        assert(levelData->size() == layerSize);
+                        data->setValues(dataCurrentPos, *levelData, 0, levelData->size());
+                    } catch (NoSuchField_Felt_File_Error&) {
+                    }
+                    dataCurrentPos += layerSize;
+                }
+            }
+        }
+    } catch (MetNoFelt::Felt_File_Error& ffe) {
+        throw CDMException(string("Felt_File_Error: ") + ffe.what());
+    } catch (CDMException&) {
+        throw;
+    } catch (exception& e) {
+        throw CDMException(string("non-Felt_File_Error: ") + e.what());
+    }
+    return data;
+}
+
 }
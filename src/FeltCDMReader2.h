@@ -36,7 +36,6 @@
     CDMFileReaderFactory::create(MIFI_FILETYPE_*,file,config)
 #endif
 
-#include "MutexLock.h"
 #include "fimex/CDMDimension.h"
 #include "fimex/CDMReader.h"
 #include "fimex/Felt_Types.h"
@@ -66,12 +65,12 @@ public:
 
     using CDMReader::getDataSlice;
     virtual DataPtr getDataSlice(const std::string& varName, size_t unLimDimPos);
+    virtual DataPtr getDataSlice(const std::string& varName, const SliceBuilder& sb);
 
 private:
     const std::string filename;
     std::string configId;
     std::shared_ptr<MetNoFelt::Felt_File2> feltfile_;
-    OmpMutex mutex_;
     CDMDimension xDim;
     CDMDimension yDim;
     std::map<std::string, std::string> varNameFeltIdMap;
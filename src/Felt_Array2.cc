@@ -236,7 +236,15 @@ int Felt_Array2::getGrid(const MetNoFimex::FimexTime& time, LevelPair levelPair,
 int Felt_Array2::getGridAllowDelta(const MetNoFimex::FimexTime& time, LevelPair levelPair, vector<short>& gridOut,
                                    const std::array<float, 6>& gridParameterDelta)
 {
-    const std::shared_ptr<felt::FeltField>& field = getField(time, levelPair);
+    const std::shared_ptr<felt::FeltField> field = getCheckedField(time, levelPair, gridParameterDelta);
+    field->grid(gridOut);
+    return field->scaleFactor();
+}
+
+std::shared_ptr<felt::FeltField> Felt_Array2::getCheckedField(const MetNoFimex::FimexTime& time, LevelPair levelPair,
+                                                              const std::array<float, 6>& gridParameterDelta)
+{
+    const std::shared_ptr<felt::FeltField> field = getField(time, levelPair);
 
     // make consistency checks
      int fieldGridType = field->gridType();
@@ -244,9 +252,6 @@ int Felt_Array2::getGridAllowDelta(const MetNoFimex::FimexTime& time, LevelPair
      if (getGridType() != fieldGridType)
          throw Felt_File_Error("gridType changes from "+type2string(getGridType()) +" to " + type2string(fieldGridType) + " in parameter " + getName());
 
-    // set the output data
-    field->grid(gridOut);
-
      // check parameters against delta
     const std::array<float, 6> newParams = field->projectionInformation()->getGridParameters();
     const std::array<float, 6> defaultParams = defaultField_->projectionInformation()->getGridParameters();
@@ -256,7 +261,7 @@ int Felt_Array2::getGridAllowDelta(const MetNoFimex::FimexTime& time, LevelPair
             throw Felt_File_Error("cannot change gridParameters within a file for " + getName() + " gridParameter (c-counting) " + type2string(i) + ": " + type2string(defaultParams[i]) + " != " + type2string(newParams[i]) + "("+type2string(newParams[i]-defaultParams[i])+")");
         }
     }
-    return field->scaleFactor();
+    return field;
 }
 
 int Felt_Array2::getGridType() const
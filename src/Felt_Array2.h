@@ -99,6 +99,11 @@ public:
      * change up to the value provided in gridParameterDelta
      */
     int getGridAllowDelta(const MetNoFimex::FimexTime& time, LevelPair levelPair, vector<short>& gridOut, const std::array<float, 6>& gridParameterDelta);
+    /**
+     * fetch the field for a time and a levelPair, with the same consistency checks as getGridAllowDelta
+     * @throws Felt_File_Error if the gridDefinition (gridType or gridParameters) change
+     */
+    std::shared_ptr<felt::FeltField> getCheckedField(const MetNoFimex::FimexTime& time, LevelPair levelPair, const std::array<float, 6>& gridParameterDelta);
     /// get the felt level type of this array
     int getLevelType() const;
     /** return the changed fill used in #Felt_File::getScaledDataSlice */
@@ -224,38 +224,65 @@ private:
     const double scalingFactor;
 };
 
-// convert felt short to a scaled Data
+// convert ySize rows of xSize felt shorts, rows starting rowStride apart, to a scaled Data
 template <typename T>
-std::shared_ptr<MetNoFimex::Data> createScaledData(const vector<short>& indata, double newFillValue, double scalingFactor)
+std::shared_ptr<MetNoFimex::Data> createScaledData(const short* indata, size_t rowStride, size_t xSize, size_t ySize, double newFillValue, double scalingFactor)
 {
-    shared_array<T> data(new T[indata.size()]);
+    const size_t size = xSize * ySize;
+    shared_array<T> data(new T[size]);
     Scale<T> scale(newFillValue, scalingFactor);
-    std::transform(&indata[0], &indata[0]+indata.size(), &data[0], scale);
-    return MetNoFimex::createData(indata.size(), data);
+    for (size_t y = 0; y < ySize; ++y) {
+        const short* row = indata + y * rowStride;
+        std::transform(row, row + xSize, &data[y * xSize], scale);
+    }
+    return MetNoFimex::createData(size, data);
 }
 
-std::shared_ptr<MetNoFimex::Data> Felt_File2::getScaledDataSlice(std::shared_ptr<Felt_Array2> feltArray, const MetNoFimex::FimexTime& time,
-                                                                 const LevelPair level)
+namespace {
+std::shared_ptr<MetNoFimex::Data> scaleFieldData(const Felt_Array2& feltArray, const felt::FeltField& field, const short* data, size_t rowStride,
+                                                 size_t xSize, size_t ySize)
 {
-    size_t dataSize = feltArray->getX() * feltArray->getY();
-    vector<short> data;
-    data.reserve(dataSize);
-    int fieldScaleFactor = feltArray->getGridAllowDelta(time, level, data, gridParameterDelta_);
-
-    std::shared_ptr<MetNoFimex::Data> returnData;
-    if (feltArray->getDatatype() == "short") {
-        if (fieldScaleFactor != feltArray->scaleFactor()) {
-            throw Felt_File_Error("change in scaling factor for parameter: " + feltArray->getName() + " consider using float or double datatpye");
+    const int fieldScaleFactor = field.scaleFactor();
+    if (feltArray.getDatatype() == "short") {
+        if (fieldScaleFactor != feltArray.scaleFactor()) {
+            throw Felt_File_Error("change in scaling factor for parameter: " + feltArray.getName() + " consider using float or double datatpye");
         }
-        returnData = createScaledData<short>(data, feltArray->getFillValue(), 1.);
-    } else if (feltArray->getDatatype() == "float") {
-        returnData = createScaledData<float>(data, feltArray->getFillValue(), std::pow(10,static_cast<double>(fieldScaleFactor)));
-    } else if (feltArray->getDatatype() == "double") {
-        returnData = createScaledData<double>(data, feltArray->getFillValue(), std::pow(10,static_cast<double>(fieldScaleFactor)));
+        return createScaledData<short>(data, rowStride, xSize, ySize, feltArray.getFillValue(), 1.);
+    } else if (feltArray.getDatatype() == "float") {
+        return createScaledData<float>(data, rowStride, xSize, ySize, feltArray.getFillValue(), std::pow(10,static_cast<double>(fieldScaleFactor)));
+    } else if (feltArray.getDatatype() == "double") {
+        return createScaledData<double>(data, rowStride, xSize, ySize, feltArray.getFillValue(), std::pow(10,static_cast<double>(fieldScaleFactor)));
     } else {
-        throw Felt_File_Error("unknown datatype for feltArray " + feltArray->getName() + ": " + feltArray->getDatatype());
+        throw Felt_File_Error("unknown datatype for feltArray " + feltArray.getName() + ": " + feltArray.getDatatype());
     }
-    return returnData;
+}
+} // namespace
+
+std::shared_ptr<MetNoFimex::Data> Felt_File2::getScaledDataSlice(std::shared_ptr<Felt_Array2> feltArray, const MetNoFimex::FimexTime& time,
+                                                                 const LevelPair level)
+{
+    const std::shared_ptr<felt::FeltField> field = feltArray->getCheckedField(time, level, gridParameterDelta_);
+    // decode directly from the memory-mapped file, buffer is only used if that is not possible
+    vector<short> buffer;
+    const short* data = field->gridData(buffer);
+    const size_t dataSize = field->gridSize();
+    return scaleFieldData(*feltArray, *field, data, dataSize, dataSize, 1);
+}
+
+std::shared_ptr<MetNoFimex::Data> Felt_File2::getScaledDataSlice(std::shared_ptr<Felt_Array2> feltArray, const MetNoFimex::FimexTime& time,
+                                                                 const LevelPair level, size_t xStart, size_t xSize, size_t yStart, size_t ySize)
+{
+    const std::shared_ptr<felt::FeltField> field = feltArray->getCheckedField(time, level, gridParameterDelta_);
+    const size_t nx = field->xNum(), ny = field->yNum();
+    if (xStart + xSize > nx || yStart + ySize > ny)
+        throw Felt_File_Error("sub-domain outside grid of parameter " + feltArray->getName());
+    if (xSize == 0 || ySize == 0)
+        return scaleFieldData(*feltArray, *field, 0, nx, 0, 0);
+
+    // only the words from the first to the last requested point
+    vector<short> buffer;
+    const short* data = field->gridData(buffer, yStart * nx + xStart, (ySize - 1) * nx + xSize);
+    return scaleFieldData(*feltArray, *field, data, nx, xSize, ySize);
 }
 
 std::map<short, std::vector<LevelPair> > Felt_File2::getFeltLevelPairs() const {
@@ -90,6 +90,16 @@ public:
      * @param level level of slice
      */
     MetNoFimex::DataPtr getScaledDataSlice(std::shared_ptr<Felt_Array2> feltArray, const MetNoFimex::FimexTime& time, const LevelPair level);
+    /**
+     * retrieve a sub-domain of a data slice, decoding only the requested rows and columns
+     *
+     * @param time time of slice
+     * @param level level of slice
+     * @param xStart,xSize columns to read
+     * @param yStart,ySize rows to read
+     */
+    MetNoFimex::DataPtr getScaledDataSlice(std::shared_ptr<Felt_Array2> feltArray, const MetNoFimex::FimexTime& time, const LevelPair level,
+                                           size_t xStart, size_t xSize, size_t yStart, size_t ySize);
 
     /**
      *  retrieve all felt arrays
@@ -23,6 +23,8 @@
 
 #include "fimex/FileUtils.h"
 
+#include "MutexLock.h"
+
 #include "fimex/CDMException.h"
 #include "fimex/Logger.h"
 #include "fimex/StringUtils.h"
@@ -32,8 +34,11 @@
 #include <cstdlib>
 #include <cstring>
 #include <exception>
+#include <ctime>
 #include <iomanip>
 #include <iostream>
+#include <map>
+#include <memory>
 
 #if __cplusplus >= 201703L
 #define HAVE_STD_FILESYSTEM 1
@@ -95,21 +100,66 @@ std::string path_string(const path_t& path)
 #endif
 }
 
-std::vector<path_t> directory_contents(const path_t& dir)
+filetype_t file_type(const path_t& path)
+{
+#if defined(HAVE_STD_OR_BOOST_FILESYSTEM)
+    try {
+        fs::file_status stat = fs::file_status(fs::status(path));
+        if (fs::is_directory(stat)) {
+            return DIRECTORY;
+        } else if (fs::is_regular_file(stat)) {
+            return REGULAR_FILE;
+        } else {
+            return OTHER;
+        }
+    } catch (std::exception& ex) {
+        return ERROR;
+    }
+#else
+    struct stat sb;
+    if (stat(path.c_str(), &sb) != 0)
+        return ERROR;
+    else if (S_ISDIR(sb.st_mode))
+        return DIRECTORY;
+    else if (S_ISREG(sb.st_mode))
+        return REGULAR_FILE;
+    else
+        return OTHER;
+#endif
+}
+
+
+//! directory entries with their file type
+typedef std::vector<std::pair<path_t, filetype_t>> entries_t;
+
+entries_t directory_entries(const path_t& dir)
 {
-    std::vector<path_t> entries;
+    entries_t entries;
 #if defined(HAVE_STD_OR_BOOST_FILESYSTEM)
-    copy(fs::directory_iterator(dir), fs::directory_iterator(), back_inserter(entries));
+    for (fs::directory_iterator it(dir); it != fs::directory_iterator(); ++it)
+        entries.push_back(std::make_pair(it->path(), file_type(it->path())));
 #else
     std::string prefix = dir;
     if (!prefix.empty() && prefix[prefix.size() - 1] != '/')
         prefix += '/';
     if (DIR* d = opendir(dir.c_str())) {
-        /* print all the files and directories within directory */
         while (struct dirent* dent = readdir(d)) {
             const std::string name = dent->d_name;
-            if (name != "." && name != "..")
-                entries.push_back(prefix + name);
+            if (name == "." || name == "..")
+                continue;
+            const std::string path = prefix + name;
+#ifdef _DIRENT_HAVE_D_TYPE
+            // avoid a stat for each entry if the filesystem tells the type
+            if (dent->d_type == DT_REG) {
+                entries.push_back(std::make_pair(path, REGULAR_FILE));
+                continue;
+            } else if (dent->d_type == DT_DIR) {
+                entries.push_back(std::make_pair(path, DIRECTORY));
+                continue;
+            }
+#endif
+            // unknown, symbolic link, ...
+            entries.push_back(std::make_pair(path, file_type(path)));
         }
         closedir(d);
     } else {
@@ -120,66 +170,257 @@ std::vector<path_t> directory_contents(const path_t& dir)
     return entries;
 }
 
-filetype_t file_type(const path_t& path)
+/**
+ * Modification time of a directory, usable as key for its contents.
+ *
+ * @return false if there is no modification time, or if the directory might
+ *         still change without changing the modification time
+ */
+bool directory_mtime(const path_t& dir, long long& mtime)
 {
 #if defined(HAVE_STD_OR_BOOST_FILESYSTEM)
     try {
-        fs::file_status stat = fs::file_status(fs::status(path));
-        if (fs::is_directory(stat)) {
-            return DIRECTORY;
-        } else if (fs::is_regular_file(stat)) {
-            return REGULAR_FILE;
-        } else {
-            return OTHER;
-        }
+        mtime = static_cast<long long>(fs::last_write_time(dir).time_since_epoch().count());
+        return true;
     } catch (std::exception& ex) {
-        return ERROR;
+        return false;
     }
 #else
     struct stat sb;
-    if (stat(path.c_str(), &sb) != 0)
-        return ERROR;
-    else if (S_ISDIR(sb.st_mode))
-        return DIRECTORY;
-    else if (S_ISREG(sb.st_mode))
-        return REGULAR_FILE;
-    else
-        return OTHER;
+    if (stat(dir.c_str(), &sb) != 0)
+        return false;
+    mtime = sb.st_mtime;
+    // the resolution is only seconds, the directory might change again within this second
+    return mtime + 1 < static_cast<long long>(time(0));
 #endif
 }
 
-} // namespace
+struct ScanCacheEntry
+{
+    long long mtime;
+    std::shared_ptr<const entries_t> entries;
+};
 
-// internal implementation of scanFiles
-static void scanFiles_(std::vector<std::string>& files, const path_t& dir, int depth, const std::regex& regexp, bool matchFileOnly,
-                       std::string currentRelDir = "", int depthCount = 0)
+//! directory contents by directory, only used when enabled by setScanCache
+struct ScanCache
 {
-    LOG4FIMEX(logger, Logger::DEBUG, "scanning directory " + path_string(dir));
-    if (depthCount > 1000) {
-        throw CDMException("possible circular reference: more than 1000 subdirectories found at " + path_string(dir));
+    bool enabled;
+    std::map<std::string, ScanCacheEntry> dirs;
+    OmpMutex mutex;
+    ScanCache()
+        : enabled(false)
+    {
     }
-    std::vector<path_t> entries = directory_contents(dir);
-    for (const path_t& e : entries) {
-        const filetype_t ft = file_type(e);
-        if (ft == DIRECTORY) {
-            if (depth != 0) {
-                if (!matchFileOnly) {
-                    // remember the directory behind start-directory
-                    currentRelDir += path_filename_string(e) + "/";
-                }
-                scanFiles_(files, e, depth - 1, regexp, matchFileOnly, currentRelDir, depthCount + 1);
+};
+
+ScanCache& scanCache()
+{
+    static ScanCache cache;
+    return cache;
+}
+
+std::shared_ptr<const entries_t> cached_directory_entries(const path_t& dir)
+{
+    ScanCache& cache = scanCache();
+    {
+        OmpScopedLock lock(cache.mutex);
+        if (!cache.enabled)
+            return std::make_shared<const entries_t>(directory_entries(dir));
+    }
+    long long mtime = 0;
+    if (!directory_mtime(dir, mtime))
+        return std::make_shared<const entries_t>(directory_entries(dir));
+
+    const std::string key = path_string(dir);
+    {
+        OmpScopedLock lock(cache.mutex);
+        const std::map<std::string, ScanCacheEntry>::const_iterator it = cache.dirs.find(key);
+        if (it != cache.dirs.end() && it->second.mtime == mtime) {
+            LOG4FIMEX(logger, Logger::DEBUG, "using cached contents of directory " << key);
+            return it->second.entries;
+        }
+    }
+    ScanCacheEntry entry;
+    entry.mtime = mtime;
+    entry.entries = std::make_shared<const entries_t>(directory_entries(dir));
+    OmpScopedLock lock(cache.mutex);
+    if (cache.enabled)
+        cache.dirs[key] = entry;
+    return entry.entries;
+}
+
+//! a directory visited by scanFiles
+struct ScanDir
+{
+    path_t path;
+    std::string relDir; //!< path behind the start-directory, with trailing '/'
+    int depth;          //!< remaining depth, negative is unlimited
+    int depthCount;
+    //! matching files (dir == 0) and subdirectories (index in scan dirs), sorted
+    std::vector<std::pair<std::string, size_t>> items;
+    std::vector<path_t> subdirs;
+};
+
+//! list the matching files and the subdirectories to visit of one directory
+void scanDirectory(ScanDir& sd, const FileMatcher& matcher, bool matchFileOnly)
+{
+    LOG4FIMEX(logger, Logger::DEBUG, "scanning directory " + path_string(sd.path));
+    const std::shared_ptr<const entries_t> entries = cached_directory_entries(sd.path);
+    for (const auto& e : *entries) {
+        if (e.second == DIRECTORY) {
+            if (sd.depth != 0) {
+                // index is filled in when the subdirectory is added to the scan dirs
+                sd.items.push_back(std::make_pair(std::string(), sd.subdirs.size()));
+                sd.subdirs.push_back(e.first);
             }
-        } else if (ft == REGULAR_FILE) {
-            const std::string filename = (matchFileOnly ? "" : currentRelDir) + path_filename_string(e);
-            if (std::regex_match(filename, regexp)) {
-                files.push_back(path_string(e));
+        } else if (e.second == REGULAR_FILE) {
+            const std::string filename = path_filename_string(e.first);
+            if (matcher(matchFileOnly ? filename : sd.relDir + filename)) {
+                sd.items.push_back(std::make_pair(path_string(e.first), 0));
             }
         }
     }
 }
+
+void collectFiles(std::vector<std::string>& files, const std::vector<ScanDir>& dirs, size_t d)
+{
+    for (const auto& item : dirs[d].items) {
+        if (item.first.empty())
+            collectFiles(files, dirs, item.second);
+        else
+            files.push_back(item.first);
+    }
+}
+
+//! state of a glob pattern, see globMatcher
+enum GlobToken { GLOB_CHAR, GLOB_ONE, GLOB_STAR, GLOB_STARSTAR };
+
+bool matchGlob(const std::vector<std::pair<GlobToken, char>>& tokens, const std::string& name)
+{
+    // simulate the automaton, current[i] == true if tokens[0..i) match
+    const size_t n = tokens.size();
+    std::vector<char> current(n + 1, 0), next(n + 1, 0);
+    current[0] = 1;
+    for (size_t i = 0; i < n && (tokens[i].first == GLOB_STAR || tokens[i].first == GLOB_STARSTAR); ++i)
+        current[i + 1] = 1; // '*' might match nothing
+    for (const char c : name) {
+        std::fill(next.begin(), next.end(), 0);
+        bool any = false;
+        for (size_t i = 0; i < n; ++i) {
+            if (!current[i])
+                continue;
+            const GlobToken t = tokens[i].first;
+            if ((t == GLOB_STAR && c != '/') || t == GLOB_STARSTAR) {
+                next[i] = 1;
+                any = true;
+            } else if ((t == GLOB_ONE && c != '/') || (t == GLOB_CHAR && c == tokens[i].second)) {
+                next[i + 1] = 1;
+                any = true;
+            }
+        }
+        if (!any)
+            return false;
+        for (size_t i = 0; i < n; ++i) {
+            if (next[i] && (tokens[i].first == GLOB_STAR || tokens[i].first == GLOB_STARSTAR))
+                next[i + 1] = 1;
+        }
+        current.swap(next);
+    }
+    return current[n] != 0;
+}
+
+} // namespace
+
+void setScanCache(bool enable)
+{
+    ScanCache& cache = scanCache();
+    OmpScopedLock lock(cache.mutex);
+    cache.enabled = enable;
+    if (!enable)
+        cache.dirs.clear();
+}
+
+FileMatcher suffixMatcher(const std::string& suffix)
+{
+    return [suffix](const std::string& name) { return ends_with(name, suffix); };
+}
+
+FileMatcher globMatcher(const std::string& glob)
+{
+    std::vector<std::pair<GlobToken, char>> tokens;
+    for (size_t i = 0; i < glob.size(); i++) {
+        const char c = glob[i];
+        if (c == '?') {
+            tokens.push_back(std::make_pair(GLOB_ONE, c));
+        } else if (c == '*') {
+            if (i + 1 < glob.size() && glob[i + 1] == '*') {
+                i++;
+                tokens.push_back(std::make_pair(GLOB_STARSTAR, c));
+            } else {
+                tokens.push_back(std::make_pair(GLOB_STAR, c));
+            }
+        } else {
+            tokens.push_back(std::make_pair(GLOB_CHAR, c));
+        }
+    }
+    return [tokens](const std::string& name) { return matchGlob(tokens, name); };
+}
+
 void scanFiles(std::vector<std::string>& files, const std::string& dir, int depth, const std::regex& regexp, bool matchFileOnly)
 {
-    scanFiles_(files, path_t(dir), depth, regexp, matchFileOnly);
+    scanFiles(files, dir, depth, [&regexp](const std::string& name) { return std::regex_match(name, regexp); }, matchFileOnly);
+}
+
+void scanFiles(std::vector<std::string>& files, const std::string& dir, int depth, const FileMatcher& matcher, bool matchFileOnly)
+{
+    // visit the directories level by level, the directories of one level in parallel
+    std::vector<ScanDir> dirs(1);
+    dirs[0].path = path_t(dir);
+    dirs[0].depth = depth;
+    dirs[0].depthCount = 0;
+    size_t levelBegin = 0;
+    while (levelBegin < dirs.size()) {
+        const size_t levelEnd = dirs.size();
+        const int nDirs = levelEnd - levelBegin;
+        std::vector<std::string> errors(nDirs);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) default(shared) if (nDirs > 1)
+#endif
+        for (int k = 0; k < nDirs; ++k) {
+            try {
+                scanDirectory(dirs[levelBegin + k], matcher, matchFileOnly);
+            } catch (std::exception& ex) {
+                errors[k] = ex.what();
+            }
+        }
+        for (const std::string& error : errors) {
+            if (!error.empty())
+                throw CDMException(error);
+        }
+
+        for (size_t d = levelBegin; d < levelEnd; ++d) {
+            for (auto& item : dirs[d].items) {
+                if (!item.first.empty())
+                    continue;
+                ScanDir sub;
+                sub.path = dirs[d].subdirs[item.second];
+                sub.depth = dirs[d].depth - 1;
+                sub.depthCount = dirs[d].depthCount + 1;
+                if (sub.depthCount > 1000) {
+                    throw CDMException("possible circular reference: more than 1000 subdirectories found at " + path_string(dirs[d].path));
+                }
+                if (!matchFileOnly) {
+                    // remember the directory behind start-directory
+                    sub.relDir = dirs[d].relDir + path_filename_string(sub.path) + "/";
+                }
+                item.second = dirs.size();
+                dirs.push_back(sub);
+            }
+            dirs[d].subdirs.clear();
+        }
+        levelBegin = levelEnd;
+    }
+    collectFiles(files, dirs, 0);
 }
 
 void globFiles(std::vector<std::string>& files, const std::string& glob)
@@ -201,29 +442,7 @@ void globFiles(std::vector<std::string>& files, const std::string& glob)
         depth = std::count(reg.begin(), reg.end(), '/');
     }
 
-    // replace ** to .*
-    // replace * to [^/]*
-    // replace ? to [^/]?
-    // and escaping everything else
-    std::ostringstream output;
-    for (size_t i = 0; i < reg.size(); i++) {
-        char charI = reg[i];
-        if (charI == '?') {
-            output << "[^/]";
-        } else if (charI == '*') {
-            if (i + 1 < reg.size() && reg[i + 1] == '*') {
-                i++;
-                // two ** match also new directories
-                output << ".*";
-            } else {
-                output << "[^/]*";
-            }
-        } else {
-            regex_escape(output, charI);
-        }
-    }
-    std::regex globReg(output.str());
-    scanFiles(files, dir, depth, globReg, false);
+    scanFiles(files, dir, depth, globMatcher(reg), false);
 }
 
 std::string getExtension(const std::string& fileName)
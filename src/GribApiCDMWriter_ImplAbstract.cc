@@ -23,6 +23,8 @@
 
 #include "GribApiCDMWriter_ImplAbstract.h"
 
+#include "fimex_config.h"
+
 #include "fimex/CDM.h"
 #include "fimex/CDMReaderUtils.h"
 #include "fimex/CoordinateSystemSliceBuilder.h"
@@ -49,6 +51,10 @@
 #include <cstring>
 #include <functional>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 namespace MetNoFimex {
 
 static Logger_p logger = getLogger("fimex.GribApi_CDMWriter");
@@ -135,6 +141,14 @@ void GribApiCDMWriter_ImplAbstract::run()
     using namespace std;
     LOG4FIMEX(logger, Logger::DEBUG, "GribApiCDMWriter_ImplAbstract::run()  " );
 
+    // number of messages collected before packing them in parallel,
+    // only with a grib_api/ecCodes built with thread support
+#if defined(_OPENMP) && defined(HAVE_GRIB_API_THREADSAFE)
+    const size_t maxPendingMessages = 2 * omp_get_max_threads();
+#else
+    const size_t maxPendingMessages = 1;
+#endif
+
     // default to grid_second_order
 //    string pType("grid_second_order");
 //    try {
@@ -251,6 +265,7 @@ void GribApiCDMWriter_ImplAbstract::run()
 
             // loops over ref-times, times, variables and levels
             map<string, string> variableWarnings;
+            vector<EncodeJob> messages;
             size_t rtPos = 0;
             for (const FimexTime& rTime : refTimes) {
                 if (refTimes.size() > 1) {
@@ -291,8 +306,13 @@ void GribApiCDMWriter_ImplAbstract::run()
                                     size_t countMissing = count(&da[0], &da[0] + data->size(), cdm.getFillValue(*var));
                                     if (countMissing < data->size()) {
                                         data = handleTypeScaleAndMissingData(*var, levelVal, data);
-                                        setData(data);
-                                        writeGribHandleToFile();
+                                        // all metadata is set, the values are packed in parallel later
+                                        std::shared_ptr<grib_handle> msgHandle(grib_handle_clone(gribHandle.get()), grib_handle_delete);
+                                        if (!msgHandle)
+                                            throw CDMException("unable to clone grib handle");
+                                        messages.push_back(EncodeJob(*var, msgHandle, data));
+                                        if (messages.size() >= maxPendingMessages)
+                                            encodeAndWriteMessages(messages, variableWarnings);
                                     } else {
                                         LOG4FIMEX(logger, Logger::DEBUG, "all vals invalid, dropping " << *var << " level " << levelVal << " time " << *vTime);
                                     }
@@ -304,6 +324,7 @@ void GribApiCDMWriter_ImplAbstract::run()
                     }
                 }
             }
+            encodeAndWriteMessages(messages, variableWarnings);
             for (map<string, string>::iterator w = variableWarnings.begin(); w != variableWarnings.end(); ++w) {
                 LOG4FIMEX(logger, Logger::WARN, "unable to write parameter "<< w->first << ": " << w->second);
             }
@@ -356,9 +377,42 @@ void GribApiCDMWriter_ImplAbstract::setNodesAttributes(std::string attName, void
     }
 }
 
-void GribApiCDMWriter_ImplAbstract::setData(const DataPtr& data)
+void GribApiCDMWriter_ImplAbstract::setData(grib_handle* handle, const DataPtr& data)
 {
-    GRIB_CHECK(grib_set_double_array(gribHandle.get(), "values", data->asDouble().get(), data->size()), "setting values");
+    GRIB_CHECK(grib_set_double_array(handle, "values", data->asDouble().get(), data->size()), "setting values");
+}
+
+void GribApiCDMWriter_ImplAbstract::encodeAndWriteMessages(std::vector<EncodeJob>& messages, std::map<std::string, std::string>& variableWarnings)
+{
+    const long nMessages = messages.size();
+    // packing (e.g. second order or ccsds) is expensive, do it on independent handles in parallel;
+    // the handles share the default grib_context, which requires a thread-safe grib_api/ecCodes
+#if defined(_OPENMP) && defined(HAVE_GRIB_API_THREADSAFE)
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (long i = 0; i < nMessages; ++i) {
+        EncodeJob& msg = messages[i];
+        try {
+            setData(msg.handle.get(), msg.data);
+            msg.data.reset(); // release memory early
+        } catch (std::exception& ex) {
+            msg.error = ex.what();
+        }
+    }
+
+    // write in the original order
+    for (EncodeJob& msg : messages) {
+        if (msg.error.empty()) {
+            try {
+                writeGribHandleToFile(msg.handle.get());
+            } catch (std::exception& ex) {
+                msg.error = ex.what();
+            }
+        }
+        if (!msg.error.empty())
+            variableWarnings[msg.varName] = msg.error;
+    }
+    messages.clear();
 }
 
 void GribApiCDMWriter_ImplAbstract::setTime(const std::string& varName, const FimexTime& rtime, const FimexTime& vTime, const std::string& stepUnits)
@@ -514,14 +568,14 @@ std::vector<FimexTime> GribApiCDMWriter_ImplAbstract::getTimes(const std::string
     return timeData;
 }
 
-void GribApiCDMWriter_ImplAbstract::writeGribHandleToFile()
+void GribApiCDMWriter_ImplAbstract::writeGribHandleToFile(grib_handle* handle)
 {
     LOG4FIMEX(logger, Logger::DEBUG, "writeGribHandleToFile");
     // write data to file
     size_t size;
     const void* buffer;
     /* get the coded message in a buffer */
-    GRIB_CHECK(grib_get_message(gribHandle.get(),&buffer,&size),0);
+    GRIB_CHECK(grib_get_message(handle, &buffer, &size), 0);
     gribFile.write(reinterpret_cast<const char*>(buffer), size);
 }
 
@@ -32,6 +32,8 @@
 #include "fimex/XMLDoc.h"
 
 #include <fstream>
+#include <map>
+#include <vector>
 
 // forward declaration
 struct grib_handle;
@@ -70,7 +72,12 @@ protected:
      */
     void setNodesAttributes(std::string attName, void* node = 0);
 
-    virtual void setData(const DataPtr& data);
+    /**
+     * set the data values of a grib-handle, this packs the data
+     *
+     * @warning this is called in parallel for different handles and must not modify the writer
+     */
+    virtual void setData(grib_handle* handle, const DataPtr& data);
     /**
      * set the projection parameters, throw an exception if none are available
      * @param varName
@@ -97,7 +104,7 @@ protected:
      * @return modified data
      */
     virtual DataPtr handleTypeScaleAndMissingData(const std::string& varName, double levelValue, DataPtr inData) = 0;
-    virtual void writeGribHandleToFile();
+    virtual void writeGribHandleToFile(grib_handle* handle);
     /**
      * check if the varName exists in the config file
      *
@@ -121,6 +128,29 @@ protected:
     std::shared_ptr<grib_handle> gribHandle;
 
 private:
+    /**
+     * a grib message with all metadata set, waiting for its data to be packed
+     */
+    struct EncodeJob
+    {
+        EncodeJob(const std::string& varName, std::shared_ptr<grib_handle> handle, DataPtr data)
+            : varName(varName)
+            , handle(handle)
+            , data(data)
+        {
+        }
+        std::string varName;
+        std::shared_ptr<grib_handle> handle;
+        DataPtr data;
+        std::string error;
+    };
+
+    /**
+     * pack the data of all messages in parallel and write them
+     * to the file in the order of the vector, then clear the vector
+     */
+    void encodeAndWriteMessages(std::vector<EncodeJob>& messages, std::map<std::string, std::string>& variableWarnings);
+
     std::ofstream gribFile;
 };
 
@@ -28,6 +28,7 @@
 #include "fimex/GribCDMReader.h"
 #undef MIFI_IO_READER_SUPPRESS_DEPRECATED
 
+#include "fimex/ArrayPool.h"
 #include "fimex/CDM.h"
 #include "fimex/CDMException.h"
 #include "fimex/CDMReaderUtils.h"
@@ -1341,7 +1342,7 @@ DataPtr GribCDMReader::getDataSlice(const string& varName, const SliceBuilder& s
     const size_t maxXySize = maxSizes.at(0) * maxSizes.at(1);
 
     // storage for complete data
-    shared_array<double> doubleArray(new double[sliceSize]);
+    shared_array<double> doubleArray = make_pooled_array<double>(sliceSize);
     // prefill with missing values
 
     double missingValue = cdm_->getFillValue(varName);
@@ -1357,13 +1358,12 @@ DataPtr GribCDMReader::getDataSlice(const string& varName, const SliceBuilder& s
 
     // storage for one layer, required only if making xy-slice
     shared_array<double> full_data_array;
-    vector<size_t> orgSizes, orgSliceSize, newStart, newSizes;
+    vector<size_t> orgSizes, newStart, newSizes;
     if (xyslice) {
         LOG4FIMEX(logger, Logger::DEBUG, "need xy slicing");
-        full_data_array = shared_array<double>(new double[maxXySize]);
+        full_data_array = make_pooled_array<double>(maxXySize);
 
         orgSizes = {maxSizes.at(0), maxSizes.at(1)};
-        orgSliceSize = {1, maxSizes.at(0)};
         newStart = {dimStart.at(0), dimStart.at(1)};
         newSizes = {dimSizes.at(0), dimSizes.at(1)};
     }
@@ -1387,7 +1387,7 @@ DataPtr GribCDMReader::getDataSlice(const string& varName, const SliceBuilder& s
                 LOG4FIMEX(logger, Logger::WARN, "unexpected data size " << dataRead << ", setting to missingValue");
                 fill(data_out, data_out + xySliceSize, missingValue);
             } else if (xyslice) { // slicing on xy-data
-                recursiveCopyMultiDimData(&full_data_array[0], data_out, orgSizes, orgSliceSize, newStart, newSizes);
+                copyMultiDimData(&full_data_array[0], data_out, orgSizes, newStart, newSizes);
             }
         } else {
             LOG4FIMEX(logger, Logger::DEBUG,
@@ -107,6 +107,8 @@ public:
 
     CDMDataType getDataType() const override { return CDM_NAT; }
 
+    bool isArrayShared() const override { return !data_.unique(); }
+
 private:
     size_t size_;
     nat_a data_;
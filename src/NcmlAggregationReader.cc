@@ -32,9 +32,11 @@
 #include "fimex/FileUtils.h"
 #include "fimex/Logger.h"
 #include "fimex/NcmlCDMReader.h"
+#include "fimex/String2Type.h"
 #include "fimex/StringUtils.h"
 #include "fimex/Type2String.h"
 #include "fimex/XMLDoc.h"
+#include "fimex/XMLInputFile.h"
 #include "fimex/XMLInputString.h"
 
 #include <memory>
@@ -107,6 +109,20 @@ NcmlAggregationReader::NcmlAggregationReader(const XMLInput& ncml)
         }
 
         aggType_ = getXmlProp(nodes->nodeTab[0], "type");
+        // fimex extension: open scanned files only when needed, and at most maxOpenFiles at a time
+        const string maxOpenFiles = getXmlProp(nodes->nodeTab[0], "maxOpenFiles");
+        if (!maxOpenFiles.empty())
+            setMaxOpenReaders(string2type<size_t>(maxOpenFiles));
+        // fimex extension: remember the scanned files in a manifest, only changed files are opened then
+        string manifest = getXmlProp(nodes->nodeTab[0], "manifest");
+        if (!manifest.empty() && manifest[0] != '/' && dynamic_cast<const XMLInputFile*>(&ncml)) {
+            // a relative manifest is placed next to the ncml file
+            const string::size_type slash = ncml.id().find_last_of('/');
+            if (slash != string::npos)
+                manifest = ncml.id().substr(0, slash + 1) + manifest;
+        }
+        setManifest(manifest);
+        const bool lazy = !maxOpenFiles.empty() || !manifest.empty();
         // open reader by scan
         xmlXPathObject_p xpathObjScan = doc->getXPathObject("./nc:scan", nodes->nodeTab[0]);
         xmlNodeSetPtr nodesScan = xpathObjScan->nodesetval;
@@ -115,11 +131,12 @@ NcmlAggregationReader::NcmlAggregationReader(const XMLInput& ncml)
             string dir, type, config;
             getFileTypeConfig(getXmlProp(nodesScan->nodeTab[i], "location"), dir, type, config);
             string suffix = getXmlProp(nodesScan->nodeTab[i], "suffix");
-            std::string regExp;
+            FileMatcher matcher;
             if (!suffix.empty()) {
-                regExp = ".*" + regex_escape(suffix) + "$";
+                matcher = suffixMatcher(suffix);
             } else {
-                regExp = getXmlProp(nodesScan->nodeTab[i], "regExp"); // what type of regex is this?
+                const std::regex regExp(getXmlProp(nodesScan->nodeTab[i], "regExp")); // what type of regex is this?
+                matcher = [regExp](const std::string& name) { return std::regex_match(name, regExp); };
             }
             string subdirs = getXmlProp(nodesScan->nodeTab[i], "subdirs");
             int depth = -1; //negative depth == unlimited
@@ -127,9 +144,14 @@ NcmlAggregationReader::NcmlAggregationReader(const XMLInput& ncml)
                 depth = 0;
             }
             vector<string> files;
-            scanFiles(files, dir, depth, std::regex(regExp), true);
+            scanFiles(files, dir, depth, matcher, true);
             for (size_t i = 0; i < files.size(); ++i) {
                 LOG4FIMEX(logger, Logger::DEBUG, "scanned file: " << files.at(i));
+                if (lazy) {
+                    const string file = files.at(i);
+                    addLazyReader([type, file, config]() { return CDMFileReaderFactory::create(type, file, config); }, file);
+                    continue;
+                }
                 try {
                     addReader(CDMFileReaderFactory::create(type, files.at(i), config), files.at(i));
                 } catch (CDMException& ex) {
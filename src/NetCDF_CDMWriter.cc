@@ -38,8 +38,11 @@
 
 #include "NetCDF_Utils.h"
 
+#include <algorithm>
+#include <condition_variable>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <numeric>
 
 #include <libxml/tree.h>
@@ -88,6 +91,114 @@ int getNcVersion(int version, std::unique_ptr<XMLDoc>& doc)
     return retVal;
 }
 
+//! memory for slices read ahead of the slice being written, in bytes
+size_t getPrefetchMemory(std::unique_ptr<XMLDoc>& doc)
+{
+    size_t prefetchMB = 512;
+    if (doc) {
+        xmlXPathObject_p xpathObj = doc->getXPathObject("/cdm_ncwriter_config/default[@prefetchMemory]");
+        xmlNodeSetPtr nodes = xpathObj->nodesetval;
+        if (nodes->nodeNr) {
+            prefetchMB = string2type<size_t>(getXmlProp(nodes->nodeTab[0], "prefetchMemory"));
+        }
+    }
+    return prefetchMB * 1024 * 1024;
+}
+
+//! size of one slice along the unlimited dimension of all variables, in bytes
+size_t unLimSliceBytes(const CDM& cdm)
+{
+    size_t bytes = 0;
+    for (const CDMVariable& var : cdm.getVariables()) {
+        if (!cdm.hasUnlimitedDim(var))
+            continue;
+        size_t varBytes = createData(var.getDataType(), 0)->bytes_for_one();
+        for (const std::string& dimName : var.getShape()) {
+            const CDMDimension& dim = cdm.getDimension(dimName);
+            if (!dim.isUnlimited())
+                varBytes *= dim.getLength();
+        }
+        bytes += varBytes;
+    }
+    return bytes;
+}
+
+//! converted data of a variable, waiting to be written
+struct PendingWrite
+{
+    std::string varName;
+    int varId;
+    CDMDataType dataType;
+    std::vector<size_t> start;
+    std::vector<size_t> count;
+    DataPtr data;
+};
+
+void putPendingWrite(int ncId, const PendingWrite& pw)
+{
+    LOG4FIMEX(logger, Logger::DEBUG,
+              "writing variable " << pw.varName << "dimLen= " << pw.start.size() << " start=" << join(pw.start.begin(), pw.start.end())
+                                  << " count=" << join(pw.count.begin(), pw.count.end()));
+    OmpScopedLock ncLock(Nc::getMutex());
+    try {
+        ncPutValues(pw.data, ncId, pw.varId, cdmDataType2ncType(pw.dataType), pw.start.size(), pw.start.data(), pw.count.data());
+    } catch (std::exception& ex) {
+        OmpScopedUnlock ncUnlock(Nc::getMutex());
+        LOG4FIMEX(logger, Logger::ERROR, "exception " << ex.what() << " while writing variable " << pw.varName);
+    } catch (...) {
+        OmpScopedUnlock ncUnlock(Nc::getMutex());
+        LOG4FIMEX(logger, Logger::ERROR, "unknown exception while writing variable " << pw.varName);
+    }
+}
+
+/**
+ * Slices along the unlimited dimension are read in parallel, but written in
+ * order. A slice may be started when it is less than inFlight slices ahead of
+ * the slice currently written, and is written once all previous slices are done.
+ */
+class SliceOrder
+{
+public:
+    SliceOrder(long long first, long long inFlight)
+        : current_(first)
+        , inFlight_(inFlight)
+    {
+    }
+    //! wait until the slice may be read
+    void start(long long slice)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        changed_.wait(lock, [this, slice] { return slice < current_ + inFlight_; });
+    }
+    //! true if the slice is written now, it stays current until finish(slice)
+    bool isCurrent(long long slice)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return slice == current_;
+    }
+    //! wait until all previous slices are written
+    void waitCurrent(long long slice)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        changed_.wait(lock, [this, slice] { return slice == current_; });
+    }
+    //! the slice is written completely
+    void finish(long long slice)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            current_ = slice + 1;
+        }
+        changed_.notify_all();
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    long long current_;
+    const long long inFlight_;
+};
+
 int ncDimId(int ncId, const CDMDimension* unLimDim)
 {
     int unLimDimId = -1;
@@ -117,6 +228,7 @@ NetCDF_CDMWriter::NetCDF_CDMWriter(CDMReader_p reader, const std::string& output
         checkDoc(doc, configFile);
     }
     const int ncVersion = getNcVersion(version, doc);
+    prefetchMemory = getPrefetchMemory(doc);
     ncFile->filename = outputFile;
 #ifdef HAVE_MPI
     if (mifi_mpi_initialized() && (mifi_mpi_size > 1)) {
@@ -629,20 +741,34 @@ void NetCDF_CDMWriter::writeData(const NcVarIdMap& ncVarMap)
     // see http://www.unidata.ucar.edu/support/help/MailArchives/netcdf/msg10905.html
     // use unLimDimPos = -1 for variables without unlimited dimension
 
+    // slices are written in order, each variable as soon as it is read when the slice
+    // is the current one; the following slices are read and converted meanwhile and
+    // kept until their turn, as many slices as fit into prefetchMemory
+    const size_t sliceBytes = std::max(unLimSliceBytes(cdm), size_t(1));
+    const long long inFlight = static_cast<long long>(std::min<size_t>(prefetchMemory / sliceBytes, maxUnLim + 1)) + 1;
+    LOG4FIMEX(logger, Logger::DEBUG, "prefetching up to " << (inFlight - 1) << " slices of " << sliceBytes << " bytes");
+    SliceOrder order(-1, inFlight);
+    // the waits in SliceOrder require slices to be handed out in increasing order
 #ifdef _OPENMP
 #if defined(__GNUC__) && __GNUC__ >= 9
-#pragma omp parallel for default(none) shared(logger, cdmVars, ncVarMap, maxUnLim, unLimDimId)
+#pragma omp parallel for schedule(monotonic : dynamic, 1) default(none) shared(logger, cdmVars, ncVarMap, maxUnLim, unLimDimId, order)
+#elif _OPENMP >= 201511 && (!defined(__INTEL_COMPILER) || (__INTEL_COMPILER >= 1800))
+#pragma omp parallel for schedule(monotonic : dynamic, 1) default(none) shared(logger, cdmVars, ncVarMap, order)
 #elif !defined(__INTEL_COMPILER) || (__INTEL_COMPILER >= 1800)
-#pragma omp parallel for default(none) shared(logger, cdmVars, ncVarMap)
+// before OpenMP 4.5, dynamic schedules are monotonic
+#pragma omp parallel for schedule(dynamic, 1) default(none) shared(logger, cdmVars, ncVarMap, order)
 #endif // __INTEL_COMPILER
 #endif // _OPENMP
     for (long long unLimDimPos = -1; unLimDimPos < maxUnLim; ++unLimDimPos) {
+        order.start(unLimDimPos);
 #ifdef HAVE_MPI
         if (using_mpi) {
             if (sliceAlongUnlimited) { // MPI-slices along unlimited dimension
                 // only work on variables which belong to this mpi-process (modulo-base)
                 if ((unLimDimPos % mifi_mpi_size) != mifi_mpi_rank) {
                     LOG4FIMEX(logger, Logger::DEBUG, "processor " << mifi_mpi_rank << " skipping unLimDimPos " << unLimDimPos);
+                    order.waitCurrent(unLimDimPos);
+                    order.finish(unLimDimPos);
                     continue;
                 } else {
                     LOG4FIMEX(logger, Logger::DEBUG, "processor " << mifi_mpi_rank << " working on unLimDimPos " << unLimDimPos);
@@ -650,6 +776,7 @@ void NetCDF_CDMWriter::writeData(const NcVarIdMap& ncVarMap)
             }
         }
 #endif
+        std::vector<PendingWrite> pending; // read before the slice became current
         for (size_t vi = 0; vi < cdmVars.size(); ++vi) {
             const CDMVariable& cdmVar = cdmVars[vi];
             const std::string& varName = cdmVar.getName();
@@ -670,8 +797,8 @@ void NetCDF_CDMWriter::writeData(const NcVarIdMap& ncVarMap)
 #endif
             int n_dims;
             std::unique_ptr<int[]> dim_ids;
-            std::unique_ptr<size_t[]> count;
-            std::unique_ptr<size_t[]> start;
+            std::vector<size_t> count;
+            std::vector<size_t> start;
             int unLimDimIdx = -1;
             {
                 OmpScopedLock ncLock(Nc::getMutex());
@@ -681,8 +808,8 @@ void NetCDF_CDMWriter::writeData(const NcVarIdMap& ncVarMap)
                 dim_ids.reset(new int[n_dims]);
                 ncCheck(nc_inq_vardimid(ncFile->ncId, varId, dim_ids.get()));
 
-                start.reset(new size_t[n_dims]);
-                count.reset(new size_t[n_dims]);
+                start.resize(n_dims);
+                count.resize(n_dims);
                 for (int i = 0; i < n_dims; ++i) {
                     if (dim_ids[i] == unLimDimId)
                         unLimDimIdx = i;
@@ -712,7 +839,7 @@ void NetCDF_CDMWriter::writeData(const NcVarIdMap& ncVarMap)
                 // since we are using NC_NOFILL for nc3 format files = NC_FORMAT_CLASSIC(1) NC_FORMAT_64BIT(2))
                 if (with_unlim)
                     count[unLimDimIdx] = 1; // just one slice
-                size_t size = (n_dims > 0) ? std::accumulate(count.get(), count.get() + n_dims, 1, std::multiplies<size_t>()) : 1;
+                size_t size = std::accumulate(count.begin(), count.end(), size_t(1), std::multiplies<size_t>());
                 data = createData(cdmVar.getDataType(), size, cdm.getFillValue(varName));
             }
             if (data->size() > 0) {
@@ -720,26 +847,34 @@ void NetCDF_CDMWriter::writeData(const NcVarIdMap& ncVarMap)
                     count[unLimDimIdx] = 1;
                     start[unLimDimIdx] = unLimDimPos;
                 }
-                LOG4FIMEX(logger, Logger::DEBUG,
-                          "writing variable " << varName << "dimLen= " << n_dims << " start=" << join(&start[0], &start[0] + n_dims)
-                                              << " count=" << join(&count[0], &count[0] + n_dims));
-                OmpScopedLock ncLock(Nc::getMutex());
-                try {
-                    ncPutValues(data, ncFile->ncId, varId, cdmDataType2ncType(cdmVar.getDataType()), n_dims, start.get(), count.get());
-                } catch (std::exception& ex) {
-                    OmpScopedUnlock ncUnlock(Nc::getMutex());
-                    LOG4FIMEX(logger, Logger::ERROR, "exception " << ex.what() << " while writing variable " << varName);
-                } catch (...) {
-                    OmpScopedUnlock ncUnlock(Nc::getMutex());
-                    LOG4FIMEX(logger, Logger::ERROR, "unknown exception while writing variable " << varName);
+                PendingWrite pw;
+                pw.varName = varName;
+                pw.varId = varId;
+                pw.dataType = cdmVar.getDataType();
+                pw.start.swap(start);
+                pw.count.swap(count);
+                pw.data = data;
+                if (order.isCurrent(unLimDimPos)) {
+                    for (const PendingWrite& p : pending)
+                        putPendingWrite(ncFile->ncId, p);
+                    pending.clear();
+                    putPendingWrite(ncFile->ncId, pw);
+                } else {
+                    pending.push_back(pw);
                 }
             }
         }
+
+        order.waitCurrent(unLimDimPos);
+        for (const PendingWrite& p : pending)
+            putPendingWrite(ncFile->ncId, p);
+        pending.clear();
 #ifndef HAVE_MPI
         if (unLimDimPos >= 0) {
             NCMUTEX_LOCKED(ncCheck(nc_sync(ncFile->ncId))); // sync every 'time/unlimited' step (does not work with MPI)
         }
 #endif
+        order.finish(unLimDimPos);
     }
 }
 
@@ -25,45 +25,130 @@
 #define FIMEX_RECURSIVESLICECOPY_H
 
 #include <algorithm>
+#include <cstddef>
 #include <vector>
 
 namespace MetNoFimex {
 
 /**
- * recursively copy data by moving the newData and orgData pointers forward and copy the data at the current position
+ * Strides of a multi-dimensional slice after merging all dimensions which
+ * can be walked together.
+ *
+ * Dimensions of size 1 only add an offset; a dimension following a dimension which is
+ * taken completely is merged into it. What remains is an innermost run of `run`
+ * elements with distance `runStride` in the original array (1 if contiguous) and the
+ * outer dimensions `count[i]` with distance `stride[i]`, the fastest first.
+ */
+struct SliceCopyPlan
+{
+    size_t offset;
+    size_t run;
+    size_t runStride;
+    std::vector<size_t> count;
+    std::vector<size_t> stride;
+    bool empty;
+
+    /**
+     * @param orgDimSize the original dimensions, the first dim in the vector is the fastest moving (fortran like)
+     * @param newStart the start positions in the original data
+     * @param newSize the dimensions of the new data
+     */
+    SliceCopyPlan(const std::vector<size_t>& orgDimSize, const std::vector<size_t>& newStart, const std::vector<size_t>& newSize)
+        : offset(0)
+        , run(1)
+        , runStride(1)
+        , empty(false)
+    {
+        // collapsed dimensions: size in the slice, stride in the original, and whether they cover the original completely
+        std::vector<size_t> sizes, strides;
+        bool lastComplete = false;
+        size_t orgStride = 1;
+        for (size_t i = 0; i < orgDimSize.size(); ++i) {
+            if (newSize[i] == 0)
+                empty = true;
+            offset += newStart[i] * orgStride;
+            if (newSize[i] != 1) {
+                if (lastComplete && sizes.back() * strides.back() == orgStride) {
+                    // continues the previous dimension
+                    sizes.back() *= newSize[i];
+                } else {
+                    sizes.push_back(newSize[i]);
+                    strides.push_back(orgStride);
+                }
+                lastComplete = (newSize[i] == orgDimSize[i]);
+            }
+            orgStride *= orgDimSize[i];
+        }
+        if (!sizes.empty()) {
+            run = sizes.front();
+            runStride = strides.front();
+            count.assign(sizes.begin() + 1, sizes.end());
+            stride.assign(strides.begin() + 1, strides.end());
+        }
+    }
+};
+
+template <typename C>
+inline C* copySliceRun(const C* orgData, C* newData, size_t run, size_t runStride)
+{
+    if (runStride == 1)
+        return std::copy(orgData, orgData + run, newData);
+    // gather a narrow fastest dimension
+    for (size_t i = 0; i < run; ++i, orgData += runStride)
+        *newData++ = *orgData;
+    return newData;
+}
+
+/**
+ * copy a multi-dimensional slice of orgData to newData
  *
  * it's assumed that the first dim in the vector is the fastest moving (fortran like)
  *
- * @param orgData pointer to the current postion of the original array
- * @param newData pointer to the current position of the new array
+ * @param orgData the original array
+ * @param newData the new array, with space for the product of newSize
  * @param orgDimSize the original dimensions of orgData
- * @param orgSliceSize helper-array with orgSliceSize[0] = 1; orgSliceSize[n] = orgDimSize[n] * orgSliceSize[n-1]
- * @param newStart the start positions in the new data
+ * @param newStart the start positions in the original data
  * @param newSize the dimensions of the newData
- * @param currentDim the dimension currently under work, should be between (orgData.size()-1) and 0
- *
  */
 template <typename C>
-void recursiveCopyMultiDimData(const C** orgData, C** newData, const std::vector<size_t>& orgDimSize, const std::vector<size_t>& orgSliceSize,
-                               const std::vector<size_t>& newStart, const std::vector<size_t>& newSize, size_t currentDim)
+void copyMultiDimData(const C* orgData, C* newData, const std::vector<size_t>& orgDimSize, const std::vector<size_t>& newStart,
+                      const std::vector<size_t>& newSize)
 {
-    (*orgData) += newStart[currentDim] * orgSliceSize[currentDim];
-    if (currentDim == 0) {
-        *newData = std::copy(&(*orgData)[0], &(*orgData)[newSize[0]], *newData);
-        (*orgData) += newSize[0]; // forward orgData pointer
+    const SliceCopyPlan plan(orgDimSize, newStart, newSize);
+    if (plan.empty)
+        return;
+    orgData += plan.offset;
+
+    const size_t rank = plan.count.size();
+    if (rank == 0) {
+        copySliceRun(orgData, newData, plan.run, plan.runStride);
+    } else if (rank == 1) {
+        for (size_t j = 0; j < plan.count[0]; ++j)
+            newData = copySliceRun(orgData + j * plan.stride[0], newData, plan.run, plan.runStride);
+    } else if (rank == 2) {
+        for (size_t k = 0; k < plan.count[1]; ++k) {
+            const C* org = orgData + k * plan.stride[1];
+            for (size_t j = 0; j < plan.count[0]; ++j)
+                newData = copySliceRun(org + j * plan.stride[0], newData, plan.run, plan.runStride);
+        }
     } else {
-        for (size_t i = 0; i < newSize[currentDim]; i++) {
-            recursiveCopyMultiDimData(orgData, newData, orgDimSize, orgSliceSize, newStart, newSize, currentDim - 1);
+        // walk the outer dimensions like an odometer
+        std::vector<size_t> pos(rank, 0);
+        const C* org = orgData;
+        while (true) {
+            newData = copySliceRun(org, newData, plan.run, plan.runStride);
+            size_t d = 0;
+            for (; d < rank; ++d) {
+                org += plan.stride[d];
+                if (++pos[d] < plan.count[d])
+                    break;
+                org -= pos[d] * plan.stride[d];
+                pos[d] = 0;
+            }
+            if (d == rank)
+                break;
         }
     }
-    (*orgData) += (orgDimSize[currentDim] - (newStart[currentDim] + newSize[currentDim])) * orgSliceSize[currentDim];
-}
-
-template <typename C>
-void recursiveCopyMultiDimData(const C* orgData, C* newData, const std::vector<size_t>& orgDimSize, const std::vector<size_t>& orgSliceSize,
-                               const std::vector<size_t>& newStart, const std::vector<size_t>& newSize)
-{
-    recursiveCopyMultiDimData(&orgData, &newData, orgDimSize, orgSliceSize, newStart, newSize, orgDimSize.size() - 1);
 }
 
 } // namespace MetNoFimex
@@ -103,6 +103,8 @@ public:
 
     CDMDataType getDataType() const override { return CDM_STRING; }
 
+    bool isArrayShared() const override { return false; }
+
 private:
     std::string text_;
 };
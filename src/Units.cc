@@ -27,7 +27,9 @@
 #include "fimex/UnitsConverter.h"
 #include "fimex/UnitsException.h"
 
+#include <atomic>
 #include <memory>
+#include <unordered_map>
 
 #include "MutexLock.h"
 #include "fimex_config.h"
@@ -48,6 +50,7 @@ namespace MetNoFimex
 {
 #ifdef HAVE_UDUNITS2_H
 static ut_system* utSystem;
+static std::atomic<bool> utSystemLoaded(false);
 #endif
 
 static OmpMutex unitsMutex;
@@ -56,6 +59,30 @@ extern OmpMutex& getUnitsMutex()
     return unitsMutex;
 }
 
+namespace {
+
+typedef std::pair<std::string, std::string> ConverterKey;
+
+struct ConverterKeyHash
+{
+    std::size_t operator()(const ConverterKey& k) const
+    {
+        const std::hash<std::string> h;
+        return h(k.first) * 31 + h(k.second);
+    }
+};
+
+typedef std::unordered_map<ConverterKey, UnitsConverter_p, ConverterKeyHash> ConverterCache;
+
+/**
+ * process-wide cache of converters, guarded by its own mutex so that
+ * lookups don't need the udunits-mutex
+ */
+ConverterCache converterCache;
+OmpMutex converterCacheMutex;
+
+} // namespace
+
 static Logger_p logger = getLogger("fimex.Units");
 
 void handleUdUnitError(int unitErrCode, const std::string& message)
@@ -125,8 +152,14 @@ public:
 #ifdef HAVE_UDUNITS2_H
 class Ud2UnitsConverter : public UnitsConverter {
     cv_converter* conv_;
+    bool linear_;
+
 public:
-    Ud2UnitsConverter(cv_converter* conv) : conv_(conv) {}
+    Ud2UnitsConverter(cv_converter* conv)
+        : conv_(conv)
+    {
+        linear_ = probeLinear();
+    }
     ~Ud2UnitsConverter() { cv_free(conv_); }
     double convert(double from) override
     {
@@ -146,7 +179,27 @@ public:
         }
         return retval;
     }
-    bool isLinear() override
+    bool isLinear() override { return linear_; }
+    void getScaleOffset(double& scale, double& offset) override
+    {
+        if (!linear_)
+            throw UnitException("cannot get scale and offset of non-linear function");
+        offset = convert(0.0);
+        scale = convert(1.) - offset;
+        // make sure, scale is determined at a place where offset is no longer numerically superior
+        if (scale != 0 && offset != 0) {
+            double temp = -offset/scale;
+            //std::cerr << temp << " offset:" << offset << " scale: " << scale <<  std::endl;
+            double scale2 = (convert(temp)-offset)/temp;
+            if (fabs(scale - scale2) < 1e-3) {
+                // should only increase precision, not nan/inf or other cases
+                scale = scale2;
+            }
+        }
+    }
+
+private:
+    bool probeLinear()
     {
         // check some points
         double offset = convert(0.0);
@@ -169,33 +222,22 @@ public:
 
         return true;
     }
-    void getScaleOffset(double& scale, double& offset) override
-    {
-        if (! isLinear()) throw UnitException("cannot get scale and offset of non-linear function");
-        offset = convert(0.0);
-        scale = convert(1.) - offset;
-        // make sure, scale is determined at a place where offset is no longer numerically superior
-        if (scale != 0 && offset != 0) {
-            double temp = -offset/scale;
-            //std::cerr << temp << " offset:" << offset << " scale: " << scale <<  std::endl;
-            double scale2 = (convert(temp)-offset)/temp;
-            if (fabs(scale - scale2) < 1e-3) {
-                // should only increase precision, not nan/inf or other cases
-                scale = scale2;
-            }
-        }
-    }
 };
 #endif
 
 Units::Units()
 {
+#ifdef HAVE_UDUNITS2_H
+    if (utSystemLoaded.load(std::memory_order_acquire))
+        return;
+#endif
     OmpScopedLock lock(unitsMutex);
 #ifdef HAVE_UDUNITS2_H
     if (utSystem == 0) {
         ut_set_error_message_handler(&ut_ignore);
         utSystem = ut_read_xml(0);
         handleUdUnitError(ut_get_status());
+        utSystemLoaded.store(true, std::memory_order_release);
     }
 #else
     if (!utIsInit()) {
@@ -219,9 +261,15 @@ bool Units::unload(bool force)
 {
     bool retVal = false;
     if (force) {
+        {
+            OmpScopedLock cacheLock(converterCacheMutex);
+            converterCache.clear();
+        }
         OmpScopedLock lock(unitsMutex);
 #ifdef HAVE_UDUNITS2_H
+        utSystemLoaded.store(false, std::memory_order_release);
         ut_free_system(utSystem);
+        utSystem = 0;
 #else
         utTerm();
 #endif
@@ -241,20 +289,48 @@ void Units::convert(const std::string& from, const std::string& to, double& slop
 
 UnitsConverter_p Units::getConverter(const std::string& from, const std::string& to)
 {
-    LOG4FIMEX(logger, Logger::DEBUG, "getConverter from '" << from << "' to '" << to << "'");
+    const ConverterKey key(from, to);
+    {
+        OmpScopedLock lock(converterCacheMutex);
+        ConverterCache::const_iterator it = converterCache.find(key);
+        if (it != converterCache.end())
+            return it->second;
+    }
+
+    UnitsConverter_p conv = createConverter(from, to);
+
+    OmpScopedLock lock(converterCacheMutex);
+    // another thread might have been faster, keep the first converter
+    return converterCache.insert(std::make_pair(key, conv)).first->second;
+}
+
+UnitsConverter_p Units::createConverter(const std::string& from, const std::string& to)
+{
+    LOG4FIMEX(logger, Logger::DEBUG, "createConverter from '" << from << "' to '" << to << "'");
     if (from == to) {
         return std::make_shared<LinearUnitsConverter>(1., 0.);
     }
-    OmpScopedLock lock(unitsMutex);
 #ifdef HAVE_UDUNITS2_H
-    std::shared_ptr<ut_unit> fromUnit(ut_parse(utSystem, from.c_str(), UT_UTF8), ut_free);
-    handleUdUnitError(ut_get_status(), "'" + from + "'");
-    std::shared_ptr<ut_unit> toUnit(ut_parse(utSystem, to.c_str(), UT_UTF8), ut_free);
-    handleUdUnitError(ut_get_status(), "'" + to + "'");
-    cv_converter* conv = ut_get_converter(fromUnit.get(), toUnit.get());
-    handleUdUnitError(ut_get_status(), "'" + from + "' converted to '" +to + "'");
-    return std::make_shared<Ud2UnitsConverter>(conv);
+    std::shared_ptr<Ud2UnitsConverter> udConv;
+    {
+        OmpScopedLock lock(unitsMutex);
+        std::shared_ptr<ut_unit> fromUnit(ut_parse(utSystem, from.c_str(), UT_UTF8), ut_free);
+        handleUdUnitError(ut_get_status(), "'" + from + "'");
+        std::shared_ptr<ut_unit> toUnit(ut_parse(utSystem, to.c_str(), UT_UTF8), ut_free);
+        handleUdUnitError(ut_get_status(), "'" + to + "'");
+        cv_converter* conv = ut_get_converter(fromUnit.get(), toUnit.get());
+        handleUdUnitError(ut_get_status(), "'" + from + "' converted to '" + to + "'");
+        udConv = std::make_shared<Ud2UnitsConverter>(conv);
+    }
+    if (udConv->isLinear()) {
+        // avoid the critical section of the udunits converter in the data path
+        double slope, offset;
+        udConv->getScaleOffset(slope, offset);
+        return std::make_shared<LinearUnitsConverter>(slope, offset);
+    }
+    return udConv;
 #else
+    OmpScopedLock lock(unitsMutex);
     double slope, offset;
     utUnit fromUnit, toUnit;
     handleUdUnitError(utScan(from.c_str(), &fromUnit), from);
@@ -262,7 +338,6 @@ UnitsConverter_p Units::getConverter(const std::string& from, const std::string&
     handleUdUnitError(utConvert(&fromUnit, &toUnit, &slope, &offset));
     return std::make_shared<LinearUnitsConverter>(slope, offset);
 #endif
-
 }
 
 bool Units::areConvertible(const std::string& unit1, const std::string& unit2) const
@@ -21,6 +21,7 @@
  * USA.
  */
 
+#include "fimex/ArrayPool.h"
 #include "fimex/CDM.h"
 #include "fimex/CDMException.h"
 #include "fimex/CDMExtractor.h"
@@ -32,6 +33,7 @@
 #include "fimex/CDMQualityExtractor.h"
 #include "fimex/CDMReader.h"
 #include "fimex/CDMReaderUtils.h"
+#include "fimex/CDMSliceCache.h"
 #include "fimex/CDMTimeInterpolator.h"
 #include "fimex/CDMVerticalInterpolator.h"
 #include "fimex/CDMconstants.h"
@@ -56,9 +58,11 @@
 
 #include <mi_programoptions.h>
 
+#include <algorithm>
 #include <cctype>
 #include <fstream>
 #include <iostream>
+#include <iterator>
 #include <memory>
 #include <numeric>
 #include <regex>
@@ -91,6 +95,11 @@ const po::option op_input_optional = po::option("input.optional", "additional op
 const po::option op_input_printNcML = po::option("input.printNcML", "print NcML description of input").set_implicit_value("-");
 const po::option op_input_printCS = po::option("input.printCS", "print CoordinateSystems of input file").set_narg(0);
 const po::option op_input_printSize = po::option("input.printSize", "print size estimate").set_narg(0);
+const po::option op_cache_maxMemory = po::option("cache.maxMemory", "keep recently read input slices in memory, size in bytes with optional K, M or G suffix, e.g. 2G");
+const po::option op_cache_after =
+    po::option("cache.after", "stages after which slices are cached (each with cache.maxMemory): input (default), process, qualityExtract, extract, "
+                              "timeInterpolate, interpolate, verticalInterpolate, merge, qualityExtract2")
+        .set_composing();
 const po::option op_output_file = po::option("output.file", "output file");
 const po::option op_output_fillFile = po::option("output.fillFile", "existing output file to be filled");
 const po::option op_output_type = po::option("output.type", "filetype of output file, e.g. nc, nc4, grib1, grib2");
@@ -172,6 +181,8 @@ const po::option op_interpolate_latitudeValues = po::option("interpolate.latitud
 const po::option op_interpolate_longitudeValues = po::option("interpolate.longitudeValues",
         "longitude values, in degrees east, of a list of points to interpolate to, e.g. -10.5,-10.5,29.5"
         " (use with 'latitudeValues' -- to produce a grid, use 'projString', 'xAxisValues', 'yAxisValues', ...)");
+const po::option op_interpolate_pointTileSize = po::option("interpolate.pointTileSize",
+        "size of the input tiles for grouping the points from 'latitudeValues'/'longitudeValues', default 0 reads one box around all points");
 const po::option op_interpolate_vcrossNames = po::option("interpolate.vcrossNames", "string with comma-separated names for vertical cross sections");
 const po::option op_interpolate_vcrossNoPoints = po::option("interpolate.vcrossNoPoints", "string with comma-separated number of lat/lon values for each vertical cross sections");
 const po::option op_interpolate_template = po::option("interpolate.template", "netcdf file containing lat/lon list used in interpolation");
@@ -236,6 +247,7 @@ void writeUsage(ostream& out, const po::option_set& config)
     out << "             [--input.optional OPT1 --input.optional OPT2 ...]" << endl;
     out << "             [--num_threads ...]" << endl;
     out << "             [--process....]" << endl;
+    out << "             [--cache.maxMemory SIZE [--cache.after STAGE ...]]" << endl;
     out << "             [--qualityExtract....]" << endl;
     out << "             [--extract....]" << endl;
     out << "             [--interpolate....]" << endl;
@@ -704,6 +716,9 @@ CDMInterpolator_p createCDMInterpolator(const po::value_set& vm, CDMReader_p dat
     if (getOption(op_interpolate_postprocess, vm, value)) {
         interpolator->addPostprocess(parseProcess(value, "postprocess"));
     }
+    if (getOption(op_interpolate_pointTileSize, vm, value)) {
+        interpolator->setPointTileSize(string2type<size_t>(value));
+    }
     return interpolator;
 }
 
@@ -793,6 +808,54 @@ CDMReader_p getCDMInterpolator(const po::value_set& vm, CDMReader_p dataReader)
     return interpolator;
 }
 
+size_t parseMemorySize(const string& size)
+{
+    std::smatch what;
+    if (!std::regex_match(size, what, std::regex("\\s*(\\d+)\\s*([kKmMgG]?)[bB]?\\s*")))
+        throw CDMException("cannot parse memory size '" + size + "'");
+    size_t bytes = string2type<size_t>(what[1].str());
+    switch (what[2].str().empty() ? 0 : tolower(what[2].str()[0])) {
+    case 'g':
+        bytes *= 1024;
+    // fall through
+    case 'm':
+        bytes *= 1024;
+    // fall through
+    case 'k':
+        bytes *= 1024;
+    }
+    return bytes;
+}
+
+const char* const cacheStages[] = {"input", "process", "qualityExtract", "extract", "timeInterpolate", "interpolate", "verticalInterpolate", "merge", "qualityExtract2"};
+
+CDMReader_p getCDMSliceCache(const string& stage, const po::value_set& vm, CDMReader_p dataReader)
+{
+    string maxMemory;
+    if (!getOption(op_cache_maxMemory, vm, maxMemory))
+        return dataReader;
+    vector<string> after;
+    if (!getOptions(op_cache_after, vm, after))
+        after.push_back("input");
+    for (const string& a : after) {
+        if (std::find(std::begin(cacheStages), std::end(cacheStages), a) == std::end(cacheStages)) {
+            LOG4FIMEX(logger, Logger::FATAL, "invalid cache.after: " << a);
+            exit(1);
+        }
+    }
+    if (std::find(after.begin(), after.end(), stage) == after.end())
+        return dataReader;
+    size_t bytes;
+    try {
+        bytes = parseMemorySize(maxMemory);
+    } catch (CDMException& ex) {
+        LOG4FIMEX(logger, Logger::FATAL, "invalid cache.maxMemory: " << ex.what());
+        exit(1);
+    }
+    LOG4FIMEX(logger, Logger::DEBUG, "caching " << stage << " slices in up to " << bytes << " bytes");
+    return std::make_shared<CDMSliceCache>(dataReader, bytes);
+}
+
 CDMReader_p getNcmlCDMReader(const po::value_set& vm, CDMReader_p dataReader)
 {
     const string config = getConfig("ncml", vm);
@@ -851,14 +914,23 @@ CDMReader_p getCDMMerger(const po::value_set& vm, CDMReader_p dataReader)
 
 CDMReader_p applyFimexStreamTasks(const po::value_set& vm, CDMReader_p dataReader)
 {
+    dataReader = getCDMSliceCache("input", vm, dataReader);
     dataReader = getCDMProcessor(vm, dataReader);
+    dataReader = getCDMSliceCache("process", vm, dataReader);
     dataReader = getCDMQualityExtractor("", vm, dataReader);
+    dataReader = getCDMSliceCache("qualityExtract", vm, dataReader);
     dataReader = getCDMExtractor(vm, dataReader);
+    dataReader = getCDMSliceCache("extract", vm, dataReader);
     dataReader = getCDMTimeInterpolator(vm, dataReader);
+    dataReader = getCDMSliceCache("timeInterpolate", vm, dataReader);
     dataReader = getCDMInterpolator(vm, dataReader);
+    dataReader = getCDMSliceCache("interpolate", vm, dataReader);
     dataReader = getCDMVerticalInterpolator(vm, dataReader);
+    dataReader = getCDMSliceCache("verticalInterpolate", vm, dataReader);
     dataReader = getCDMMerger(vm, dataReader);
+    dataReader = getCDMSliceCache("merge", vm, dataReader);
     dataReader = getCDMQualityExtractor("2", vm, dataReader);
+    dataReader = getCDMSliceCache("qualityExtract2", vm, dataReader);
     dataReader = getNcmlCDMReader(vm, dataReader);
     return dataReader;
 }
@@ -907,6 +979,8 @@ int run(int argc, char* args[])
         << op_input_printNcML
         << op_input_printCS
         << op_input_printSize
+        << op_cache_maxMemory
+        << op_cache_after
         << op_output_file
         << op_output_fillFile
         << op_output_type
@@ -969,6 +1043,7 @@ int run(int argc, char* args[])
         << op_interpolate_postprocess
         << op_interpolate_latitudeValues
         << op_interpolate_longitudeValues
+        << op_interpolate_pointTileSize
         << op_interpolate_vcrossNames
         << op_interpolate_vcrossNoPoints
         << op_interpolate_template
@@ -1096,6 +1171,10 @@ int run(int argc, char* args[])
     fillWriteCDM(dataReader, vm);
     writeCDM(dataReader, vm);
 
+    const ArrayPool& pool = ArrayPool::instance();
+    LOG4FIMEX(logger, Logger::DEBUG, "array memory: peak " << (pool.getPeakBytes() / 1024 / 1024) << "MB, live " << (pool.getLiveBytes() / 1024 / 1024)
+                                                             << "MB, pooled " << (pool.getPooledBytes() / 1024 / 1024) << "MB");
+
     return 0;
 }
 
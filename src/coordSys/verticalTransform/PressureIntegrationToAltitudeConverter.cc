@@ -40,8 +40,13 @@
 #include "fimex/Logger.h"
 #include "fimex/vertical_coordinate_transformations.h"
 #include "fimex/ArrayLoop.h"
+#include "fimex/SliceBuilder.h"
 
+#include "MutexLock.h"
+
+#include <algorithm>
 #include <cassert>
+#include <map>
 #include <memory>
 
 namespace MetNoFimex {
@@ -91,6 +96,7 @@ PressureIntegrationToAltitudeConverter::PressureIntegrationToAltitudeConverter(C
     , specific_humidity_(specific_humidity)
     , surface_air_pressure_(surface_air_pressure)
     , surface_geopotential_(surface_geopotential)
+    , cache_(std::make_shared<Cache>())
 {
     LOG4FIMEX(logger, Logger::INFO, "using hypsometric equation with surface pressure '"
             << surface_air_pressure_ << "', surface geopotential '" << surface_geopotential_
@@ -111,15 +117,82 @@ std::vector<std::string> PressureIntegrationToAltitudeConverter::getShape() cons
             .shape();
 }
 
+namespace {
+
+//! key for caching data by slice
+std::vector<size_t> sliceKey(const SliceBuilder& sb)
+{
+    std::vector<size_t> key(sb.getDimensionStartPositions());
+    const std::vector<size_t>& sizes = sb.getDimensionSizes();
+    key.insert(key.end(), sizes.begin(), sizes.end());
+    return key;
+}
+
+// maximum number of cached surface geopotential slices
+const size_t MAX_CACHED_SURFACE_GEOPOTENTIAL = 64;
+
+// number of columns integrated together
+const size_t COLUMN_BLOCK = 256;
+
+} // namespace
+
+struct PressureIntegrationToAltitudeConverter::Cache
+{
+    Cache()
+        : pressureDirection(0)
+    {
+    }
+
+    OmpMutex mutex;
+
+    //! 0 if unknown, 1 if pressure is highest at start of vertical axis, -1 if at end
+    int pressureDirection;
+
+    //! surface geopotential does not change in time
+    std::map<std::vector<size_t>, std::shared_ptr<VarFloat>> surfaceGeopotential;
+
+    //! altitude of the last requested slice, reused for all variables of the same time step
+    std::vector<size_t> altitudeKey;
+    DataPtr altitude;
+};
+
+std::shared_ptr<VarFloat> PressureIntegrationToAltitudeConverter::getSurfaceGeopotential(const SliceBuilder& sb) const
+{
+    const std::vector<size_t> key = sliceKey(adaptSliceBuilder(reader_->getCDM(), surface_geopotential_, sb));
+    {
+        OmpScopedLock lock(cache_->mutex);
+        const auto it = cache_->surfaceGeopotential.find(key);
+        if (it != cache_->surfaceGeopotential.end())
+            return it->second;
+    }
+
+    std::shared_ptr<VarFloat> sgp = std::make_shared<VarFloat>(reader_, surface_geopotential_, "m^2/s^2", sb);
+    if (!sgp->data)
+        return sgp; // do not cache failures
+
+    OmpScopedLock lock(cache_->mutex);
+    if (cache_->surfaceGeopotential.size() >= MAX_CACHED_SURFACE_GEOPOTENTIAL)
+        cache_->surfaceGeopotential.clear();
+    cache_->surfaceGeopotential[key] = sgp;
+    return sgp;
+}
+
 DataPtr PressureIntegrationToAltitudeConverter::getDataSlice(const SliceBuilder& sbOut) const
 {
     // we always need the whole pressure column below! -- difficult to integrate otherwise
     // 1) find vertical axis and its length
-    // 2) read one full pressure column from pressure_ to find out if pressure is highest at start or end of vertical axis
+    // 2) find out if pressure is highest at start or end of vertical axis, reading one full pressure column if not known yet
     // 3) extend start or end of vertical dim in sb -> sbC; print a WARN about efficiency
     // 4) integrate from surface to end of requested range
     // 5) only store if inside requested range
 
+    const std::vector<size_t> outKey = sliceKey(sbOut);
+    {
+        OmpScopedLock lock(cache_->mutex);
+        if (cache_->altitude && cache_->altitudeKey == outKey)
+            return cache_->altitude->clone();
+    }
+
     const CDM& rcdm = reader_->getCDM();
     // 1)
     const std::string& zName = rcdm.getVariable(cs_->getGeoZAxis()->getName()).getShape().front();
@@ -130,14 +203,20 @@ DataPtr PressureIntegrationToAltitudeConverter::getDataSlice(const SliceBuilder&
 
     // TODO part of the following is only necessary if the request is for a part of the vertical axis
 
-    // 2) TODO this can be cached
-    SliceBuilder sbPressure = adaptSliceBuilder(rcdm, pressure_, sbOut);
-    sbPressure.setAll(zName);
-    VarFloat pressure(reader_, pressure_, sbPressure);
-    const size_t dZPressure = pressure.dims.delta(zName);
-
-    bool start_high_p;
+    // 2) the direction is the same for all slices of this coordinate system
+    int pressureDirection;
     {
+        OmpScopedLock lock(cache_->mutex);
+        pressureDirection = cache_->pressureDirection;
+    }
+    std::unique_ptr<VarFloat> pressureColumn;
+    if (pressureDirection == 0) {
+        SliceBuilder sbPressure = adaptSliceBuilder(rcdm, pressure_, sbOut);
+        sbPressure.setAll(zName);
+        pressureColumn.reset(new VarFloat(reader_, pressure_, sbPressure));
+        const VarFloat& pressure = *pressureColumn;
+        const size_t dZPressure = pressure.dims.delta(zName);
+
         ArrayDims dimsP = pressure.dims;
         ArrayGroup groupP;
         groupP.add(dimsP);
@@ -145,58 +224,67 @@ DataPtr PressureIntegrationToAltitudeConverter::getDataSlice(const SliceBuilder&
         groupP.minimizeShared(0);
         LOG4FIMEX(logger, Logger::DEBUG, "groupP rank=" << groupP.rank());
         Loop loopP(groupP);
-        bool have_p_direction = false;
         do {
             const float p_first = pressure.values[loopP[0]];
             const float p_last = pressure.values[loopP[0] + (n_z-1)*dZPressure];
             LOG4FIMEX(logger, Logger::DEBUG, "p_first=" << p_first << " p_last=" << p_last);
-            if (p_first > 0 && p_last > 0) {
-                start_high_p = (p_first > p_last);
-                have_p_direction = true;
-            }
-
-        } while (!have_p_direction && loopP.next());
-        if (!have_p_direction) {
+            if (p_first > 0 && p_last > 0)
+                pressureDirection = (p_first > p_last) ? 1 : -1;
+        } while (pressureDirection == 0 && loopP.next());
+        if (pressureDirection == 0) {
             LOG4FIMEX(logger, Logger::ERROR, "unable to determine pressure axis direction, probably all points are undefined, giving up");
             return DataPtr();
         }
+        OmpScopedLock lock(cache_->mutex);
+        cache_->pressureDirection = pressureDirection;
     }
+    const bool start_high_p = (pressureDirection > 0);
 
     // 3)
-    int iz_step, iz_p_in_0, iz_in_0, iz_out_0;
+    int iz_step, iz_in_0, iz_out_0;
     size_t sb_z_begin, sb_z_size;
     if (start_high_p) {
         sb_z_begin = 0;
         sb_z_size = sb_out_z_end - sb_z_begin;
         iz_step = 1;               // increasing l => increasing altitude
-        iz_p_in_0 = iz_in_0 = 0;   // start on surface
+        iz_in_0 = 0;               // start on surface
         iz_out_0 = -sb_out_z_start;
     } else {
         sb_z_begin = sb_out_z_start;
         sb_z_size = n_z - sb_z_begin;
         iz_step = -1;              // decreasing l => increasing altitude
-        iz_p_in_0 = n_z - 1;       // start on surface
-        iz_in_0 = iz_out_0 = sb_z_size - 1;
+        iz_in_0 = iz_out_0 = sb_z_size - 1; // start on surface
     }
     SliceBuilder sb = sbOut;
     sb.setStartAndSize(zName, sb_z_begin, sb_z_size);
 
+    // the full pressure column from 2) starts at 0, otherwise read only the integration range
+    std::unique_ptr<VarFloat> pressureRange;
+    size_t iz_p_offset = 0;
+    if (pressureColumn) {
+        iz_p_offset = sb_z_begin;
+    } else {
+        pressureRange.reset(new VarFloat(reader_, pressure_, sb));
+    }
+    const VarFloat& pressure = pressureColumn ? *pressureColumn : *pressureRange;
+
     VarFloat sap(reader_, surface_air_pressure_, "hPa", sb);
-    VarFloat sgp(reader_, surface_geopotential_, "m^2/s^2", sb);
+    const std::shared_ptr<VarFloat> sgp = getSurfaceGeopotential(sb);
     VarFloat airt(reader_, air_temperature_, "K", sb);
 
-    if (!sap.data || !sgp.data || !airt.data || !pressure.data) {
+    if (!sap.data || !sgp->data || !airt.data || !pressure.data) {
         LOG4FIMEX(logger, Logger::INFO, "hypsometric no data");
         return DataPtr();
     }
 
+    ArrayDims siSap = sap.dims, siSgp = sgp->dims, siAirT = airt.dims, siPressure = pressure.dims;
     ArrayDims soAltitude = makeArrayDims(sbOut);
 
-    set_not_shared(zName, sap.dims, sgp.dims, airt.dims, pressure.dims, soAltitude);
+    set_not_shared(zName, siSap, siSgp, siAirT, siPressure, soAltitude);
 
     enum { IN_SAP, IN_SGP, IN_AIRT, IN_PRESSURE, OUT_ALTITUDE, IN_SHUM };
     ArrayGroup group;
-    group.add(sap.dims).add(sgp.dims).add(airt.dims).add(pressure.dims).add(soAltitude);
+    group.add(siSap).add(siSgp).add(siAirT).add(siPressure).add(soAltitude);
 
     ArrayDims siSHum;
     shared_array<float> shVal;
@@ -210,41 +298,75 @@ DataPtr PressureIntegrationToAltitudeConverter::getDataSlice(const SliceBuilder&
         }
     }
 
-    group.minimizeShared(0); // FIXME do not treat each value separately
+    group.minimizeShared(0);
 
-    const size_t dZAirT = airt.dims.delta(zName);
+    const size_t dZPressure = pressure.dims.delta(zName), dZAirT = airt.dims.delta(zName);
     const size_t dZSHum = siSHum.delta(zName), dZAlti = soAltitude.delta(zName);
 
+    // collect the offsets of all columns once, the integration runs level by level over blocks of columns
+    std::vector<size_t> oSap, oSgp, oAirT, oPressure, oAltitude, oSHum;
+    {
+        Loop loop(group);
+        do { // sharedVolume() == 1 because we called minimizeShared before
+            oSap.push_back(loop[IN_SAP]);
+            oSgp.push_back(loop[IN_SGP]);
+            oAirT.push_back(loop[IN_AIRT]);
+            oPressure.push_back(loop[IN_PRESSURE]);
+            oAltitude.push_back(loop[OUT_ALTITUDE]);
+            if (shVal)
+                oSHum.push_back(loop[IN_SHUM]);
+        } while (loop.next());
+    }
+    const size_t n_columns = oAltitude.size();
+
     const size_t size = soAltitude.volume();
     shared_array<double> altiVal(new double[size]);
 
     // 4)
-#if 0 && defined(_OPENMP)
-#pragma omp parallel default(shared)
+    const long n_blocks = (n_columns + COLUMN_BLOCK - 1) / COLUMN_BLOCK;
+#ifdef _OPENMP
+#pragma omp parallel for default(shared)
 #endif
-    Loop loop(group);
-    do { // sharedVolume() == 1 because we called minimizeShared before
-        double a = sgp.values[loop[IN_SGP]] / MIFI_EARTH_GRAVITY;
-        float p_low_alti = sap.values[loop[IN_SAP]];
-        int iz_p_in = iz_p_in_0, iz_in = iz_in_0, iz_out = iz_out_0;
-        for (size_t i = 0; i < sb_z_size; i += 1, iz_p_in += iz_step, iz_in += iz_step, iz_out += iz_step) {
-            const float p_high_alti = pressure.values[loop[IN_PRESSURE] + iz_p_in * dZPressure];
-
-            float Tv = airt.values[loop[IN_AIRT] + iz_in*dZAirT];
+    for (long b = 0; b < n_blocks; ++b) {
+        const size_t k0 = b * COLUMN_BLOCK;
+        const size_t nk = std::min(COLUMN_BLOCK, n_columns - k0);
+        double a[COLUMN_BLOCK];
+        float p_low_alti[COLUMN_BLOCK], p_high_alti[COLUMN_BLOCK], Tv[COLUMN_BLOCK];
+        for (size_t k = 0; k < nk; ++k) {
+            a[k] = sgp->values[oSgp[k0 + k]] / MIFI_EARTH_GRAVITY;
+            p_low_alti[k] = sap.values[oSap[k0 + k]];
+        }
+        int iz_in = iz_in_0, iz_out = iz_out_0;
+        for (size_t i = 0; i < sb_z_size; i += 1, iz_in += iz_step, iz_out += iz_step) {
+            const size_t offP = (iz_p_offset + iz_in) * dZPressure, offT = iz_in * dZAirT;
+            for (size_t k = 0; k < nk; ++k) {
+                p_high_alti[k] = pressure.values[oPressure[k0 + k] + offP];
+                Tv[k] = airt.values[oAirT[k0 + k] + offT];
+            }
             if (shVal) {
-                Tv = mifi_virtual_temperature(shVal[loop[IN_SHUM] + iz_in*dZSHum], Tv);
+                const size_t offSH = iz_in * dZSHum;
+                for (size_t k = 0; k < nk; ++k)
+                    Tv[k] = mifi_virtual_temperature(shVal[oSHum[k0 + k] + offSH], Tv[k]);
             }
 
-            const double lt = mifi_barometric_layer_thickness(p_low_alti, p_high_alti, Tv);
-            a += lt;
-            // 5)
-            if (iz_out >= 0 && iz_out < (int)sb_out_z_size)
-                altiVal[loop[OUT_ALTITUDE] + iz_out*dZAlti] = a;
+            mifi_barometric_layer_altitude(nk, p_low_alti, p_high_alti, Tv, a);
 
-            p_low_alti = p_high_alti;
+            // 5)
+            if (iz_out >= 0 && iz_out < (int)sb_out_z_size) {
+                const size_t offA = iz_out * dZAlti;
+                for (size_t k = 0; k < nk; ++k)
+                    altiVal[oAltitude[k0 + k] + offA] = a[k];
+            }
         }
-    } while (loop.next());
-    return createData(size, altiVal);
+    }
+
+    DataPtr altitude = createData(size, altiVal);
+    {
+        OmpScopedLock lock(cache_->mutex);
+        cache_->altitudeKey = outKey;
+        cache_->altitude = altitude;
+    }
+    return altitude->clone();
 }
 
 } // namespace MetNoFimex
@@ -1,9 +1,34 @@
 #include "fimex/coordSys/verticalTransform/ToVLevelConverter.h"
 
+#include <limits>
+
 namespace MetNoFimex {
 
 ToVLevelConverter ::~ToVLevelConverter()
 {
 }
 
+void ToVLevelConverter::getTile(size_t x0, size_t nx, size_t y0, size_t ny, size_t t, ToVLevelTile& tile)
+{
+    tile.x0 = x0;
+    tile.nx = nx;
+    tile.y0 = y0;
+    tile.ny = ny;
+    tile.t = t;
+    tile.nz = 0;
+    tile.values.clear();
+    for (size_t y = y0; y < y0 + ny; ++y) {
+        for (size_t x = x0; x < x0 + nx; ++x) {
+            const std::vector<double> column = operator()(x, y, t);
+            if (tile.values.empty()) {
+                tile.nz = column.size();
+                tile.values.reserve(nx * ny * tile.nz);
+            }
+            tile.values.insert(tile.values.end(), column.begin(), column.end());
+        }
+    }
+    tile.validityMin.assign(nx * ny, -std::numeric_limits<double>::infinity());
+    tile.validityMax.assign(nx * ny, std::numeric_limits<double>::infinity());
+}
+
 } // namespace MetNoFimex
@@ -30,7 +30,9 @@
 
 #include "fimex/coordSys/verticalTransform/ToVLevelConverterAdapter.h"
 
+#include "fimex/ArrayLoop.h"
 #include "fimex/CDM.h"
+#include "fimex/CDMException.h"
 #include "fimex/CDMReader.h"
 #include "fimex/coordSys/CoordinateSystem.h"
 #include "fimex/coordSys/verticalTransform/VerticalConverter.h"
@@ -39,6 +41,9 @@
 #include "fimex/Logger.h"
 #include "fimex/SliceBuilder.h"
 
+#include <algorithm>
+#include <limits>
+
 namespace MetNoFimex {
 
 using std::vector;
@@ -47,9 +52,13 @@ static Logger_p logger = getLogger("fimex.ToVLevelConverterAdapter");
 
 static const size_t NOTSET = ~0ul;
 
+const size_t ToVLevelConverterAdapter::TILE_SIZE;
+
 ToVLevelConverterAdapter::ToVLevelConverterAdapter(CDMReader_p reader, CoordinateSystem_cp cs, VerticalConverter_p converter, size_t unLimDimPos)
     : reader_(reader)
     , converter_(converter)
+    , sizeX_(1)
+    , sizeY_(1)
     , unlimitedTimePos_(NOTSET)
 {
     const std::vector<std::string>& shape = converter_->getShape();
@@ -57,14 +66,18 @@ ToVLevelConverterAdapter::ToVLevelConverterAdapter(CDMReader_p reader, Coordinat
 
     if (CoordinateAxis_cp xax = cs->getGeoXAxis()) {
         const std::string& xdim0 = xax->getShape().front();
-        if (shapedims.count(xdim0))
+        if (shapedims.count(xdim0)) {
             varGeoX_ = xdim0;
+            sizeX_ = reader_->getCDM().getDimension(xdim0).getLength();
+        }
     }
 
     if (CoordinateAxis_cp yax = cs->getGeoYAxis()) {
         const std::string& ydim0 = yax->getShape().front();
-        if (shapedims.count(ydim0))
+        if (shapedims.count(ydim0)) {
             varGeoY_ = ydim0;
+            sizeY_ = reader_->getCDM().getDimension(ydim0).getLength();
+        }
     }
 
     if (CoordinateAxis_cp tax = cs->getTimeAxis()) {
@@ -79,40 +92,177 @@ ToVLevelConverterAdapter::ToVLevelConverterAdapter(CDMReader_p reader, Coordinat
     }
 }
 
+void ToVLevelConverterAdapter::normalize(size_t& x, size_t& y, size_t& t) const
+{
+    // dimensions not in the converter shape do not change the column
+    if (varGeoX_.empty())
+        x = 0;
+    if (varGeoY_.empty())
+        y = 0;
+    if (varTime_.empty())
+        t = 0;
+    else if (unlimitedTimePos_ != NOTSET)
+        t = unlimitedTimePos_;
+}
+
+std::shared_ptr<const ToVLevelTile> ToVLevelConverterAdapter::tileFor(size_t x, size_t y, size_t t)
+{
+    normalize(x, y, t);
+    {
+        std::lock_guard<std::mutex> lock(tileMutex_);
+        if (tile_ && tile_->contains(x, y, t))
+            return tile_;
+    }
+    // read without the lock, other threads keep using their tile meanwhile
+    const size_t x0 = x - x % TILE_SIZE, y0 = y - y % TILE_SIZE;
+    const size_t nx = (x0 < sizeX_) ? std::min(TILE_SIZE, sizeX_ - x0) : 1;
+    const size_t ny = (y0 < sizeY_) ? std::min(TILE_SIZE, sizeY_ - y0) : 1;
+    std::shared_ptr<ToVLevelTile> tile = std::make_shared<ToVLevelTile>();
+    getTile(x0, nx, y0, ny, t, *tile);
+    std::lock_guard<std::mutex> lock(tileMutex_);
+    tile_ = tile;
+    return tile_;
+}
+
 vector<double> ToVLevelConverterAdapter::operator()(size_t x, size_t y, size_t t)
 {
-    const SliceBuilder sb = prepareSliceBuilder(x, y, t);
+    const std::shared_ptr<const ToVLevelTile> tile = tileFor(x, y, t);
+    normalize(x, y, t);
+    const double* column = tile->column(x, y);
+    return vector<double>(column, column + tile->nz);
+}
+
+bool ToVLevelConverterAdapter::isValid(double val, size_t x, size_t y, size_t t)
+{
+    const std::shared_ptr<const ToVLevelTile> tile = tileFor(x, y, t);
+    normalize(x, y, t);
+    const size_t c = tile->columnIndex(x, y);
+    return (val <= tile->validityMax[c] && val >= tile->validityMin[c]);
+}
+
+void ToVLevelConverterAdapter::getTile(size_t x0, size_t nx, size_t y0, size_t ny, size_t t, ToVLevelTile& tile)
+{
+    size_t xn = x0, yn = y0, tn = t;
+    normalize(xn, yn, tn);
+
+    const SliceBuilder sb = prepareSliceBuilder(x0, nx, y0, ny, tn);
+    const ArrayDims dims = makeArrayDims(sb);
+    const size_t dx = dims.delta(varGeoX_), dy = dims.delta(varGeoY_);
+
+    // all other dimensions but time must be the vertical
+    size_t nz = 1, dz = 0;
+    for (size_t i = 0; i < dims.rank(); ++i) {
+        const std::string& dim = dims.dim_name(i);
+        if (dim == varGeoX_ || dim == varGeoY_ || dim == varTime_ || dims.length(i) == 1)
+            continue;
+        if (nz != 1)
+            throw CDMException("vertical converter with more than one vertical dimension");
+        nz = dims.length(i);
+        dz = dims.delta(i);
+    }
 
     DataPtr data = converter_->getDataSlice(sb);
-    shared_array<double> array = data->asDouble();
-    return vector<double>(&array[0], &array[0] + data->size());
+    if (!data)
+        throw CDMException("no data from vertical converter");
+    if (data->size() != dims.volume()) {
+        if (nx * ny != 1) {
+            LOG4FIMEX(logger, Logger::DEBUG, "vertical converter data do not match slice shape, reading tile column by column");
+            getTileByColumn(x0, nx, y0, ny, t, tile);
+            return;
+        }
+        // single column, use whatever the converter returns
+        nz = data->size();
+        dz = 1;
+    }
+    const shared_array<double> array = data->asDouble();
+
+    tile.x0 = x0;
+    tile.nx = nx;
+    tile.y0 = y0;
+    tile.ny = ny;
+    tile.t = t;
+    tile.nz = nz;
+    tile.values.resize(nx * ny * nz);
+    double* out = &tile.values[0];
+    for (size_t y = 0; y < ny; ++y) {
+        for (size_t x = 0; x < nx; ++x) {
+            const double* in = &array[x * dx + y * dy];
+            for (size_t z = 0; z < nz; ++z)
+                *out++ = in[z * dz];
+        }
+    }
+
+    const double inf = std::numeric_limits<double>::infinity();
+    tile.validityMin = readValidity(converter_->getValidityMin(sb), converter_->getValidityMinShape(), sb, nx, ny, -inf);
+    tile.validityMax = readValidity(converter_->getValidityMax(sb), converter_->getValidityMaxShape(), sb, nx, ny, inf);
 }
 
-bool ToVLevelConverterAdapter::isValid(double val, size_t x, size_t y, size_t t)
+void ToVLevelConverterAdapter::getTileByColumn(size_t x0, size_t nx, size_t y0, size_t ny, size_t t, ToVLevelTile& tile)
 {
-    const SliceBuilder sb = prepareSliceBuilder(x, y, t);
+    tile.x0 = x0;
+    tile.nx = nx;
+    tile.y0 = y0;
+    tile.ny = ny;
+    tile.t = t;
+    tile.values.clear();
+    tile.validityMin.clear();
+    tile.validityMax.clear();
+    ToVLevelTile column;
+    for (size_t y = y0; y < y0 + ny; ++y) {
+        for (size_t x = x0; x < x0 + nx; ++x) {
+            getTile(x, 1, y, 1, t, column);
+            tile.nz = column.nz;
+            tile.values.insert(tile.values.end(), column.values.begin(), column.values.end());
+            tile.validityMin.push_back(column.validityMin[0]);
+            tile.validityMax.push_back(column.validityMax[0]);
+        }
+    }
+}
+
+vector<double> ToVLevelConverterAdapter::readValidity(DataPtr data, const vector<std::string>& shape, const SliceBuilder& sb, size_t nx, size_t ny,
+                                                      double unbounded) const
+{
+    if (!data || data->size() == 0)
+        return vector<double>(nx * ny, unbounded);
 
-    DataPtr dataMax = converter_->getValidityMax(sb);
-    DataPtr dataMin = converter_->getValidityMin(sb);
-    return ((!dataMax || val <= dataMax->getDouble(0)) && (!dataMin || val >= dataMin->getDouble(0)));
+    const shared_array<double> array = data->asDouble();
+    if (data->size() == 1)
+        return vector<double>(nx * ny, array[0]);
+
+    // validity data have their own shape, sized like the slice where dimensions are shared
+    const std::vector<std::string> sbDims = sb.getDimensionNames();
+    const size_v& sbSizes = sb.getDimensionSizes();
+    size_v lengths = getDimSizes(reader_->getCDM(), shape);
+    for (size_t i = 0; i < shape.size(); ++i) {
+        const std::vector<std::string>::const_iterator it = std::find(sbDims.begin(), sbDims.end(), shape[i]);
+        if (it != sbDims.end())
+            lengths[i] = sbSizes[it - sbDims.begin()];
+    }
+    const ArrayDims dims(shape, lengths);
+    if (dims.volume() != data->size())
+        throw CDMException("unexpected size of vertical converter validity data");
+
+    const size_t dx = dims.delta(varGeoX_), dy = dims.delta(varGeoY_);
+    vector<double> validity(nx * ny);
+    for (size_t y = 0; y < ny; ++y)
+        for (size_t x = 0; x < nx; ++x)
+            validity[y * nx + x] = array[x * dx + y * dy];
+    return validity;
 }
 
-SliceBuilder ToVLevelConverterAdapter::prepareSliceBuilder(size_t x, size_t y, size_t t) const
+SliceBuilder ToVLevelConverterAdapter::prepareSliceBuilder(size_t x0, size_t nx, size_t y0, size_t ny, size_t t) const
 {
     LOG4FIMEX(logger, Logger::DEBUG, "prepareSliceBuilder: about to create slicebuilder");
     SliceBuilder sb = createSliceBuilder(reader_->getCDM(), converter_);
 
     if (!varGeoX_.empty())
-        sb.setStartAndSize(varGeoX_, x, 1);
+        sb.setStartAndSize(varGeoX_, x0, nx);
 
     if (!varGeoY_.empty())
-        sb.setStartAndSize(varGeoY_, y, 1);
+        sb.setStartAndSize(varGeoY_, y0, ny);
 
-    if (!varTime_.empty()) {
-        if (unlimitedTimePos_ != NOTSET)
-            t = unlimitedTimePos_;
+    if (!varTime_.empty())
         sb.setStartAndSize(varTime_, t, 1);
-    }
     return sb;
 }
 
@@ -45,11 +45,10 @@ FeltField::FeltField(const FeltFile & ff, size_t index)
 //		throw out_of_range("Felt file does not have enough entries.");
 
 	FeltFile::size_type blockNo = (index / (blockWords/16)) + offsetToContentDefinition;
-	FeltFile::Block b = feltFile_.getBlock_(blockNo);
-
 	FeltFile::size_type indexInBlock = (index % (blockWords/16)) * 16;
 
-	copy(b.get() + indexInBlock, b.get() + indexInBlock + 16, header_.begin());
+	// only the 16 words of this field, not the whole index block
+	feltFile_.read_(header_.data(), blockNo * blockWords + indexInBlock, 16);
 }
 
 
@@ -80,15 +79,20 @@ int FeltField::parameter() const
 
 
 FeltGridDefinitionPtr FeltField::projectionInformation() const
+{
+	std::call_once(projectionRead_, &FeltField::readProjection_, this);
+	return projection_;
+}
+
+void FeltField::readProjection_() const
 {
 	const std::vector<short>& extraGeometrySpec = getExtraGeometrySpecification_();
 	int gType = gridType();
 	if ( gType > 999 )
 		gType /= 1000;
-        FeltGridDefinitionPtr ret = std::make_shared<FeltGridDefinition>(
+        projection_ = std::make_shared<FeltGridDefinition>(
             gType, xNum(), yNum(), static_cast<short int>(getGridHeader_()[14]), static_cast<short int>(getGridHeader_()[15]),
             static_cast<short int>(getGridHeader_()[16]), static_cast<short int>(getGridHeader_()[17]), extraGeometrySpec);
-        return ret;
 }
 
 
@@ -193,20 +197,24 @@ int FeltField::level2() const
 
 void FeltField::grid(std::vector<word> & out) const
 {
-    // read header together with data, unless read before
-    getGridHeader_();
-	size_t from = (startingGridBlock() * blockWords) + 20;
-    //offset
-     if (header_[6] > 1) {
-         from += header_[6] - 1;
-     }
-
-	size_t size = gridSize();
-	feltFile_.get_(out, from, size);
-	// read footer together with data, unless read before
-	getExtraGeometrySpecification_();
+	feltFile_.get_(out, gridHeaderPosition_() + 20, gridSize());
 }
 
+const word* FeltField::gridData(std::vector<word>& buffer) const
+{
+	return gridData(buffer, 0, gridSize());
+}
+
+const word* FeltField::gridData(std::vector<word>& buffer, size_t offset, size_t size) const
+{
+	if (offset + size > gridSize())
+		throw std::out_of_range("requested data outside felt grid");
+	const size_t from = gridHeaderPosition_() + 20 + offset;
+	if (const word* mapped = feltFile_.mapped_(from, size))
+		return mapped;
+	feltFile_.get_(buffer, from, size);
+	return buffer.empty() ? 0 : &buffer[0];
+}
 
 size_t FeltField::startingGridBlock() const
 {
@@ -245,43 +253,38 @@ int FeltField::dataVersion() const
 }
 
 
-const std::vector<word> & FeltField::getGridHeader_() const
+size_t FeltField::gridHeaderPosition_() const
 {
-	if ( gridHeader_.empty() )
-	{
-		size_t startingBlock = startingGridBlock();
-		size_t readFrom = startingBlock * blockWords;
+	size_t pos = startingGridBlock() * blockWords;
+	//offset
+	if (header_[6] > 1) {
+		pos += header_[6] - 1;
+	}
+	return pos;
+}
 
-		//offset
-		if (header_[6] > 1) {
-		    readFrom += header_[6] - 1;
-		}
+void FeltField::readGridInfo_() const
+{
+	const size_t from = gridHeaderPosition_();
+	feltFile_.get_(gridHeader_, from, 20);
 
-		feltFile_.get_(gridHeader_, readFrom, 20);
+	int gt = gridType();
+	if ( gt > 1000 ) { // Otherwise no extra spec
+		size_t readSize = gt % 1000; // last three digits is size of appended data
+		feltFile_.get_(extraGridSpec_, from + 20 + gridSize(), readSize);
 	}
+}
+
+const std::vector<word> & FeltField::getGridHeader_() const
+{
+	std::call_once(gridInfoRead_, &FeltField::readGridInfo_, this);
 	return gridHeader_;
 }
 
 const std::vector<short int>& FeltField::getExtraGeometrySpecification_() const
 {
-    if ( extraGridSpec_.empty() )
-    {
-        int gt = gridType();
-        if ( gt > 1000 ) { // Otherwise no extra spec
-            size_t readSize = gt % 1000; // last three digits is size of appended data
-            extraGridSpec_.resize(readSize);
-
-            size_t readFrom = (startingGridBlock() * blockWords) + gridSize() + 20;
-            //offset
-            if (header_[6] > 1) {
-                readFrom += header_[6] - 1;
-            }
-
-            feltFile_.get_(extraGridSpec_, readFrom, readSize);
-        }
-    }
-    return extraGridSpec_;
+	std::call_once(gridInfoRead_, &FeltField::readGridInfo_, this);
+	return extraGridSpec_;
 }
 
-
 }
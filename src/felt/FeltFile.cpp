@@ -31,22 +31,59 @@
 #include "felt/FeltField.h"
 
 #include <algorithm>
+#include <cstring>
 #include <fstream>
 #include <mutex>
 #include <sstream>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 using namespace std;
 
 namespace felt
 {
 
+namespace
+{
+/**
+ * Map a whole file read-only.
+ * @return the mapping, or 0 if the file cannot be mapped
+ */
+const char* mapFile(const std::string& file, size_t& size)
+{
+    size = 0;
+    const int fd = open(file.c_str(), O_RDONLY);
+    if (fd < 0)
+        return 0;
+    const char* mapping = 0;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void* m = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (m != MAP_FAILED) {
+            mapping = static_cast<const char*>(m);
+            size = st.st_size;
+        }
+    }
+    close(fd); // the mapping stays valid
+    return mapping;
+}
+} // namespace
+
 FeltFile::FeltFile(const std::string& file)
     : fileName_(file)
     , changeEndianness_(false)
-    , feltFile_(new std::ifstream(file, std::ios::binary))
+    , mapping_(0)
+    , mappingSize_(0)
 {
-    word head;
-    feltFile_->read(reinterpret_cast<char*>(& head), sizeof(word));
+    mapping_ = mapFile(file, mappingSize_);
+    if (!mapping_)
+        feltFile_.reset(new std::ifstream(file, std::ios::binary));
+
+    word head = 0;
+    read_(&head, 0, 1); // byte order is determined from the raw word
     if ( head < 997 or 999 < head )
         changeEndianness_ = true;
 
@@ -69,6 +106,8 @@ FeltFile::FeltFile(const std::string& file)
 
 FeltFile::~FeltFile()
 {
+    if (mapping_)
+        munmap(const_cast<char*>(mapping_), mappingSize_);
 }
 
 // simple logging
@@ -186,27 +225,49 @@ void swapByteOrder(word & w)
 FeltFile::Block FeltFile::getBlock_(size_type blockNo) const
 {
     Block ret(new word[blockWords]);
-
-    long long pos = static_cast<long long>(blockNo) * blockWords * sizeof(word);
-    feltFile_->seekg(pos, ios_base::beg);
-    feltFile_->read((char*) ret.get(), blockWords * sizeof(word));
-    if ( changeEndianness_ )
-        for_each(ret.get(), ret.get() + blockWords, swapByteOrder);
-
+    read_(ret.get(), static_cast<size_type>(blockNo) * blockWords, blockWords);
     return ret;
 }
 
 void FeltFile::get_(std::vector<word> & out, size_type fromWord, size_type noOfWords) const
 {
     out.resize(noOfWords);
+    if (noOfWords > 0)
+        read_(&out[0], fromWord, noOfWords);
+}
+
+void FeltFile::read_(word* out, size_type fromWord, size_type noOfWords) const
+{
     // this will allow up to 8.4GB (size_t = 4.2G * word=2)
-    unsigned long long pos = static_cast<unsigned long long>(fromWord) * sizeof(word);
-    feltFile_->seekg(pos, ios_base::beg);
-    feltFile_->read((char*) & out[0], noOfWords * sizeof(word));
+    const unsigned long long pos = static_cast<unsigned long long>(fromWord) * sizeof(word);
+    const unsigned long long bytes = static_cast<unsigned long long>(noOfWords) * sizeof(word);
+    unsigned long long got = 0;
+    if (mapping_) {
+        if (pos < mappingSize_) {
+            got = std::min<unsigned long long>(bytes, mappingSize_ - pos);
+            std::memcpy(out, mapping_ + pos, got);
+        }
+    } else {
+        std::lock_guard<std::mutex> lock(streamMutex_);
+        feltFile_->clear();
+        feltFile_->seekg(pos, ios_base::beg);
+        feltFile_->read(reinterpret_cast<char*>(out), bytes);
+        got = feltFile_->gcount();
+    }
+    if (got < bytes)
+        std::memset(reinterpret_cast<char*>(out) + got, 0, bytes - got);
     if ( changeEndianness_ )
-        for_each(out.begin(), out.end(), swapByteOrder);
+        for_each(out, out + noOfWords, swapByteOrder);
 }
 
+const word* FeltFile::mapped_(size_type fromWord, size_type noOfWords) const
+{
+    const unsigned long long pos = static_cast<unsigned long long>(fromWord) * sizeof(word);
+    const unsigned long long bytes = static_cast<unsigned long long>(noOfWords) * sizeof(word);
+    if (!mapping_ || changeEndianness_ || pos + bytes > mappingSize_)
+        return 0;
+    return reinterpret_cast<const word*>(mapping_ + pos);
+}
 
 const FeltField & FeltFile::at(size_t idx) const
 {
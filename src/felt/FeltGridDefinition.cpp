@@ -32,6 +32,7 @@
 
 #include <cassert>
 #include <cmath>
+#include <mutex>
 #include <sstream>
 #include <stdexcept>
 
@@ -56,6 +57,9 @@ static_assert(sizeof(word) == 2, "unexpected sizeof(word)");
  */
 static void projConvert(const std::string& projStr, double lon, double lat, double& x, double& y)
 {
+    // the proj_api.h default context is shared, grid definitions may be created from several threads
+    static std::mutex projMutex;
+    std::lock_guard<std::mutex> lock(projMutex);
     projPJ outputPJ;
     if ( !(outputPJ = pj_init_plus(projStr.c_str())) ) {
         std::string errorMsg(pj_strerrno(pj_errno));
@@ -1640,37 +1640,55 @@ int mifi_griddistance(size_t nx, size_t ny, const double* lonVals, const double*
     return MIFI_OK;
 }
 
+int mifi_vertical_velocity_map_factors(size_t nx, size_t ny, double dx, double dy, const float* gridDistX, const float* gridDistY, double* mapFactors)
+{
+    const size_t n = nx*ny;
+    double* hx  = mapFactors;
+    double* hy  = mapFactors + n;
+    double* rhx = mapFactors + 2*n;
+    double* rhy = mapFactors + 3*n;
+    for (size_t ij = 0; ij < n; ij++) {
+        hx[ij] = gridDistX[ij] / dx;
+        hy[ij] = gridDistY[ij] / dy;
+        rhx[ij] = 1 / hx[ij];
+        rhy[ij] = 1 / hy[ij];
+    }
+    return MIFI_OK;
+}
+
 size_t mifi_compute_vertical_velocity(size_t nx, size_t ny, size_t nz, double dx, double dy, const float* gridDistX, const float* gridDistY, const double* ap, const double* b,
                           const float* zs, const float* ps, const float* u, const float* v, const float* t, float* w)
+{
+    double* mapFactors = (double*) malloc(4*nx*ny*sizeof(double));
+    if (mapFactors == NULL) {
+        fprintf(stderr, "memory allocation error in mifi_compute_vertical_verlocity\n");
+        return MIFI_ERROR;
+    }
+    mifi_vertical_velocity_map_factors(nx, ny, dx, dy, gridDistX, gridDistY, mapFactors);
+    size_t retVal = mifi_compute_vertical_velocity_mf(nx, ny, nz, dx, dy, mapFactors, ap, b, zs, ps, u, v, t, w);
+    free(mapFactors);
+    return retVal;
+}
+
+size_t mifi_compute_vertical_velocity_mf(size_t nx, size_t ny, size_t nz, double dx, double dy, const double* mapFactors, const double* ap, const double* b,
+                          const float* zs, const float* ps, const float* u, const float* v, const float* t, float* w)
 {
     const double R = MIFI_GAS_CONSTANT / MIFI_MOLAR_MASS_DRY_AIR;  // specific gas constant dry air
     const double g = MIFI_EARTH_GRAVITY; // gravity
+    const size_t nxy = nx*ny;
+
+    const double* mapRatioX = mapFactors; // this is hx in original code
+    const double* mapRatioY = mapFactors + nxy;
+    const double* rhx       = mapFactors + 2*nxy;
+    const double* rhy       = mapFactors + 3*nxy;
+
+    double* dp        = (double*) malloc(nxy*nz*sizeof(double));
+    double* dlnp      = (double*) malloc(nxy*nz*sizeof(double));
+    double* alfa      = (double*) malloc(nxy*nz*sizeof(double));
+    double* z         = (double*) malloc(nxy*nz*sizeof(double));
 
-    double* mapRatioX = (double*) malloc(nx*ny*sizeof(double));
-    double* mapRatioY = (double*) malloc(nx*ny*sizeof(double));
-    double* rhx       = (double*) malloc(nx*ny*sizeof(double));
-    double* rhy       = (double*) malloc(nx*ny*sizeof(double));
-    double* rhxy      = (double*) malloc(nx*ny*sizeof(double));
-    double* sum       = (double*) malloc(nx*ny*sizeof(double));
-    double* uu        = (double*) malloc(nx*ny*sizeof(double));
-    double* vv        = (double*) malloc(nx*ny*sizeof(double));
-    double* dp        = (double*) malloc(nx*ny*nz*sizeof(double));
-    double* dlnp      = (double*) malloc(nx*ny*nz*sizeof(double));
-    double* alfa      = (double*) malloc(nx*ny*nz*sizeof(double));
-    double* z         = (double*) malloc(nx*ny*nz*sizeof(double));
-
-    if (mapRatioX == NULL || mapRatioY == NULL || rhx == NULL || rhy == NULL ||
-            rhxy == NULL || sum == NULL || uu == NULL || vv == NULL || dp == NULL
-            || dlnp == NULL || alfa == NULL || z == NULL) {
+    if (dp == NULL || dlnp == NULL || alfa == NULL || z == NULL) {
         fprintf(stderr, "memory allocation error in mifi_compute_vertical_verlocity\n");
-        free(mapRatioX);
-        free(mapRatioY);
-        free(rhx);
-        free(rhy);
-        free(rhxy);
-        free(sum);
-        free(uu);
-        free(vv);
         free(dp);
         free(dlnp);
         free(alfa);
@@ -1678,21 +1696,8 @@ size_t mifi_compute_vertical_velocity(size_t nx, size_t ny, size_t nz, double dx
         return MIFI_ERROR;
     }
 
-    double rdx_2 = 1/(2*dx);
-    double rdy_2 = 1/(2*dy);
-
-    if (MIFI_DEBUG)
-        fprintf(stderr, "compute map-factors\n");
-    for (size_t j = 0; j < ny; j++) {
-        for (size_t i = 0; i < nx; i++) {
-            size_t ij = i+nx*j;
-            mapRatioX[ij] = gridDistX[ij] / dx; // this is hx in original code
-            mapRatioY[ij] = gridDistY[ij] / dy;
-            rhx[ij] = 1 / mapRatioX[ij];
-            rhy[ij] = 1 / mapRatioY[ij];
-            rhxy[ij] = rhx[ij] * rhy[ij];
-        }
-    }
+    const double rdx_2 = 1/(2*dx);
+    const double rdy_2 = 1/(2*dy);
 
     if (MIFI_DEBUG)
         fprintf(stderr, "compute half model levels");
@@ -1702,94 +1707,122 @@ size_t mifi_compute_vertical_velocity(size_t nx, size_t ny, size_t nz, double dx
     ah[nz] = 0.0;
     bh[nz] = 1.0;
 
-
     for (size_t k = nz-1; k > 0; --k) {
           ah[k] = 2.0*ap[k]-ah[k+1];
           bh[k] = 2.0*b[k] -bh[k+1];
     }
 
-
+    /* All 3d loops below run over rows of one level, with the contiguous
+     * x-direction innermost. Rows are independent within a level, and the
+     * vertical integrations only carry state along a column, so the rows
+     * are distributed over threads and the inner loops vectorise. */
     if (MIFI_DEBUG)
         fprintf(stderr, "compute pressure variables needed only once\n");
-    double ln2= log(2.);
-    double da=ah[1]-ah[0];
-    double db=bh[1]-bh[0];
-
-    for (size_t j = 0; j < ny; ++j) {
-        for (size_t i = 0; i < nx; ++i) {
-            size_t ij = i+nx*j;
-            dp[ij]   = da+db*ps[ij];
-            dlnp[ij] = 0.;
-            alfa[ij] = ln2;
-        }
-    }
-    for (size_t k = 1; k < nz; k++) {
-        if (MIFI_DEBUG)
-            fprintf(stderr, "k = %lu, ah = %f, bh= %f\n", k, ah[k], bh[k]);
-        for (size_t j = 0; j < ny; ++j) {
+    const double ln2 = log(2.);
+    const double da = ah[1]-ah[0];
+    const double db = bh[1]-bh[0];
+    const long nRows = (long) (ny*nz);
+#ifdef _OPENMP
+#pragma omp parallel for default(shared)
+#endif
+    for (long row = 0; row < nRows; ++row) {
+        const size_t k = row / ny, j = row % ny;
+        const size_t ij0 = nx*j, ijk0 = ij0 + nxy*k;
+        const float* psRow = ps + ij0;
+        double* dpRow = dp + ijk0;
+        double* dlnpRow = dlnp + ijk0;
+        double* alfaRow = alfa + ijk0;
+        if (k == 0) {
+            for (size_t i = 0; i < nx; ++i) {
+                dpRow[i]   = da+db*psRow[i];
+                dlnpRow[i] = 0.;
+                alfaRow[i] = ln2;
+            }
+        } else {
+            const double ahm = ah[k], bhm = bh[k], ahp = ah[k+1], bhp = bh[k+1];
             for (size_t i = 0; i < nx; ++i) {
-                size_t ij = i+j*nx, ijk = ij + nx*ny*k;
-                double pm = ah[k]   + bh[k]  *ps[ij];
-                double pp = ah[k+1] + bh[k+1]*ps[ij];
-                dp[ijk]   = pp - pm;
-                dlnp[ijk] = log(pp/pm);
-                alfa[ijk] = 1.-pm*dlnp[ijk]/dp[ijk];
+                double pm = ahm + bhm*psRow[i];
+                double pp = ahp + bhp*psRow[i];
+                dpRow[i]   = pp - pm;
+                dlnpRow[i] = log(pp/pm);
+                alfaRow[i] = 1.-pm*dlnpRow[i]/dpRow[i];
             }
         }
     }
-    if (MIFI_DEBUG)
-        fprintf(stderr, "k = %lu, ah = %f, bh= %f\n", nz, ah[nz], bh[nz]);
 
     if (MIFI_DEBUG)
         fprintf(stderr, "vertical integration of hydrostatic equation\n");
-    for (size_t j = 0; j < ny; j++) {
-        for (size_t i = 0; i < nx; i++) {
-            size_t ij = i+nx*j;
-            sum[ij] = zs[ij]*g;
-        }
-    }
-    for (int k = nz-1; k >= 0; k--) {
-        for (size_t j = 0; j < ny; j++) {
+#ifdef _OPENMP
+#pragma omp parallel default(shared)
+#endif
+    {
+        double sum[nx];
+#ifdef _OPENMP
+#pragma omp for
+#endif
+        for (long jl = 0; jl < (long) ny; ++jl) {
+            const size_t ij0 = nx*(size_t)jl;
             for (size_t i = 0; i < nx; i++) {
-                size_t ij = i+nx*j, ijk = ij + nx*ny*k;
-                double rt = R*t[ijk];
-                z[ijk] = sum[ij] + rt*alfa[ijk];
-                sum[ij] += rt*dlnp[ijk];
+                sum[i] = zs[ij0+i]*g;
+            }
+            for (int k = nz-1; k >= 0; k--) {
+                const size_t ijk0 = ij0 + nxy*k;
+                const float* tRow = t + ijk0;
+                const double* alfaRow = alfa + ijk0;
+                const double* dlnpRow = dlnp + ijk0;
+                double* zRow = z + ijk0;
+                for (size_t i = 0; i < nx; i++) {
+                    double rt = R*tRow[i];
+                    zRow[i] = sum[i] + rt*alfaRow[i];
+                    sum[i] += rt*dlnpRow[i];
+                }
             }
         }
     }
 
     if (MIFI_DEBUG)
         fprintf(stderr, "vertical integral of divergence, compute w\n");
-    for (size_t j = 0; j < ny; j++) {
-        for (size_t i = 0; i < nx; i++) {
-            size_t ij = i+nx*j;
-            sum[ij] = 0;
-            w[ij] = 0;
-        }
+    for (size_t ij = 0; ij < nxy; ij++) {
+        w[ij] = 0;
     }
-    for (size_t k = 1; k < nz; k++) {
-        for (size_t j = 0; j < ny; j++) {
-            for (size_t i = 0; i < nx; i++) {
-                size_t ij = i+nx*j, ijk = ij + nx*ny*k;
-                uu[ij] = mapRatioY[ij] * u[ijk]*dp[ijk];
-                vv[ij] = mapRatioX[ij] * v[ijk]*dp[ijk];
-            }
-        }
-        for (size_t j = 1; j < ny-1; j++) {
-            for (size_t i = 1; i < nx-1; i++) {
-                size_t ij = i+nx*j, ijk = ij + nx*ny*k;
-                double div = rhxy[ij]*(  rdx_2 * (uu[ij+1]  - uu[ij-1])
-                                       + rdy_2 * (vv[ij+nx] - vv[ij-nx]));
-                double w1 = R*t[ijk]
-                             * (dlnp[ijk]*sum[ij] + alfa[ijk]*div)
-                             / dp[ijk];
-                double w2 =   rhx[ij] * rdx_2 * (z[ijk+1]  - z[ijk-1])
-                            + rhy[ij] * rdy_2 * (z[ijk+nx] - z[ijk-nx]);
-                w[ijk] = (w1+w2) / g;
-                sum[ij] = sum[ij] + div;
+    if (ny > 2 && nx > 2) {
+#ifdef _OPENMP
+#pragma omp parallel default(shared)
+#endif
+        {
+            double sum[nx];
+#ifdef _OPENMP
+#pragma omp for
+#endif
+            for (long jl = 1; jl < (long) ny-1; jl++) {
+                const size_t j = (size_t) jl;
+                for (size_t i = 0; i < nx; i++) {
+                    sum[i] = 0;
+                }
+                for (size_t k = 1; k < nz; k++) {
+                    const size_t ij0 = nx*j, ijk0 = ij0 + nxy*k;
+                    for (size_t i = 1; i < nx-1; i++) {
+                        const size_t ij = ij0+i, ijk = ijk0+i;
+                        // uu = mapRatioY*u*dp, vv = mapRatioX*v*dp at the neighbours
+                        const double uuE = mapRatioY[ij+1]  * u[ijk+1]*dp[ijk+1];
+                        const double uuW = mapRatioY[ij-1]  * u[ijk-1]*dp[ijk-1];
+                        const double vvN = mapRatioX[ij+nx] * v[ijk+nx]*dp[ijk+nx];
+                        const double vvS = mapRatioX[ij-nx] * v[ijk-nx]*dp[ijk-nx];
+                        double div = (rhx[ij]*rhy[ij])*(  rdx_2 * (uuE - uuW)
+                                                        + rdy_2 * (vvN - vvS));
+                        double w1 = R*t[ijk]
+                                     * (dlnp[ijk]*sum[i] + alfa[ijk]*div)
+                                     / dp[ijk];
+                        double w2 =   rhx[ij] * rdx_2 * (z[ijk+1]  - z[ijk-1])
+                                    + rhy[ij] * rdy_2 * (z[ijk+nx] - z[ijk-nx]);
+                        w[ijk] = (w1+w2) / g;
+                        sum[i] = sum[i] + div;
+                    }
+                }
             }
         }
+    }
+    for (size_t k = 1; k < nz; k++) {
         for (size_t i = 1; i < nx-1; i++) {
             size_t i0k = i+nx*(0+ny*k), i1k = i0k + nx;
             size_t im1k = i+nx*(ny-1+ny*k), im2k = im1k - nx;
@@ -1803,14 +1836,6 @@ size_t mifi_compute_vertical_velocity(size_t nx, size_t ny, size_t nz, double dx
             w[jm1k] = w[jm2k];
         }
     }
-    free(mapRatioX);
-    free(mapRatioY);
-    free(rhx);
-    free(rhy);
-    free(rhxy);
-    free(sum);
-    free(uu);
-    free(vv);
     free(dp);
     free(dlnp);
     free(alfa);
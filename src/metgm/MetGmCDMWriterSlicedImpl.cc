@@ -38,8 +38,15 @@
 #include "MetGmFileHandlePtr.h"
 #include "MetGmConfigurationMappings.h"
 
+#include "fimex/Type2String.h"
+
+#include <algorithm>
 #include <cassert>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 namespace MetNoFimex {
     MetGmCDMWriterSlicedImpl::MetGmCDMWriterSlicedImpl
         (
@@ -121,13 +128,48 @@ namespace MetNoFimex {
             total_num_of_slices = profile.pTags_->tTag()->nT();
         }
 
-        for(size_t slice_index = 0; slice_index < total_num_of_slices; ++slice_index)
-        {
-            size_t cSlicePos = -1;
-            DataPtr raw_slice  = cdmReader->getScaledDataSliceInUnit(pVar->getName(), profile.units_, slice_index);
-            shared_array<float> slice_to_write = raw_slice->asFloat();
-            profile.pTags_->sliceToMetGmLayout(slice_to_write);
-            MGM_THROW_ON_ERROR(mgm_write_group5_slice(*metgmFileHandle_, *metgmHandle_, slice_to_write.get(), &cSlicePos));
+        /*
+         * slices are fetched and reordered into MetGm layout in batches,
+         * one slice per thread, each into its own part of group5Buffer_;
+         * the batch is then written in slice order, as the METGM C API
+         * is sequential
+         */
+        const size_t sliceSize = profile.pTags_->sliceDataSize();
+#ifdef _OPENMP
+        const size_t batchSize = std::min(static_cast<size_t>(std::max(omp_get_max_threads(), 1)), total_num_of_slices);
+#else
+        const size_t batchSize = 1;
+#endif
+        if (group5Buffer_.size() < batchSize * sliceSize)
+            group5Buffer_.resize(batchSize * sliceSize);
+        std::vector<std::string> errors(batchSize);
+
+        for (size_t batchStart = 0; batchStart < total_num_of_slices; batchStart += batchSize) {
+            const size_t batchEnd = std::min(batchStart + batchSize, total_num_of_slices);
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+            for (size_t slice_index = batchStart; slice_index < batchEnd; ++slice_index) {
+                const size_t bIdx = slice_index - batchStart;
+                try {
+                    DataPtr raw_slice = cdmReader->getScaledDataSliceInUnit(pVar->getName(), profile.units_, slice_index);
+                    if (raw_slice->size() != sliceSize)
+                        throw CDMException("unexpected slice size " + type2string(raw_slice->size()) + " for " + pVar->getName());
+                    const shared_array<float> slice = raw_slice->asFloat();
+                    profile.pTags_->sliceToMetGmLayout(slice.get(), &group5Buffer_[bIdx * sliceSize]);
+                } catch (std::exception& ex) {
+                    errors[bIdx] = ex.what();
+                }
+            }
+
+            for (size_t slice_index = batchStart; slice_index < batchEnd; ++slice_index) {
+                const size_t bIdx = slice_index - batchStart;
+                if (!errors[bIdx].empty())
+                    throw CDMException("reading slice " + type2string(slice_index) + " of " + pVar->getName() + ": " + errors[bIdx]);
+                size_t cSlicePos = -1;
+                MGM_THROW_ON_ERROR(mgm_write_group5_slice(*metgmFileHandle_, *metgmHandle_, &group5Buffer_[bIdx * sliceSize], &cSlicePos));
+            }
         }
     }
 }
@@ -28,6 +28,8 @@
 //
 #include "MetGmCDMWriterImpl.h"
 
+#include <vector>
+
 namespace MetNoFimex {
 
     class MetGmCDMWriterSlicedImpl : public MetGmCDMWriterImpl
@@ -47,6 +49,10 @@ namespace MetNoFimex {
 
         virtual void init();
         virtual void writeGroup5Data(const CDMVariable* pVar);
+
+    private:
+        // reordered group5 slices of the current batch, reused for all parameters
+        std::vector<float> group5Buffer_;
     };
 
 }
@@ -36,6 +36,7 @@
 #include "fimex/Units.h"
 
 // standard
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 
@@ -640,51 +641,34 @@ std::shared_ptr<MetGmGroup5Ptr> MetGmGroup5Ptr::createMetGmGroup5PtrForReading(c
             return;
 
         shared_array<float> dataT(new float[hdTag_->sliceSize()]);
+        sliceToMetGmLayout(slice.get(), dataT.get());
+        slice = dataT;
+    }
 
-        float* pos = slice.get();
-        float* posT = dataT.get();
-
-        size_t nz = hdTag_->zSize();
-        size_t ny = hdTag_->ySize();
-        size_t nx = hdTag_->xSize();
-
-        size_t Nxy  = nx * ny;
-        size_t Nzx  = nz * nx;
-
-        size_t xLeap  = -nx;
-        size_t zxLeap = -Nzx;
-
-        for(size_t y = 0; y < ny; ++y) {
-
-            xLeap += nx;
-            zxLeap += Nzx;
-
-            size_t zLeapF = -nz;
-
-            for(size_t x = 0; x < nx; ++x) {
-
-                zLeapF += nz;
-
-                size_t xyLeapF = -Nxy;
-                size_t xyLeapB = nz * Nxy;
-
-                size_t midz = nz / 2 + nz % 2;
-                for(size_t z = 0; z < midz; ++z) {
-
-                    xyLeapF += Nxy;
-                    xyLeapB -= Nxy;
-
-                    float valueFz = *(pos + x + xLeap + xyLeapF);
-                    *(posT + z + zLeapF + zxLeap) = valueFz;
-                    float valueBz = *(pos + x + xLeap + xyLeapB);
-                    *(posT + (nz - 1 - z) + zLeapF + zxLeap) = valueBz;
-                } // z
-
-            } // x
+    /*
+     * reindex data - one slice into a caller-provided buffer
+     * of sliceSize() floats, the input is not modified
+     *   Fimex      METGM
+     * (x, y, z) -> (z, x, y)
+     */
+    void MetGmGroup5Ptr::sliceToMetGmLayout(const float* slice, float* sliceT) const
+    {
+        if(hdTag_->asShort() !=  MetGmHDTag::HD_3D_T) {
+            std::copy(slice, slice + hdTag_->sliceSize(), sliceT);
+            return;
+        }
 
-        } // y
+        const size_t nz = hdTag_->zSize();
+        const size_t ny = hdTag_->ySize();
+        const size_t nx = hdTag_->xSize();
+        const size_t Nxy = nx * ny;
 
-        slice = dataT;
+        for(size_t xy = 0; xy < Nxy; ++xy) {
+            const float* pos = slice + xy;
+            float* posT = sliceT + xy * nz;
+            for(size_t z = 0; z < nz; ++z, pos += Nxy)
+                posT[z] = *pos;
+        }
     }
 
     void MetGmGroup5Ptr::dumpFimexLayout()
@@ -64,6 +64,7 @@ namespace MetNoFimex {
                                                                                     const std::shared_ptr<MetGmGroup3Ptr> gp3);
 
         void sliceToMetGmLayout(shared_array<float>& slice);
+        void sliceToMetGmLayout(const float* slice, float* sliceT) const;
 
         shared_array<float> readDataSlices(size_t pos, size_t numberOfSlices);
 
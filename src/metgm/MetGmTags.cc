@@ -138,6 +138,11 @@ std::shared_ptr<MetGmTags> MetGmTags::createMetGmTagsForWriting(const CDMReader_
         pGp5_->sliceToMetGmLayout(slice);
     }
 
+    void MetGmTags::sliceToMetGmLayout(const float* slice, float* sliceT) const
+    {
+        pGp5_->sliceToMetGmLayout(slice, sliceT);
+    }
+
     shared_array<float> MetGmTags::readDataSlices(size_t pos, size_t numberOfSlices)
     {
         return pGp5_->readDataSlices(pos, numberOfSlices);
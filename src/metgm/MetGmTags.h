@@ -96,6 +96,7 @@ namespace MetNoFimex {
         std::shared_ptr<MetGmTimeTag>& tTag();
 
         void sliceToMetGmLayout(shared_array<float>& slice);
+        void sliceToMetGmLayout(const float* slice, float* sliceT) const;
 
         shared_array<float> readDataSlices(size_t pos, size_t numberOfSlices);
 
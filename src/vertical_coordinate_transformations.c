@@ -156,6 +156,15 @@ float mifi_barometric_layer_thickness(float p_low_alti, float p_high_alti, float
     return log(p_low_alti / p_high_alti) * T * BAROMETRIC_FACTOR;
 }
 
+int mifi_barometric_layer_altitude(size_t n, float* p_low_alti, const float* p_high_alti, const float* T, double* altitude)
+{
+    while (n--) {
+        *altitude++ += log(*p_low_alti / *p_high_alti) * *T++ * BAROMETRIC_FACTOR;
+        *p_low_alti++ = *p_high_alti++;
+    }
+    return MIFI_OK;
+}
+
 int mifi_ocean_s_g1_z(size_t n, double h, double h_c, double zeta, const double* sigma, const double* C, double* z)
 {
     double h_inv = 1/h;
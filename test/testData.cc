@@ -22,9 +22,11 @@
  */
 
 #include "testinghelpers.h"
+#include "fimex/ArrayPool.h"
 #include "fimex/Data.h"
 #include "../src/DataImpl.h"
 #include "fimex/IndexedData.h"
+#include "fimex/mifi_constants.h"
 
 using namespace std;
 using namespace MetNoFimex;
@@ -204,6 +206,39 @@ TEST4FIMEX_TEST_CASE(test_slice_segfault)
     TEST4FIMEX_CHECK_EQ(slice->size(), newDimSize[0] * newDimSize[1] * newDimSize[2]);
 }
 
+TEST4FIMEX_TEST_CASE(test_slice_shapes)
+{
+    // x, y, z, time with complete, partial and single-element dimensions
+    const size_t org[] = {6, 5, 4, 3};
+    const std::vector<size_t> orgDimSize(org, org + 4);
+    DataImpl<int> data(6 * 5 * 4 * 3);
+    for (size_t i = 0; i < data.size(); i++)
+        data.setValue(i, i);
+
+    const size_t cases[][8] = {
+        {0, 0, 0, 0, 6, 5, 4, 3}, // everything
+        {2, 3, 0, 0, 1, 1, 4, 3}, // single column
+        {0, 0, 1, 0, 6, 5, 2, 3}, // complete xy-planes
+        {1, 1, 1, 1, 4, 3, 2, 2}, // inner box
+        {4, 0, 0, 2, 1, 5, 4, 1}, // single x, strided gather
+        {0, 2, 3, 0, 6, 1, 1, 3}, // rows
+    };
+    for (const auto& c : cases) {
+        const std::vector<size_t> start(c, c + 4), size(c + 4, c + 8);
+        DataPtr slice = data.slice(orgDimSize, start, size);
+        TEST4FIMEX_REQUIRE_EQ(slice->size(), size[0] * size[1] * size[2] * size[3]);
+        shared_array<int> values = slice->asInt();
+        size_t pos = 0;
+        for (size_t t = 0; t < size[3]; t++)
+            for (size_t z = 0; z < size[2]; z++)
+                for (size_t y = 0; y < size[1]; y++)
+                    for (size_t x = 0; x < size[0]; x++) {
+                        const int expected = (start[0] + x) + org[0] * ((start[1] + y) + org[1] * ((start[2] + z) + org[2] * (start[3] + t)));
+                        TEST4FIMEX_CHECK_EQ(values[pos++], expected);
+                    }
+    }
+}
+
 TEST4FIMEX_TEST_CASE(test_rounding)
 {
     DataPtr dataDouble(new DataImpl<double>(40));
@@ -233,3 +268,82 @@ TEST4FIMEX_TEST_CASE(test_rounding)
         TEST4FIMEX_CHECK_MESSAGE(asI[j] == expect, "int:   i=" << i << " have == " << asI[j] << " expected " << expect);
     }
 }
+
+TEST4FIMEX_TEST_CASE(test_writable_copy_on_write)
+{
+    const size_t n = 10;
+    shared_array<float> values(new float[n]);
+    std::fill(values.get(), values.get() + n, 1.f);
+    DataPtr data = createData(n, values);
+
+    // array shared with 'values', must be copied
+    shared_array<float> w1 = asWritableFloat(data);
+    TEST4FIMEX_CHECK(w1.get() != values.get());
+    w1[0] = 2;
+    TEST4FIMEX_CHECK_EQ(data->asFloat()[0], 1);
+
+    // zero-copy view if types match
+    TEST4FIMEX_CHECK(data->asFloat().get() == values.get());
+
+    values = shared_array<float>();
+    TEST4FIMEX_CHECK(!data->isArrayShared());
+    shared_array<float> w2 = asWritableFloat(data);
+    TEST4FIMEX_CHECK(w2.get() == data->asFloat().get());
+
+    // data object shared, must be copied
+    DataPtr data2 = createData(n, shared_array<double>(new double[n]));
+    DataPtr data2copy = data2;
+    TEST4FIMEX_CHECK(asWritableDouble(data2).get() != data2->asDouble().get());
+}
+
+TEST4FIMEX_TEST_CASE(test_array_pool)
+{
+    ArrayPool& pool = ArrayPool::instance();
+    const size_t n = 1000000;
+    const size_t cls = ArrayPool::sizeClass(n * sizeof(float));
+    TEST4FIMEX_CHECK(cls >= n * sizeof(float));
+    TEST4FIMEX_CHECK(cls <= n * sizeof(float) * 9 / 8);
+
+    const size_t live0 = pool.getLiveBytes();
+    const float* first;
+    {
+        shared_array<float> a = make_pooled_array<float>(n);
+        first = a.get();
+        TEST4FIMEX_CHECK_EQ(reinterpret_cast<size_t>(first) % ArrayPool::ALIGNMENT, 0);
+        TEST4FIMEX_CHECK_EQ(pool.getLiveBytes(), live0 + cls);
+        TEST4FIMEX_CHECK(pool.getPeakBytes() >= live0 + cls);
+    }
+    TEST4FIMEX_CHECK_EQ(pool.getLiveBytes(), live0);
+    TEST4FIMEX_CHECK(pool.getPooledBytes() >= cls);
+
+    // same size-class is reused
+    DataPtr data = createData(CDM_FLOAT, n - 1);
+    TEST4FIMEX_CHECK(data->asFloat().get() == first);
+
+    pool.clear();
+    TEST4FIMEX_CHECK_EQ(pool.getPooledBytes(), 0);
+}
+
+TEST4FIMEX_TEST_CASE(test_convert_fill_scale)
+{
+    const size_t n = 100000; // large enough for several blocks
+    shared_array<short> packed(new short[n]);
+    for (size_t i = 0; i < n; i++)
+        packed[i] = (i % 7 == 0) ? -32767 : static_cast<short>(i % 1000);
+    DataPtr dataShort = createData(n, packed);
+
+    DataPtr dataFloat = dataShort->convertDataType(-32767, 0.1, 10, CDM_FLOAT, MIFI_UNDEFINED_F, 1, 0);
+    shared_array<float> f = dataFloat->asFloat();
+    for (size_t i = 0; i < n; i++) {
+        if (i % 7 == 0) {
+            TEST4FIMEX_REQUIRE(mifi_isnan(f[i]));
+        } else {
+            TEST4FIMEX_REQUIRE_CLOSE(f[i], 0.1 * (i % 1000) + 10, 1e-4);
+        }
+    }
+
+    // and back again, nan to fill
+    DataPtr dataBack = dataFloat->convertDataType(MIFI_UNDEFINED_F, 1, 0, CDM_SHORT, -32767, 0.1, 10);
+    shared_array<short> s = dataBack->asShort();
+    TEST4FIMEX_CHECK(std::equal(&packed[0], &packed[n], &s[0]));
+}
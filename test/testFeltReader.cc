@@ -35,6 +35,7 @@
 
 #include "fimex/Data.h"
 #include "fimex/CDM.h"
+#include "fimex/SliceBuilder.h"
 
 using namespace std;
 using namespace MetNoFelt;
@@ -145,4 +146,20 @@ TEST4FIMEX_TEST_CASE(test_felt_cdm_reader)
     TEST4FIMEX_CHECK_EQ(feltCDM.getData("sigma")->size(), 4);
     // with level restrictions
     TEST4FIMEX_CHECK_EQ(feltCDM2.getData("sigma")->size(), 1);
+
+    // sub-domain read matches the same points from the full field
+    SliceBuilder sb(feltCDM.getCDM(), "air_temperature");
+    sb.setStartAndSize(projXAxis, 10, 5);
+    sb.setStartAndSize(projYAxis, 20, 3);
+    const vector<string> unset = sb.getUnsetDimensionNames();
+    for (vector<string>::const_iterator it = unset.begin(); it != unset.end(); ++it)
+        sb.setStartAndSize(*it, 0, 1);
+    DataPtr sub = feltCDM.getDataSlice("air_temperature", sb);
+    TEST4FIMEX_REQUIRE_EQ(sub->size(), 15);
+    DataPtr full = feltCDM.getDataSlice("air_temperature", 0);
+    for (size_t y = 0; y < 3; ++y) {
+        for (size_t x = 0; x < 5; ++x) {
+            TEST4FIMEX_CHECK_EQ(sub->getDouble(y * 5 + x), full->getDouble((20 + y) * 229 + 10 + x));
+        }
+    }
 }
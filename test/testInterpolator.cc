@@ -30,12 +30,15 @@
 #include "fimex/MathUtils.h"
 #include "fimex/NcmlCDMReader.h"
 #include "fimex/NetCDF_CDMWriter.h"
+#include "fimex/SliceBuilder.h"
 #include "fimex/Type2String.h"
 #include "fimex/XMLInputFile.h"
 #include "fimex/interpolation.h"
 
 #include "testinghelpers.h"
 
+#include <cmath>
+
 using namespace std;
 using namespace MetNoFimex;
 
@@ -285,6 +288,41 @@ TEST4FIMEX_TEST_CASE(interpolator_wrongaxes_latlon)
     }
 }
 
+TEST4FIMEX_TEST_CASE(interpolator_vector_handoff)
+{
+    const double lat[] = {59.5, 60.0, 60.5, 61.0};
+    const double lon[] = {9.0, 10.0, 11.0, 12.0};
+    const vector<double> latVals(lat, lat + 4), lonVals(lon, lon + 4);
+
+    const string ncmlFileName = pathTest("c11.ncml");
+    const string ncFileName = pathTest("c11.nc");
+    const char* vars[] = {"x_wind_pl", "y_wind_pl"};
+
+    // read both components twice, once with the counterpart kept, once recomputed
+    vector<DataPtr> results[2];
+    for (size_t handoff = 0; handoff < 2; ++handoff) {
+        CDMReader_p ncReader = CDMFileReaderFactory::create("netcdf", ncFileName);
+        CDMReader_p ncmlReader = std::make_shared<NcmlCDMReader>(ncReader, XMLInputFile(ncmlFileName));
+        CDMInterpolator_p interpolator = std::make_shared<CDMInterpolator>(ncmlReader);
+        interpolator->setVectorHandoffMemory(handoff ? 64 * 1024 * 1024 : 0);
+        interpolator->changeProjection(MIFI_INTERPOL_BILINEAR, lonVals, latVals);
+        for (const char* v : vars)
+            results[handoff].push_back(interpolator->getDataSlice(v, 0));
+    }
+
+    for (size_t i = 0; i < 2; ++i) {
+        TEST4FIMEX_REQUIRE(results[0][i] && results[1][i]);
+        TEST4FIMEX_REQUIRE_EQ(results[0][i]->size(), results[1][i]->size());
+        shared_array<double> a = results[0][i]->asDouble(), b = results[1][i]->asDouble();
+        size_t bad = 0;
+        for (size_t j = 0; j < results[0][i]->size(); ++j) {
+            if (!(a[j] == b[j] || (mifi_isnan(a[j]) && mifi_isnan(b[j]))))
+                bad += 1;
+        }
+        TEST4FIMEX_CHECK_EQ(0, bad);
+    }
+}
+
 namespace {
 struct IP {
     IP(string proj, string xAxis, string yAxis, string unit, string lonAxis="-180,-179,...,180", string latAxis="-90,-89,...,90", double delta=1e-4)
@@ -421,6 +459,93 @@ TEST4FIMEX_TEST_CASE(interpolator_vcross)
     TEST4FIMEX_CHECK(cdm.getDimension("x").getLength() > 5);
 }
 
+TEST4FIMEX_TEST_CASE(interpolator_vcross_blocks)
+{
+    if (DEBUG) defaultLogLevel(Logger::DEBUG);
+    const string ncFileName = pathTest("erai.sfc.40N.0.75d.200301011200.nc");
+
+    vector<CrossSectionDefinition> vc;
+    vector<pair<double, double> > lonLat;
+    lonLat.push_back(make_pair<double, double>(10.74, 59.9));     // Oslo
+    lonLat.push_back(make_pair<double, double>(10.3951, 63.4305)); // Tronheim
+    vc.push_back(CrossSectionDefinition("OsloTrondheim", lonLat));
+    lonLat.clear();
+    lonLat.push_back(make_pair<double, double>(-20.0, 45.0));
+    lonLat.push_back(make_pair<double, double>(-15.0, 46.0));
+    vc.push_back(CrossSectionDefinition("Atlantic", lonLat));
+
+    const int methods[] = {MIFI_INTERPOL_BILINEAR, MIFI_INTERPOL_BICUBIC, MIFI_INTERPOL_NEAREST_NEIGHBOR};
+    for (int method : methods) {
+        // cross-sections, read as separate blocks
+        CDMInterpolator_p csInterpolator = std::make_shared<CDMInterpolator>(CDMFileReaderFactory::create("netcdf", ncFileName));
+        csInterpolator->changeProjectionToCrossSections(method, vc);
+        DataPtr csData = csInterpolator->getDataSlice("ga_skt", 0);
+
+        // the same points as one list, read as one box
+        shared_array<double> lon = csInterpolator->getData("lon")->asDouble();
+        shared_array<double> lat = csInterpolator->getData("lat")->asDouble();
+        const size_t n = csInterpolator->getData("lon")->size();
+        CDMInterpolator_p interpolator = std::make_shared<CDMInterpolator>(CDMFileReaderFactory::create("netcdf", ncFileName));
+        interpolator->changeProjection(method, vector<double>(lon.get(), lon.get() + n), vector<double>(lat.get(), lat.get() + n));
+        DataPtr data = interpolator->getDataSlice("ga_skt", 0);
+
+        TEST4FIMEX_REQUIRE(csData);
+        TEST4FIMEX_REQUIRE(data);
+        TEST4FIMEX_REQUIRE_EQ(csData->size(), data->size());
+        shared_array<float> csValues = csData->asFloat(), values = data->asFloat();
+        size_t defined = 0;
+        for (size_t i = 0; i < data->size(); ++i) {
+            if (mifi_isnan(values[i])) {
+                TEST4FIMEX_CHECK(mifi_isnan(csValues[i]));
+            } else {
+                defined += 1;
+                TEST4FIMEX_CHECK_CLOSE(csValues[i], values[i], 1e-4);
+            }
+        }
+        TEST4FIMEX_CHECK(defined > 0);
+    }
+}
+
+TEST4FIMEX_TEST_CASE(interpolator_point_tiles)
+{
+    if (DEBUG) defaultLogLevel(Logger::DEBUG);
+    const string ncFileName = pathTest("erai.sfc.40N.0.75d.200301011200.nc");
+
+    // scattered stations
+    vector<double> lonVals, latVals;
+    for (int i = 0; i < 50; ++i) {
+        lonVals.push_back(-10 + std::fmod(i * 7.3, 40.));
+        latVals.push_back(41 + std::fmod(i * 3.1, 30.));
+    }
+
+    const int methods[] = {MIFI_INTERPOL_BILINEAR, MIFI_INTERPOL_BICUBIC, MIFI_INTERPOL_NEAREST_NEIGHBOR};
+    for (int method : methods) {
+        CDMInterpolator_p tiled = std::make_shared<CDMInterpolator>(CDMFileReaderFactory::create("netcdf", ncFileName));
+        tiled->setPointTileSize(4);
+        tiled->changeProjection(method, lonVals, latVals);
+        DataPtr tiledData = tiled->getDataSlice("ga_skt", 0);
+
+        CDMInterpolator_p box = std::make_shared<CDMInterpolator>(CDMFileReaderFactory::create("netcdf", ncFileName));
+        box->changeProjection(method, lonVals, latVals);
+        DataPtr boxData = box->getDataSlice("ga_skt", 0);
+
+        TEST4FIMEX_REQUIRE(tiledData);
+        TEST4FIMEX_REQUIRE(boxData);
+        TEST4FIMEX_REQUIRE_EQ(tiledData->size(), boxData->size());
+        shared_array<float> tiledValues = tiledData->asFloat(), boxValues = boxData->asFloat();
+        size_t defined = 0;
+        for (size_t i = 0; i < boxData->size(); ++i) {
+            if (mifi_isnan(boxValues[i])) {
+                TEST4FIMEX_CHECK(mifi_isnan(tiledValues[i]));
+            } else {
+                defined += 1;
+                TEST4FIMEX_CHECK_EQ(tiledValues[i], boxValues[i]);
+            }
+        }
+        TEST4FIMEX_CHECK(defined > 0);
+    }
+}
+
 namespace {
 std::vector<double> range(double start, double step, double end)
 {
@@ -432,6 +557,51 @@ std::vector<double> range(double start, double step, double end)
 #include "testInterpolator_forward_ex.cc"
 } // namespace
 
+TEST4FIMEX_TEST_CASE(interpolator_slicebuilder_window)
+{
+    const string ncFileName(pathTest("erai.sfc.40N.0.75d.200301011200.nc"));
+    const int methods[] = {MIFI_INTERPOL_BILINEAR, MIFI_INTERPOL_BICUBIC, MIFI_INTERPOL_NEAREST_NEIGHBOR};
+    for (int method : methods) {
+        CDMReader_p ncReader(CDMFileReaderFactory::create("netcdf", ncFileName));
+        CDMInterpolator_p interpolator = std::make_shared<CDMInterpolator>(ncReader);
+        interpolator->changeProjection(method, "+proj=latlong +R=" + type2string(MIFI_EARTH_RADIUS_M) + " +no_defs", "0,0.25,...,10", "55,0.25,...,65",
+                                       "degree", "degree");
+
+        const CDM& cdm = interpolator->getCDM();
+        const string xName = cdm.getHorizontalXAxis("ga_skt"), yName = cdm.getHorizontalYAxis("ga_skt");
+        const size_t nx = cdm.getDimension(xName).getLength(), ny = cdm.getDimension(yName).getLength();
+
+        SliceBuilder sbFull(cdm, "ga_skt");
+        DataPtr full = interpolator->getDataSlice("ga_skt", sbFull);
+        TEST4FIMEX_REQUIRE(full);
+        TEST4FIMEX_REQUIRE_EQ(full->size() % (nx * ny), 0);
+        shared_array<double> fullValues = full->asDouble();
+
+        const size_t x0 = 7, wx = 11, y0 = 20, wy = 5;
+        SliceBuilder sbWindow(cdm, "ga_skt");
+        sbWindow.setStartAndSize(xName, x0, wx);
+        sbWindow.setStartAndSize(yName, y0, wy);
+        DataPtr window = interpolator->getDataSlice("ga_skt", sbWindow);
+        TEST4FIMEX_REQUIRE(window);
+        const size_t nz = full->size() / (nx * ny);
+        TEST4FIMEX_REQUIRE_EQ(window->size(), wx * wy * nz);
+        shared_array<double> windowValues = window->asDouble();
+
+        size_t bad = 0;
+        for (size_t z = 0; z < nz; ++z) {
+            for (size_t y = 0; y < wy; ++y) {
+                for (size_t x = 0; x < wx; ++x) {
+                    const double f = fullValues[(z * ny + y0 + y) * nx + x0 + x];
+                    const double w = windowValues[(z * wy + y) * wx + x];
+                    if (!(f == w || (mifi_isnan(f) && mifi_isnan(w))))
+                        bad += 1;
+                }
+            }
+        }
+        TEST4FIMEX_CHECK_EQ(0, bad);
+    }
+}
+
 TEST4FIMEX_TEST_CASE(interpolator_forward)
 {
     if (DEBUG)
@@ -26,6 +26,7 @@
 
 #include "testinghelpers.h"
 
+#include "fimex/CDMBorderSmoothing_Linear.h"
 #include "fimex/CDMFileReaderFactory.h"
 #include "fimex/CDMMerger.h"
 #include "fimex/Data.h"
@@ -100,3 +101,24 @@ TEST4FIMEX_TEST_CASE(test_merge_target)
         TEST4FIMEX_CHECK(fabs(valuesM[offset] - expected[i]) < 0.01);
     }
 }
+
+TEST4FIMEX_TEST_CASE(test_smoothing_linear_weights)
+{
+    const size_t NX = 30, NY = 20;
+    CDMBorderSmoothing_Linear smoothing(5, 2);
+    smoothing.setHorizontalSizes(NX, NY);
+
+    vector<double> weights;
+    TEST4FIMEX_REQUIRE(smoothing.getWeights(weights));
+    TEST4FIMEX_REQUIRE_EQ(weights.size(), NX * NY);
+
+    for (size_t y = 0; y < NY; ++y) {
+        for (size_t x = 0; x < NX; ++x) {
+            const double valueI = 1.5 * x + y, valueO = 7 - 2.0 * y;
+            const double w = weights[y * NX + x];
+            TEST4FIMEX_CHECK(fabs(smoothing(x, y, valueI, valueO) - (valueI + w * (valueO - valueI))) < 1e-9);
+        }
+    }
+    TEST4FIMEX_CHECK_EQ(weights[0], 1);                     // border
+    TEST4FIMEX_CHECK_EQ(weights[(NY / 2) * NX + NX / 2], 0); // center
+}
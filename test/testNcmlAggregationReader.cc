@@ -26,6 +26,7 @@
 
 #include "testinghelpers.h"
 
+#include "fimex/AggregationReader.h"
 #include "fimex/CDM.h"
 #include "fimex/CDMFileReaderFactory.h"
 #include "fimex/CDMReader.h"
@@ -35,6 +36,9 @@
 #include "fimex/NetCDF_CDMWriter.h"
 #include "fimex/SliceBuilder.h"
 
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 using namespace std;
@@ -82,6 +86,19 @@ TEST4FIMEX_FIXTURE_TEST_CASE(test_joinExisting, TestConfig)
     sb = SliceBuilder(reader->getCDM(), "unlim");
     sb.setStartAndSize("unlim", 3, 1);
     TEST4FIMEX_CHECK_EQ(reader->getDataSlice("unlim", sb)->asShort()[0], 4);
+
+    // all positions at once, across all files
+    sb = SliceBuilder(reader->getCDM(), "multi");
+    sb.setStartAndSize("unlim", 0, 5);
+    DataPtr all = reader->getDataSlice("multi", sb);
+    TEST4FIMEX_REQUIRE(all);
+    TEST4FIMEX_REQUIRE_EQ(all->size(), 10);
+    shared_array<short> allValues = all->asShort();
+    for (size_t u = 0; u < 5; ++u) {
+        shared_array<short> uValues = reader->getDataSlice("multi", u)->asShort();
+        TEST4FIMEX_CHECK_EQ(allValues[2 * u], uValues[0]);
+        TEST4FIMEX_CHECK_EQ(allValues[2 * u + 1], uValues[1]);
+    }
 }
 
 TEST4FIMEX_FIXTURE_TEST_CASE(test_joinExistingSuffix, TestConfig)
@@ -107,6 +124,82 @@ TEST4FIMEX_FIXTURE_TEST_CASE(test_joinExistingSuffix, TestConfig)
     TEST4FIMEX_CHECK_EQ(values[1], -4);
 }
 
+TEST4FIMEX_FIXTURE_TEST_CASE(test_joinExistingLazy, TestConfig)
+{
+    //defaultLogLevel(Logger::DEBUG);
+    const string ncmlName = require("joinExistingAggLazy.ncml");
+    CDMReader_p reader(CDMFileReaderFactory::create("ncml", ncmlName));
+    const CDMDimension* unlim = reader->getCDM().getUnlimitedDim();
+    TEST4FIMEX_REQUIRE(unlim);
+    TEST4FIMEX_CHECK_EQ(unlim->getLength(), 5);
+    TEST4FIMEX_CHECK_EQ(reader->getDataSlice("unlim", 3)->asShort()[0], 4);
+
+    // switching between files, with only one open at a time
+    for (size_t u = 0; u < 5; ++u) {
+        DataPtr slice = reader->getDataSlice("multi", 4 - u);
+        TEST4FIMEX_REQUIRE(slice);
+        TEST4FIMEX_REQUIRE_EQ(slice->size(), 2);
+    }
+    TEST4FIMEX_CHECK_EQ(reader->getDataSlice("multi", 3)->asShort()[1], -4);
+
+    SliceBuilder sb(reader->getCDM(), "multi");
+    sb.setStartAndSize("unlim", 0, 5);
+    DataPtr all = reader->getDataSlice("multi", sb);
+    TEST4FIMEX_REQUIRE(all);
+    TEST4FIMEX_REQUIRE_EQ(all->size(), 10);
+    TEST4FIMEX_CHECK_EQ(all->asShort()[7], -4);
+}
+
+TEST4FIMEX_TEST_CASE(test_joinExistingManifest)
+{
+    const string manifest = pathBuildTest("test_joinExistingManifest.txt");
+    MetNoFimex::remove(manifest);
+    vector<string> files;
+    for (const char* name : {"joinExistingAgg1.nc", "joinExistingAgg3.nc", "joinExistingAgg4.nc"}) {
+        files.push_back(pathBuildTest(string("manifest_") + name));
+        copyFile(pathTest(string("data/") + name), files.back());
+    }
+
+    // the second aggregation only opens the reference file, the others are in the manifest;
+    // the third also opens the last file, replaced by a copy with the same size and times
+    const size_t expectedOpened[] = {3, 1, 2};
+    for (size_t run = 0; run < 3; ++run) {
+        if (run == 2) {
+            struct stat sb;
+            TEST4FIMEX_REQUIRE_EQ(stat(files.back().c_str(), &sb), 0);
+            const string replacement = files.back() + ".new";
+            copyFile(pathTest("data/joinExistingAgg4.nc"), replacement);
+            const struct timespec times[2] = {sb.st_atim, sb.st_mtim};
+            TEST4FIMEX_REQUIRE_EQ(utimensat(AT_FDCWD, replacement.c_str(), times, 0), 0);
+            TEST4FIMEX_REQUIRE_EQ(std::rename(replacement.c_str(), files.back().c_str()), 0);
+        }
+
+        size_t opened = 0;
+        AggregationReader agg("joinExisting");
+        agg.setManifest(manifest);
+        for (const string& file : files) {
+            agg.addLazyReader(
+                [file, &opened]() {
+                    opened += 1;
+                    return CDMFileReaderFactory::create("netcdf", file);
+                },
+                file);
+        }
+        agg.initAggregation();
+        TEST4FIMEX_CHECK_EQ(opened, expectedOpened[run]);
+        TEST4FIMEX_CHECK(exists(manifest));
+
+        const CDMDimension* unlim = agg.getCDM().getUnlimitedDim();
+        TEST4FIMEX_REQUIRE(unlim);
+        TEST4FIMEX_CHECK_EQ(unlim->getLength(), 5);
+        TEST4FIMEX_CHECK_EQ(agg.getDataSlice("unlim", 3)->asShort()[0], 4);
+        TEST4FIMEX_CHECK_EQ(agg.getDataSlice("multi", 3)->asShort()[1], -4);
+    }
+    MetNoFimex::remove(manifest);
+    for (const string& file : files)
+        MetNoFimex::remove(file);
+}
+
 TEST4FIMEX_FIXTURE_TEST_CASE(test_aggNothing, TestConfig)
 {
     //defaultLogLevel(Logger::DEBUG);
@@ -23,15 +23,78 @@
 
 #include "testinghelpers.h"
 
+#include "fimex/CDM.h"
 #include "fimex/CDMException.h"
 #include "fimex/CDMFileReaderFactory.h"
+#include "fimex/Data.h"
 #include "fimex/NetCDF_CDMWriter.h"
+#include "fimex/SliceBuilder.h"
 
+#include <chrono>
 #include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 using namespace std;
 using namespace MetNoFimex;
 
+namespace {
+
+const size_t NX = 4, NT = 6;
+
+// slow reader remembering how many different slices were read at the same time
+class SlowReader : public CDMReader
+{
+public:
+    SlowReader()
+        : maxSlicesReading(0)
+    {
+        CDMDimension x("x", NX);
+        CDMDimension time("time", NT);
+        time.setUnlimited(true);
+        cdm_->addDimension(x);
+        cdm_->addDimension(time);
+        vector<string> dims;
+        dims.push_back("x");
+        dims.push_back("time");
+        cdm_->addVariable(CDMVariable("a", CDM_FLOAT, dims));
+        cdm_->addVariable(CDMVariable("b", CDM_FLOAT, dims));
+    }
+
+    DataPtr getDataSlice(const std::string& varName, size_t unLimDimPos) override
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            reading_.insert(unLimDimPos);
+            maxSlicesReading = std::max(maxSlicesReading, reading_.size());
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            reading_.erase(reading_.find(unLimDimPos));
+        }
+        return createData(CDM_FLOAT, NX, double(10 * unLimDimPos + (varName == "a" ? 1 : 2)));
+    }
+
+    DataPtr getDataSlice(const std::string& varName, const SliceBuilder& sb) override
+    {
+        return getDataSlice(varName, sb.getDimensionStartPositions().back());
+    }
+
+    size_t maxSlicesReading;
+
+private:
+    std::mutex mutex_;
+    std::multiset<size_t> reading_;
+};
+
+} // namespace
+
 TEST4FIMEX_TEST_CASE(test_feltNetcdfWrite)
 {
     if (!hasTestExtra())
@@ -63,3 +126,52 @@ TEST4FIMEX_TEST_CASE(test_feltNetcdfWriteConfig)
     TEST4FIMEX_CHECK_THROW(writer.getAttribute("surface_snow_thickness", "long_name"), CDMException);
     // "variable '" << var << "' has no attribute '" << att << "', expected exception");
 }
+
+TEST4FIMEX_TEST_CASE(test_netcdfWritePrefetch)
+{
+    CDMReader_p reader = CDMFileReaderFactory::create("netcdf", pathTest("data/joinExistingAgg3.nc"));
+    TEST4FIMEX_REQUIRE(reader);
+    const CDMDimension* unlim = reader->getCDM().getUnlimitedDim();
+    TEST4FIMEX_REQUIRE(unlim);
+
+    // without and with slices read while writing
+    CDMFileReaderFactory::createWriter(reader, "netcdf", "test_netcdfWriteNoPrefetch.nc", pathTest("ncwriterNoPrefetch.xml"));
+    CDMFileReaderFactory::createWriter(reader, "netcdf", "test_netcdfWritePrefetch.nc");
+
+    CDMReader_p noPrefetch = CDMFileReaderFactory::create("netcdf", "test_netcdfWriteNoPrefetch.nc");
+    CDMReader_p prefetch = CDMFileReaderFactory::create("netcdf", "test_netcdfWritePrefetch.nc");
+    for (size_t u = 0; u < unlim->getLength(); ++u) {
+        shared_array<short> expected = reader->getDataSlice("multi", u)->asShort();
+        shared_array<short> a = noPrefetch->getDataSlice("multi", u)->asShort();
+        shared_array<short> b = prefetch->getDataSlice("multi", u)->asShort();
+        for (size_t i = 0; i < 2; ++i) {
+            TEST4FIMEX_CHECK_EQ(a[i], expected[i]);
+            TEST4FIMEX_CHECK_EQ(b[i], expected[i]);
+        }
+    }
+}
+
+TEST4FIMEX_TEST_CASE(test_netcdfWritePrefetchOverlap)
+{
+    std::shared_ptr<SlowReader> noPrefetchReader = std::make_shared<SlowReader>();
+    CDMFileReaderFactory::createWriter(noPrefetchReader, "netcdf", "test_netcdfWriteOverlapNoPrefetch.nc", pathTest("ncwriterNoPrefetch.xml"));
+    TEST4FIMEX_CHECK_EQ(noPrefetchReader->maxSlicesReading, size_t(1));
+
+    std::shared_ptr<SlowReader> reader = std::make_shared<SlowReader>();
+    CDMFileReaderFactory::createWriter(reader, "netcdf", "test_netcdfWriteOverlap.nc");
+#ifdef _OPENMP
+    // later slices are read while earlier slices are still read and written
+    if (omp_get_max_threads() > 1)
+        TEST4FIMEX_CHECK(reader->maxSlicesReading > 1);
+#endif
+
+    CDMReader_p written = CDMFileReaderFactory::create("netcdf", "test_netcdfWriteOverlap.nc");
+    for (size_t u = 0; u < NT; ++u) {
+        shared_array<float> a = written->getDataSlice("a", u)->asFloat();
+        shared_array<float> b = written->getDataSlice("b", u)->asFloat();
+        for (size_t i = 0; i < NX; ++i) {
+            TEST4FIMEX_CHECK_EQ(a[i], float(10 * u + 1));
+            TEST4FIMEX_CHECK_EQ(b[i], float(10 * u + 2));
+        }
+    }
+}
@@ -39,6 +39,49 @@
 using namespace std;
 using namespace MetNoFimex;
 
+namespace {
+
+const size_t NX = 4, NT = 40;
+
+// each slice of "v" is 1 everywhere
+class OnesReader : public CDMReader
+{
+public:
+    OnesReader()
+    {
+        CDMDimension x("x", NX);
+        CDMDimension time("time", NT);
+        time.setUnlimited(true);
+        cdm_->addDimension(x);
+        cdm_->addDimension(time);
+        vector<string> dims;
+        dims.push_back("x");
+        dims.push_back("time");
+        cdm_->addVariable(CDMVariable("v", CDM_DOUBLE, dims));
+    }
+
+    DataPtr getDataSlice(const std::string&, size_t) override { return createData(CDM_DOUBLE, NX, 1.); }
+
+    DataPtr getDataSlice(const std::string&, const SliceBuilder& sb) override { return createData(CDM_DOUBLE, sb.getDimensionSizes()[0], 1.); }
+};
+
+} // namespace
+
+TEST4FIMEX_TEST_CASE(test_accumulate_spill_limit)
+{
+    // the memory limit holds after checkpoints have been spilled
+    const size_t maxBytes = 4 * NX * sizeof(double);
+    std::shared_ptr<CDMProcessor> proc = std::make_shared<CDMProcessor>(std::make_shared<OnesReader>());
+    proc->accumulate("v");
+    proc->setAccumulationMemory(maxBytes, true);
+    for (size_t u = 0; u < NT; ++u) {
+        TEST4FIMEX_CHECK_EQ(proc->getDataSlice("v", u)->getDouble(0), double(u + 1));
+        TEST4FIMEX_CHECK(proc->getAccumulationMemory() <= maxBytes);
+    }
+    for (size_t u = NT; u > 0; --u)
+        TEST4FIMEX_CHECK_EQ(proc->getDataSlice("v", u - 1)->getDouble(NX - 1), double(u));
+}
+
 #ifdef HAVE_NETCDF_H
 TEST4FIMEX_TEST_CASE(test_accumulate)
 {
@@ -67,6 +110,31 @@ TEST4FIMEX_TEST_CASE(test_accumulate)
         TEST4FIMEX_CHECK_CLOSE(time[2], time[1] + t0 + 2 * 3600., 1e-5);
         TEST4FIMEX_CHECK_CLOSE(time[3], time[2] + t0 + 3 * 3600., 1e-5);
     }
+    for (int spill = 0; spill < 2; ++spill) {
+        // out of order, with room for a single checkpoint only
+        std::shared_ptr<CDMProcessor> proc(new CDMProcessor(nc));
+        proc->accumulate("time");
+        proc->setAccumulationMemory(sizeof(double), spill != 0);
+        const double t3 = proc->getDataSlice("time", 3)->getDouble(0);
+        const double t1 = proc->getDataSlice("time", 1)->getDouble(0);
+        const double t2 = proc->getDataSlice("time", 2)->getDouble(0);
+        TEST4FIMEX_CHECK_CLOSE(t1, 2 * t0 + 3600., 1e-5);
+        TEST4FIMEX_CHECK_CLOSE(t2, t1 + t0 + 2 * 3600., 1e-5);
+        TEST4FIMEX_CHECK_CLOSE(t3, t2 + t0 + 3 * 3600., 1e-5);
+        TEST4FIMEX_CHECK_CLOSE(proc->getDataSlice("time", 3)->getDouble(0), t3, 1e-5);
+    }
+    {
+        // modifying a returned slice must not change the stored sums
+        std::shared_ptr<CDMProcessor> proc(new CDMProcessor(nc));
+        proc->accumulate("time");
+        const double t1 = proc->getDataSlice("time", 1)->getDouble(0);
+        DataPtr d0 = proc->getDataSlice("time", 0);
+        d0->setValue(0, -1.);
+        DataPtr d1 = proc->getDataSlice("time", 1);
+        TEST4FIMEX_CHECK_CLOSE(d1->getDouble(0), t1, 1e-5);
+        d1->setValue(0, -1.);
+        TEST4FIMEX_CHECK_CLOSE(proc->getDataSlice("time", 2)->getDouble(0), t1 + t0 + 2 * 3600., 1e-5);
+    }
 }
 
 TEST4FIMEX_TEST_CASE(test_rotate)
@@ -23,13 +23,16 @@
 
 #include "testinghelpers.h"
 
+#include "fimex/CDM.h"
 #include "fimex/CDMFileReaderFactory.h"
 #include "fimex/CDMQualityExtractor.h"
 #include "fimex/Data.h"
 #include "fimex/Logger.h"
 #include "fimex/SharedArray.h"
+#include "fimex/SliceBuilder.h"
 #include "fimex/mifi_constants.h"
 
+#include <cmath>
 #include <memory>
 
 using namespace std;
@@ -107,5 +110,50 @@ TEST4FIMEX_TEST_CASE(test_qualityExtract_mask)
     const int offset0 = 0, offset1 = 12+NXSI*12;
     TEST4FIMEX_CHECK(valuesM[offset0] > 1e36);
     TEST4FIMEX_CHECK(fabs(valuesM[offset1] - 35.114) < 0.001);
+
+    // the same point, reading only a subset of data and mask
+    SliceBuilder sb(mask->getCDM(), "salt");
+    const vector<string> shape = mask->getCDM().getVariable("salt").getShape();
+    sb.setStartAndSize(shape.at(0), 12, 1);
+    sb.setStartAndSize(shape.at(1), 12, 1);
+    if (shape.size() > 3)
+        sb.setStartAndSize(shape.at(3), 0, 1); // first time
+    DataPtr sliceSb = mask->getDataSlice("salt", sb);
+    TEST4FIMEX_REQUIRE(sliceSb);
+    TEST4FIMEX_REQUIRE_EQ(sliceSb->size(), N_SRHO);
+    TEST4FIMEX_CHECK(fabs(sliceSb->asDouble()[0] - 35.114) < 0.001);
+}
+
+TEST4FIMEX_TEST_CASE(test_qualityExtract_highest_subset)
+{
+    const string fileNameD = pathTest("testQEmask_data.nc");
+    CDMReader_p readerD = CDMFileReaderFactory::create("netcdf", fileNameD);
+    std::shared_ptr<CDMQualityExtractor> mask = std::make_shared<CDMQualityExtractor>(readerD, "", pathTest("testQEhighest.xml"));
+
+    const size_t NXSI = 21, NETA = 16, N_SRHO = 35;
+    DataPtr sliceM = mask->getDataSlice("salt", 0);
+    TEST4FIMEX_REQUIRE_EQ(sliceM->size(), N_SRHO * NXSI * NETA);
+    shared_array<double> valuesM = sliceM->asDouble();
+
+    // the highest value is selected in the whole slice, not in the subset
+    SliceBuilder sb(mask->getCDM(), "salt");
+    const vector<string> shape = mask->getCDM().getVariable("salt").getShape();
+    const size_t x0 = 10, nx = 3, y0 = 11, ny = 2;
+    sb.setStartAndSize(shape.at(0), x0, nx);
+    sb.setStartAndSize(shape.at(1), y0, ny);
+    if (shape.size() > 3)
+        sb.setStartAndSize(shape.at(3), 0, 1); // first time
+    DataPtr sliceSb = mask->getDataSlice("salt", sb);
+    TEST4FIMEX_REQUIRE_EQ(sliceSb->size(), N_SRHO * nx * ny);
+    shared_array<double> valuesSb = sliceSb->asDouble();
+    for (size_t z = 0; z < N_SRHO; ++z) {
+        for (size_t y = 0; y < ny; ++y) {
+            for (size_t x = 0; x < nx; ++x) {
+                const double full = valuesM[(x0 + x) + NXSI * ((y0 + y) + NETA * z)];
+                const double part = valuesSb[x + nx * (y + ny * z)];
+                TEST4FIMEX_CHECK((std::isnan(full) && std::isnan(part)) || full == part);
+            }
+        }
+    }
 }
 #endif /* HAVE_NETCDF_H */
@@ -0,0 +1,118 @@
+/*
+ * Fimex, testSliceCache.cc
+ *
+ * (C) Copyright 2019, met.no
+ *
+ * Project Info:  https://wiki.met.no/fimex/start
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include "testinghelpers.h"
+
+#include "fimex/CDM.h"
+#include "fimex/CDMSliceCache.h"
+#include "fimex/Data.h"
+#include "fimex/SliceBuilder.h"
+
+using namespace std;
+using namespace MetNoFimex;
+
+namespace {
+
+const size_t NX = 4, NT = 3;
+
+class CountingReader : public CDMReader
+{
+public:
+    CountingReader()
+        : reads(0)
+    {
+        CDMDimension x("x", NX);
+        CDMDimension time("time", NT);
+        time.setUnlimited(true);
+        cdm_->addDimension(x);
+        cdm_->addDimension(time);
+        vector<string> dims;
+        dims.push_back("x");
+        dims.push_back("time");
+        cdm_->addVariable(CDMVariable("v", CDM_FLOAT, dims));
+    }
+
+    DataPtr getDataSlice(const std::string&, size_t unLimDimPos) override
+    {
+        reads += 1;
+        return createData(CDM_FLOAT, NX, double(unLimDimPos));
+    }
+
+    DataPtr getDataSlice(const std::string&, const SliceBuilder& sb) override
+    {
+        reads += 1;
+        return createData(CDM_FLOAT, sb.getDimensionSizes()[0], double(sb.getDimensionStartPositions()[0]));
+    }
+
+    size_t reads;
+};
+
+} // namespace
+
+TEST4FIMEX_TEST_CASE(test_slice_cache_hits)
+{
+    std::shared_ptr<CountingReader> reader = std::make_shared<CountingReader>();
+    std::shared_ptr<CDMSliceCache> cache = std::make_shared<CDMSliceCache>(reader, 1024);
+    TEST4FIMEX_CHECK(cache->getCDM().hasVariable("v"));
+
+    for (int i = 0; i < 3; ++i) {
+        DataPtr d = cache->getDataSlice("v", 1);
+        TEST4FIMEX_REQUIRE_EQ(d->size(), NX);
+        TEST4FIMEX_CHECK_EQ(d->asFloat()[0], 1);
+        asWritableFloat(d)[0] = 42; // copies, must not modify the cached slice
+    }
+    TEST4FIMEX_CHECK_EQ(reader->reads, 1);
+    TEST4FIMEX_CHECK_EQ(cache->getHits(), 2);
+    TEST4FIMEX_CHECK_EQ(cache->getMisses(), 1);
+    TEST4FIMEX_CHECK_EQ(cache->getMemory(), NX * sizeof(float));
+
+    SliceBuilder sb(cache->getCDM(), "v");
+    sb.setStartAndSize("x", 1, 2);
+    sb.setStartAndSize("time", 1, 1);
+    TEST4FIMEX_CHECK_EQ(cache->getDataSlice("v", sb)->size(), 2);
+    TEST4FIMEX_CHECK_EQ(cache->getDataSlice("v", sb)->size(), 2);
+    TEST4FIMEX_CHECK_EQ(reader->reads, 2);
+
+    sb.setStartAndSize("x", 0, 2);
+    TEST4FIMEX_CHECK_EQ(cache->getDataSlice("v", sb)->asFloat()[0], 0);
+    TEST4FIMEX_CHECK_EQ(reader->reads, 3);
+}
+
+TEST4FIMEX_TEST_CASE(test_slice_cache_evict)
+{
+    std::shared_ptr<CountingReader> reader = std::make_shared<CountingReader>();
+    // room for two slices only
+    std::shared_ptr<CDMSliceCache> cache = std::make_shared<CDMSliceCache>(reader, 2 * NX * sizeof(float));
+
+    cache->getDataSlice("v", 0);
+    cache->getDataSlice("v", 1);
+    cache->getDataSlice("v", 0); // 0 is now most recently used
+    cache->getDataSlice("v", 2); // evicts 1
+    TEST4FIMEX_CHECK_EQ(reader->reads, 3);
+    TEST4FIMEX_CHECK(cache->getMemory() <= cache->getMaxMemory());
+
+    cache->getDataSlice("v", 0);
+    TEST4FIMEX_CHECK_EQ(reader->reads, 3);
+    cache->getDataSlice("v", 1);
+    TEST4FIMEX_CHECK_EQ(reader->reads, 4);
+}
@@ -52,6 +52,19 @@ TEST4FIMEX_TEST_CASE(test_Units)
     TEST4FIMEX_CHECK_CLOSE(conv->convert(273.15), 0, 1e6);
 }
 
+TEST4FIMEX_TEST_CASE(test_UnitsConverterCache)
+{
+    UnitsConverter_p conv1 = Units().getConverter("hPa", "Pa");
+    UnitsConverter_p conv2 = Units().getConverter("hPa", "Pa");
+    TEST4FIMEX_CHECK_EQ(conv1.get(), conv2.get());
+    TEST4FIMEX_CHECK(conv1->isLinear());
+    TEST4FIMEX_CHECK_CLOSE(conv1->convert(1013.25), 101325, 1e-5);
+
+    UnitsConverter_p conv3 = Units().getConverter("Pa", "hPa");
+    TEST4FIMEX_CHECK(conv1.get() != conv3.get());
+    TEST4FIMEX_CHECK_CLOSE(conv3->convert(101325.), 1013.25, 1e-5);
+}
+
 TEST4FIMEX_TEST_CASE(test_UnitsError)
 {
     double slope, offset;
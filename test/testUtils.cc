@@ -201,6 +201,37 @@ TEST4FIMEX_TEST_CASE(test_scanFiles)
     scanFiles(files, topSrcDir(), -1, std::regex(".*stUti.?.?\\.cc"), false);
     TEST4FIMEX_REQUIRE_EQ(files.size(), 1);
     TEST4FIMEX_CHECK(files.at(0).find("testUtils.cc") != string::npos);
+
+    // same files and order with matcher instead of regexp
+    files.clear();
+    scanFiles(files, topSrcDir() + "/test", -1, std::regex(".*\\.ncml"), true);
+    TEST4FIMEX_CHECK(!files.empty());
+    vector<string> suffixFiles;
+    scanFiles(suffixFiles, topSrcDir() + "/test", -1, suffixMatcher(".ncml"), true);
+    TEST4FIMEX_CHECK(suffixFiles == files);
+
+    setScanCache(true);
+    for (int i = 0; i < 2; ++i) {
+        vector<string> cachedFiles;
+        scanFiles(cachedFiles, topSrcDir() + "/test", -1, suffixMatcher(".ncml"), true);
+        TEST4FIMEX_CHECK(cachedFiles == files);
+    }
+    setScanCache(false);
+}
+
+TEST4FIMEX_TEST_CASE(test_globMatcher)
+{
+    const FileMatcher m = globMatcher("a/**/b?c*.nc");
+    TEST4FIMEX_CHECK(m("a/x/y/bxc1.nc"));
+    TEST4FIMEX_CHECK(m("a//bxc.nc"));
+    TEST4FIMEX_CHECK(!m("a/bxc.nc"));
+    TEST4FIMEX_CHECK(!m("a/x/b/c.nc"));   // '?' does not match '/'
+    TEST4FIMEX_CHECK(!m("a/x/bxcq/r.nc")); // '*' does not match '/'
+    TEST4FIMEX_CHECK(!m("a/x/bxc.ncx"));
+
+    TEST4FIMEX_CHECK(globMatcher("*")(""));
+    TEST4FIMEX_CHECK(!globMatcher("?")(""));
+    TEST4FIMEX_CHECK(globMatcher("x+y.[nc]")("x+y.[nc]"));
 }
 
 TEST4FIMEX_TEST_CASE(test_globFiles)
@@ -229,6 +260,13 @@ TEST4FIMEX_TEST_CASE(test_globFiles)
         TEST4FIMEX_REQUIRE_EQ(files.size(), 1);
         TEST4FIMEX_CHECK(files.at(0).find("test/file+with+plus+in+name.txt") != string::npos);
     }
+    {
+        // not the first subdirectory
+        vector<string> files;
+        globFiles(files, topSrcDir() + "/modules/*/pyfimex0.cc");
+        TEST4FIMEX_REQUIRE_EQ(files.size(), 1);
+        TEST4FIMEX_CHECK(files.at(0).find("modules/python/pyfimex0.cc") != string::npos);
+    }
 }
 
 TEST4FIMEX_TEST_CASE(test_type2string)
@@ -81,6 +81,26 @@ TEST4FIMEX_TEST_CASE(test_vlevelconverter_pressure)
     TEST4FIMEX_CHECK_CLOSE(980, pressures[64], 1);
 }
 
+TEST4FIMEX_TEST_CASE(test_vlevelconverter_tile)
+{
+    tst_t tst = createVerticalTransformationForTest();
+
+    ToVLevelConverter_p pressc = tst.vt->getConverter(tst.r, MIFI_VINT_PRESSURE, 0, tst.cs);
+    TEST4FIMEX_REQUIRE(pressc);
+
+    ToVLevelTile tile;
+    pressc->getTile(0, 2, 0, 1, 0, tile);
+    TEST4FIMEX_REQUIRE_EQ(tile.nz, 65);
+    TEST4FIMEX_REQUIRE_EQ(tile.values.size(), 2 * 65);
+    TEST4FIMEX_REQUIRE_EQ(tile.validityMax.size(), 2);
+
+    const std::vector<double> pressures = (*pressc)(1, 0, 0);
+    const double* column = tile.column(1, 0);
+    for (size_t z = 0; z < tile.nz; ++z)
+        TEST4FIMEX_CHECK_EQ(pressures[z], column[z]);
+    TEST4FIMEX_CHECK(pressc->isValid(pressures[0], 1, 0, 0));
+}
+
 TEST4FIMEX_TEST_CASE(test_pressure_integrator_compat)
 {
     tst_t tst = createVerticalTransformationForTest();
@@ -34,13 +34,104 @@
 #include "fimex/Data.h"
 #include "fimex/coordSys/CoordinateSystem.h"
 #include "fimex/interpolation.h"
+#include "fimex/mifi_constants.h"
 #include "fimex/min_max.h"
 
 #include <cassert>
+#include <cmath>
 
 using namespace std;
 using namespace MetNoFimex;
 
+namespace {
+
+// straight transcription of the original, level-by-level implementation
+vector<double> referenceVerticalVelocity(size_t nx, size_t ny, size_t nz, double dx, double dy, const vector<float>& gridDistX,
+                                         const vector<float>& gridDistY, const double* ap, const double* b, const vector<float>& zs,
+                                         const vector<float>& ps, const vector<float>& u, const vector<float>& v, const vector<float>& t)
+{
+    const double R = MIFI_GAS_CONSTANT / MIFI_MOLAR_MASS_DRY_AIR;
+    const double g = MIFI_EARTH_GRAVITY;
+    const size_t nxy = nx * ny;
+    vector<double> mapRatioX(nxy), mapRatioY(nxy), rhx(nxy), rhy(nxy), rhxy(nxy), sum(nxy), uu(nxy), vv(nxy);
+    vector<double> dp(nxy * nz), dlnp(nxy * nz), alfa(nxy * nz), z(nxy * nz), w(nxy * nz);
+    const double rdx_2 = 1 / (2 * dx), rdy_2 = 1 / (2 * dy);
+    for (size_t ij = 0; ij < nxy; ++ij) {
+        mapRatioX[ij] = gridDistX[ij] / dx;
+        mapRatioY[ij] = gridDistY[ij] / dy;
+        rhx[ij] = 1 / mapRatioX[ij];
+        rhy[ij] = 1 / mapRatioY[ij];
+        rhxy[ij] = rhx[ij] * rhy[ij];
+    }
+
+    // half levels
+    vector<double> ah(nz + 1), bh(nz + 1);
+    ah[0] = bh[0] = ah[nz] = 0;
+    bh[nz] = 1;
+    for (size_t k = nz - 1; k > 0; --k) {
+        ah[k] = 2 * ap[k] - ah[k + 1];
+        bh[k] = 2 * b[k] - bh[k + 1];
+    }
+    for (size_t ij = 0; ij < nxy; ++ij) {
+        dp[ij] = ah[1] - ah[0] + (bh[1] - bh[0]) * ps[ij];
+        dlnp[ij] = 0;
+        alfa[ij] = log(2.);
+    }
+    for (size_t k = 1; k < nz; ++k) {
+        for (size_t ij = 0; ij < nxy; ++ij) {
+            const size_t ijk = ij + nxy * k;
+            const double pm = ah[k] + bh[k] * ps[ij];
+            const double pp = ah[k + 1] + bh[k + 1] * ps[ij];
+            dp[ijk] = pp - pm;
+            dlnp[ijk] = log(pp / pm);
+            alfa[ijk] = 1 - pm * dlnp[ijk] / dp[ijk];
+        }
+    }
+
+    // geopotential
+    for (size_t ij = 0; ij < nxy; ++ij)
+        sum[ij] = zs[ij] * g;
+    for (size_t k = nz; k > 0; --k) {
+        for (size_t ij = 0; ij < nxy; ++ij) {
+            const size_t ijk = ij + nxy * (k - 1);
+            const double rt = R * t[ijk];
+            z[ijk] = sum[ij] + rt * alfa[ijk];
+            sum[ij] += rt * dlnp[ijk];
+        }
+    }
+
+    // integrated divergence
+    fill(sum.begin(), sum.end(), 0.);
+    for (size_t k = 1; k < nz; ++k) {
+        for (size_t ij = 0; ij < nxy; ++ij) {
+            const size_t ijk = ij + nxy * k;
+            uu[ij] = mapRatioY[ij] * u[ijk] * dp[ijk];
+            vv[ij] = mapRatioX[ij] * v[ijk] * dp[ijk];
+        }
+        for (size_t j = 1; j < ny - 1; ++j) {
+            for (size_t i = 1; i < nx - 1; ++i) {
+                const size_t ij = i + nx * j, ijk = ij + nxy * k;
+                const double div = rhxy[ij] * (rdx_2 * (uu[ij + 1] - uu[ij - 1]) + rdy_2 * (vv[ij + nx] - vv[ij - nx]));
+                const double w1 = R * t[ijk] * (dlnp[ijk] * sum[ij] + alfa[ijk] * div) / dp[ijk];
+                const double w2 = rhx[ij] * rdx_2 * (z[ijk + 1] - z[ijk - 1]) + rhy[ij] * rdy_2 * (z[ijk + nx] - z[ijk - nx]);
+                w[ijk] = static_cast<float>((w1 + w2) / g);
+                sum[ij] += div;
+            }
+        }
+        for (size_t i = 1; i < nx - 1; ++i) {
+            w[i + nxy * k] = w[i + nx + nxy * k];
+            w[i + nx * (ny - 1) + nxy * k] = w[i + nx * (ny - 2) + nxy * k];
+        }
+        for (size_t j = 0; j < ny; ++j) {
+            w[nx * j + nxy * k] = w[1 + nx * j + nxy * k];
+            w[nx - 1 + nx * j + nxy * k] = w[nx - 2 + nx * j + nxy * k];
+        }
+    }
+    return w;
+}
+
+} // namespace
+
 TEST4FIMEX_TEST_CASE(test_mifi_compute_vertical_velocity)
 {
     CDMReader_p reader(CDMFileReaderFactory::create("netcdf", pathTest("verticalVelocity.nc")));
@@ -107,6 +198,15 @@ TEST4FIMEX_TEST_CASE(test_mifi_compute_vertical_velocity)
                         mifi_compute_vertical_velocity(nx, ny, nz, dx, dy, gridDistX.get(), gridDistY.get(), apD->asDouble().get(), bD->asDouble().get(),
                                                        zs.get(), psD->asFloat().get(), uD->asFloat().get(), vD->asFloat().get(), tD->asFloat().get(), w.get()));
 
+    // precomputed map factors give the same result
+    shared_array<double> mapFactors(new double[4 * nx * ny]);
+    TEST4FIMEX_CHECK_EQ(MIFI_OK, mifi_vertical_velocity_map_factors(nx, ny, dx, dy, gridDistX.get(), gridDistY.get(), mapFactors.get()));
+    shared_array<float> wmf(new float[nx * ny * nz]());
+    TEST4FIMEX_CHECK_EQ(MIFI_OK,
+                        mifi_compute_vertical_velocity_mf(nx, ny, nz, dx, dy, mapFactors.get(), apD->asDouble().get(), bD->asDouble().get(), zs.get(),
+                                                          psD->asFloat().get(), uD->asFloat().get(), vD->asFloat().get(), tD->asFloat().get(), wmf.get()));
+    TEST4FIMEX_CHECK(std::equal(&w[0], &w[0] + nx * ny * nz, &wmf[0]));
+
     DataPtr hyD = reader->getScaledData("hybrid0");
     shared_array<float> hy = hyD->asFloat();
     for (size_t k = 0; k < nz; ++k) {
@@ -117,6 +217,53 @@ TEST4FIMEX_TEST_CASE(test_mifi_compute_vertical_velocity)
     }
 }
 
+TEST4FIMEX_TEST_CASE(test_mifi_compute_vertical_velocity_reference)
+{
+    // synthetic fields on a small, slightly distorted grid, compared with
+    // the original, level-by-level implementation
+    const size_t nx = 7, ny = 6, nz = 5;
+    const double dx = 2500, dy = 2500;
+    const double ap[nz] = {4000, 10000, 11000, 7500, 2500};
+    const double b[nz] = {0, 0.05, 0.225, 0.525, 0.85};
+    vector<float> gridDistX(nx * ny), gridDistY(nx * ny), zs(nx * ny), ps(nx * ny);
+    vector<float> u(nx * ny * nz), v(nx * ny * nz), t(nx * ny * nz);
+    for (size_t j = 0; j < ny; ++j) {
+        for (size_t i = 0; i < nx; ++i) {
+            const size_t ij = i + nx * j;
+            gridDistX[ij] = dx * (1 + 0.01 * i - 0.005 * j);
+            gridDistY[ij] = dy * (1 + 0.004 * i + 0.01 * j);
+            zs[ij] = 100 + 20 * i + 15 * j;
+            ps[ij] = 100000 - 120 * i + 80 * j + 30 * ((i * j) % 3);
+            for (size_t k = 0; k < nz; ++k) {
+                const size_t ijk = ij + nx * ny * k;
+                u[ijk] = 5 + 0.7 * i - 0.4 * j + 1.5 * k + 0.05 * i * j;
+                v[ijk] = -3 + 0.3 * i + 0.6 * j - 0.8 * k + 0.04 * i * i;
+                t[ijk] = 220 + 10 * k + 0.3 * i - 0.2 * j;
+            }
+        }
+    }
+
+    vector<float> w(nx * ny * nz), wmf(nx * ny * nz);
+    TEST4FIMEX_CHECK_EQ(MIFI_OK, mifi_compute_vertical_velocity(nx, ny, nz, dx, dy, &gridDistX[0], &gridDistY[0], ap, b, &zs[0], &ps[0], &u[0], &v[0],
+                                                                &t[0], &w[0]));
+    vector<double> mapFactors(4 * nx * ny);
+    TEST4FIMEX_CHECK_EQ(MIFI_OK, mifi_vertical_velocity_map_factors(nx, ny, dx, dy, &gridDistX[0], &gridDistY[0], &mapFactors[0]));
+    TEST4FIMEX_CHECK_EQ(MIFI_OK,
+                        mifi_compute_vertical_velocity_mf(nx, ny, nz, dx, dy, &mapFactors[0], ap, b, &zs[0], &ps[0], &u[0], &v[0], &t[0], &wmf[0]));
+
+    const vector<double> expected = referenceVerticalVelocity(nx, ny, nz, dx, dy, gridDistX, gridDistY, ap, b, zs, ps, u, v, t);
+    for (size_t ijk = 0; ijk < nx * ny * nz; ++ijk) {
+        if (ijk < nx * ny) {
+            // lowest level is not computed
+            TEST4FIMEX_CHECK_EQ(w[ijk], 0.f);
+            TEST4FIMEX_CHECK_EQ(wmf[ijk], 0.f);
+        } else {
+            TEST4FIMEX_CHECK_CLOSE(expected[ijk], w[ijk], 1e-4);
+            TEST4FIMEX_CHECK_CLOSE(expected[ijk], wmf[ijk], 1e-4);
+        }
+    }
+}
+
 TEST4FIMEX_TEST_CASE(test_cdmprocessor_addverticalvelocity)
 {
     CDMReader_p reader(CDMFileReaderFactory::create("netcdf", pathTest("verticalVelocity.nc")));
@@ -49,6 +49,7 @@ const string top_src(TOP_SRCDIR);
 
 const string src_share_etc(TOP_SRCDIR "/share/etc/");
 const string src_test(TOP_SRCDIR "/test/");
+const string build_test(TEST_BUILDDIR "/");
 
 const string extra_data_dir(TEST_EXTRADATA_DIR "/");
 } // namespace
@@ -96,6 +97,11 @@ string pathTest(const std::string& filename)
     return require(src_test + filename);
 }
 
+string pathBuildTest(const std::string& filename)
+{
+    return build_test + filename;
+}
+
 string pathTestExtra(const std::string& filename)
 {
     return require(extra_data_dir + filename);
@@ -49,6 +49,8 @@ size_t file_size(const std::string& path);
 
 std::string pathShareEtc(const std::string& filename);
 std::string pathTest(const std::string& filename);
+/*! Path for a file written by a test, in the test build directory; the file need not exist. */
+std::string pathBuildTest(const std::string& filename);
 
 bool hasTestExtra();
 std::string pathTestExtra(const std::string& filename);